@@ -0,0 +1,471 @@
+// 大规模测试数据生成工具：生成与 data/ 目录相同格式的站点地图、车次和用户数据。
+// 相同的种子和参数总是生成完全相同的文件（随机数不依赖标准库分布的实现，跨编译器一致）。
+//
+// 编译：g++ -std=c++17 -O2 data_generator.cpp -o data_generator
+// 用法：data_generator [--seed 42] [--stations 3000] [--trains 20000] [--users 1000000] [--out generated]
+//
+// 输出：
+//   map.txt        站点,相邻站,距离,相邻站,距离...（与 data/map.txt 相同）
+//   new_trains.txt 车次,站点,时刻表,余票矩阵,票价矩阵（与 new_trains.txt 相同，程序启动时从当前目录导入）
+//   users.txt      每个用户5行：手机号、密码、姓名、身份证号、余额（程序从 未加密txt文件/users.txt 导入）
+// 导入前需删除（或换一个目录运行）已有的 railway_system.db，数据库中已有车次时不会迁移文件数据。
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <queue>
+#include <numeric>
+#include <algorithm>
+#include <unordered_set>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+
+using namespace std;
+
+// 可复现的随机数：splitmix64，取值函数自己实现而不用 std 分布
+struct Random {
+	uint64_t state;
+
+	explicit Random(uint64_t seed) : state(seed) {}
+
+	uint64_t next() {
+		uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	// [0, n)
+	uint64_t below(uint64_t n) {
+		return next() % n;
+	}
+
+	// [lo, hi]
+	int range(int lo, int hi) {
+		return lo + static_cast<int>(below(static_cast<uint64_t>(hi - lo + 1)));
+	}
+
+	// [0, 1)
+	double unit() {
+		return (next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+};
+
+struct Station {
+	string name;
+	double x, y; // 平面坐标（公里）
+};
+
+struct Edge {
+	int to;
+	int distance;
+};
+
+// 生成参数
+struct Options {
+	uint64_t seed = 42;
+	int stationCount = 3000;
+	int trainCount = 20000;
+	int userCount = 1000000;
+	string outDir = "generated";
+};
+
+const double MAP_WIDTH = 4000.0;  // 地图范围（公里）
+const double MAP_HEIGHT = 3200.0;
+const int NEIGHBORS_PER_STATION = 3;
+const int MIN_STOPS = 3;
+const int MAX_STOPS = 16;
+const int MAX_TRAVEL_MINUTES = 22 * 60; // 单程不超过一天，程序按到达早于出发视为跨天一次
+const int TRAINS_PER_SOURCE = 8;        // 每次最短路计算生成的车次数
+const double PI = 3.14159265358979323846;
+
+// 站名用字：两字组合，不够时加方位后缀
+const vector<string> NAME_CHARS = {
+	"安", "宝", "北", "滨", "昌", "长", "常", "城", "川", "大", "德", "东", "丰", "福", "阜", "广",
+	"贵", "海", "汉", "和", "河", "衡", "湖", "华", "怀", "淮", "黄", "吉", "嘉", "江", "金", "京",
+	"靖", "九", "开", "昆", "兰", "乐", "丽", "临", "灵", "龙", "隆", "洛", "马", "茂", "梅", "明",
+	"南", "宁", "平", "莆", "庆", "泉", "瑞", "山", "商", "上", "韶", "绍", "石", "寿", "顺", "泰",
+	"唐", "天", "通", "铜", "万", "威", "文", "武", "西", "仙", "襄", "新", "兴", "阳", "宜", "永",
+	"玉", "元", "岳", "云", "枣", "湛", "漳", "肇", "镇", "中", "舟", "珠", "资", "遵"
+};
+const vector<string> NAME_SUFFIXES = {"", "东", "西", "南", "北"};
+
+const vector<string> SURNAMES = {
+	"王", "李", "张", "刘", "陈", "杨", "黄", "赵", "吴", "周", "徐", "孙", "马", "朱", "胡", "郭",
+	"何", "高", "林", "罗", "郑", "梁", "谢", "宋", "唐", "许", "韩", "冯", "邓", "曹"
+};
+const vector<string> GIVEN_NAME_CHARS = {
+	"伟", "芳", "娜", "敏", "静", "丽", "强", "磊", "军", "洋", "勇", "艳", "杰", "娟", "涛", "明",
+	"超", "秀", "霞", "平", "刚", "桂", "英", "华", "玉", "萍", "红", "鹏", "辉", "宇", "浩", "欣"
+};
+
+// 车次前缀及对应的平均速度（公里/小时）和每公里票价
+struct TrainType {
+	char prefix;
+	double speed;
+	double farePerKm;
+	int minSeats;
+	int maxSeats;
+};
+const vector<TrainType> TRAIN_TYPES = {
+	{'G', 260.0, 0.46, 500, 1000},
+	{'D', 190.0, 0.31, 400, 800},
+	{'C', 180.0, 0.30, 400, 600},
+	{'Z', 140.0, 0.16, 800, 1200},
+	{'T', 120.0, 0.14, 800, 1200},
+	{'K', 100.0, 0.12, 900, 1400}
+};
+
+string formatTime(int minutes) {
+	minutes = ((minutes % 1440) + 1440) % 1440;
+	char buf[8];
+	snprintf(buf, sizeof(buf), "%02d:%02d", minutes / 60, minutes % 60);
+	return buf;
+}
+
+// 生成站点：围绕若干中心城市聚集分布，站名唯一
+vector<Station> generateStations(Random& rng, int count) {
+	vector<Station> stations;
+	unordered_set<string> usedNames;
+
+	int hubCount = max(1, count / 150);
+	vector<pair<double, double>> hubs;
+	for (int i = 0; i < hubCount; ++i) {
+		hubs.push_back({rng.unit() * MAP_WIDTH, rng.unit() * MAP_HEIGHT});
+	}
+
+	size_t maxNames = NAME_CHARS.size() * NAME_CHARS.size() * NAME_SUFFIXES.size();
+	if (static_cast<size_t>(count) > maxNames) {
+		cout << "站点数量不能超过 " << maxNames << endl;
+		exit(1);
+	}
+
+	while (static_cast<int>(stations.size()) < count) {
+		string name = NAME_CHARS[rng.below(NAME_CHARS.size())] + NAME_CHARS[rng.below(NAME_CHARS.size())] +
+					  NAME_SUFFIXES[rng.below(NAME_SUFFIXES.size())];
+		if (!usedNames.insert(name).second) {
+			continue;
+		}
+
+		// 七成站点在中心城市附近，其余均匀分布
+		double x, y;
+		if (rng.unit() < 0.7) {
+			const auto& hub = hubs[rng.below(hubs.size())];
+			double radius = 250.0 * sqrt(rng.unit());
+			double angle = rng.unit() * 2 * PI;
+			x = min(MAP_WIDTH, max(0.0, hub.first + radius * cos(angle)));
+			y = min(MAP_HEIGHT, max(0.0, hub.second + radius * sin(angle)));
+		} else {
+			x = rng.unit() * MAP_WIDTH;
+			y = rng.unit() * MAP_HEIGHT;
+		}
+		stations.push_back({name, x, y});
+	}
+	return stations;
+}
+
+int railDistance(const Station& a, const Station& b, Random& rng) {
+	double straight = hypot(a.x - b.x, a.y - b.y);
+	return max(10, static_cast<int>(straight * (1.1 + 0.2 * rng.unit())));
+}
+
+void addEdge(vector<vector<Edge>>& graph, int a, int b, int distance) {
+	for (const auto& edge : graph[a]) {
+		if (edge.to == b) return;
+	}
+	graph[a].push_back({b, distance});
+	graph[b].push_back({a, distance});
+}
+
+int findRoot(vector<int>& parent, int x) {
+	while (parent[x] != x) {
+		parent[x] = parent[parent[x]];
+		x = parent[x];
+	}
+	return x;
+}
+
+// 生成线路：每个站连接最近的几个站，再把不连通的部分连起来
+vector<vector<Edge>> generateNetwork(const vector<Station>& stations, Random& rng) {
+	int n = static_cast<int>(stations.size());
+	vector<vector<Edge>> graph(n);
+
+	// 按 x 坐标排序后只在附近窗口内找最近邻，避免 O(n²)
+	vector<int> byX(n);
+	iota(byX.begin(), byX.end(), 0);
+	sort(byX.begin(), byX.end(), [&](int a, int b) { return stations[a].x < stations[b].x; });
+	vector<int> rankOf(n);
+	for (int i = 0; i < n; ++i) rankOf[byX[i]] = i;
+
+	const int window = 200;
+	for (int s = 0; s < n; ++s) {
+		vector<pair<double, int>> candidates;
+		int r = rankOf[s];
+		for (int k = max(0, r - window); k < min(n, r + window + 1); ++k) {
+			int t = byX[k];
+			if (t == s) continue;
+			candidates.push_back({hypot(stations[s].x - stations[t].x, stations[s].y - stations[t].y), t});
+		}
+		int keep = min(NEIGHBORS_PER_STATION, static_cast<int>(candidates.size()));
+		partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end());
+		for (int k = 0; k < keep; ++k) {
+			int t = candidates[k].second;
+			addEdge(graph, s, t, railDistance(stations[s], stations[t], rng));
+		}
+	}
+
+	// 连通各分量：每个分量连到编号最小的分量中最近的站
+	vector<int> parent(n);
+	iota(parent.begin(), parent.end(), 0);
+	for (int s = 0; s < n; ++s) {
+		for (const auto& edge : graph[s]) {
+			parent[findRoot(parent, s)] = findRoot(parent, edge.to);
+		}
+	}
+	for (int s = 0; s < n; ++s) {
+		if (findRoot(parent, s) == findRoot(parent, 0)) continue;
+		int best = -1;
+		double bestDistance = 0;
+		for (int t = 0; t < n; ++t) {
+			if (findRoot(parent, t) != findRoot(parent, 0)) continue;
+			double d = hypot(stations[s].x - stations[t].x, stations[s].y - stations[t].y);
+			if (best < 0 || d < bestDistance) {
+				best = t;
+				bestDistance = d;
+			}
+		}
+		addEdge(graph, s, best, railDistance(stations[s], stations[best], rng));
+		parent[findRoot(parent, s)] = findRoot(parent, 0);
+	}
+	return graph;
+}
+
+void writeMap(const string& path, const vector<Station>& stations, const vector<vector<Edge>>& graph) {
+	ofstream out(path);
+	for (size_t s = 0; s < stations.size(); ++s) {
+		out << stations[s].name;
+		for (const auto& edge : graph[s]) {
+			out << "," << stations[edge.to].name << "," << edge.distance;
+		}
+		out << "\n";
+	}
+}
+
+// 单源最短路，返回前驱数组
+void shortestPaths(const vector<vector<Edge>>& graph, int source, vector<long long>& dist, vector<int>& previous) {
+	int n = static_cast<int>(graph.size());
+	dist.assign(n, -1);
+	previous.assign(n, -1);
+	priority_queue<pair<long long, int>, vector<pair<long long, int>>, greater<>> queue;
+	dist[source] = 0;
+	queue.push({0, source});
+	while (!queue.empty()) {
+		auto [d, u] = queue.top();
+		queue.pop();
+		if (d != dist[u]) continue;
+		for (const auto& edge : graph[u]) {
+			long long nd = d + edge.distance;
+			if (dist[edge.to] < 0 || nd < dist[edge.to]) {
+				dist[edge.to] = nd;
+				previous[edge.to] = u;
+				queue.push({nd, edge.to});
+			}
+		}
+	}
+}
+
+string joinMatrix(const vector<vector<int>>& matrix) {
+	string result;
+	for (size_t i = 0; i < matrix.size(); ++i) {
+		if (i) result += "|";
+		for (size_t j = 0; j < matrix[i].size(); ++j) {
+			if (j) result += ";";
+			result += to_string(matrix[i][j]);
+		}
+	}
+	return result;
+}
+
+// 生成车次：沿最短路选取停靠站，时刻、票价、余票与距离一致
+void writeTrains(const string& path, const vector<Station>& stations, const vector<vector<Edge>>& graph,
+				 int trainCount, Random& rng) {
+	ofstream out(path);
+	int n = static_cast<int>(stations.size());
+	size_t maxTrains = TRAIN_TYPES.size() * 9999;
+	if (static_cast<size_t>(trainCount) > maxTrains) {
+		cout << "车次数量不能超过 " << maxTrains << endl;
+		exit(1);
+	}
+	vector<int> nextNumber(TRAIN_TYPES.size(), 1);
+
+	vector<long long> dist;
+	vector<int> previous;
+	int written = 0;
+	while (written < trainCount) {
+		int source = static_cast<int>(rng.below(n));
+		shortestPaths(graph, source, dist, previous);
+
+		for (int k = 0; k < TRAINS_PER_SOURCE && written < trainCount; ++k) {
+			int target = static_cast<int>(rng.below(n));
+			if (target == source || dist[target] < 0) continue;
+
+			// 路径上的全部站点（起点在前）
+			vector<int> path;
+			for (int v = target; v >= 0; v = previous[v]) path.push_back(v);
+			reverse(path.begin(), path.end());
+			if (static_cast<int>(path.size()) < MIN_STOPS) continue;
+
+			// 车次类型随机选取，某种类型的号段用完时换下一种
+			size_t typeIdx = rng.below(TRAIN_TYPES.size());
+			while (nextNumber[typeIdx] > 9999) typeIdx = (typeIdx + 1) % TRAIN_TYPES.size();
+			const TrainType& type = TRAIN_TYPES[typeIdx];
+
+			// 停靠站：保留起终点，中间站随机抽取；总时长超过上限时提前终到
+			int stopCount = rng.range(MIN_STOPS, min(MAX_STOPS, static_cast<int>(path.size())));
+			vector<int> stopPositions = {0};
+			vector<int> middle(path.size() - 2);
+			iota(middle.begin(), middle.end(), 1);
+			for (int i = 0; i < stopCount - 2; ++i) {
+				swap(middle[i], middle[i + rng.below(middle.size() - i)]);
+				stopPositions.push_back(middle[i]);
+			}
+			stopPositions.push_back(static_cast<int>(path.size()) - 1);
+			sort(stopPositions.begin(), stopPositions.end());
+
+			vector<int> stops;
+			vector<long long> cumulativeKm;
+			vector<int> minutes;
+			int departure = rng.range(5 * 60, 22 * 60);
+			for (int pos : stopPositions) {
+				long long km = dist[path[pos]];
+				int arrival = departure;
+				if (!stops.empty()) {
+					long long segment = km - cumulativeKm.back();
+					int dwell = rng.range(2, 6);
+					arrival = minutes.back() + dwell + static_cast<int>(segment * 60.0 / type.speed + 0.5);
+					if (arrival - departure > MAX_TRAVEL_MINUTES) break;
+				}
+				stops.push_back(path[pos]);
+				cumulativeKm.push_back(km);
+				minutes.push_back(arrival);
+			}
+			if (static_cast<int>(stops.size()) < 2) continue;
+			size_t m = stops.size();
+
+			// 时刻表：前半为正向各站时刻，后半为返程列车在各站的时刻（按站点下标排列）
+			int turnaround = rng.range(30, 120);
+			int reverseStart = minutes.back() + turnaround;
+			vector<string> times(2 * m);
+			for (size_t i = 0; i < m; ++i) {
+				times[i] = formatTime(minutes[i]);
+				times[m + i] = formatTime(reverseStart + (minutes.back() - minutes[i]));
+			}
+
+			// 余票与票价矩阵
+			int seats = rng.range(type.minSeats, type.maxSeats);
+			vector<vector<int>> seatMatrix(m, vector<int>(m, 0));
+			vector<vector<int>> priceMatrix(m, vector<int>(m, 0));
+			for (size_t i = 0; i < m; ++i) {
+				for (size_t j = 0; j < m; ++j) {
+					if (i == j) continue;
+					seatMatrix[i][j] = seats;
+					long long km = llabs(cumulativeKm[j] - cumulativeKm[i]);
+					priceMatrix[i][j] = max(1, static_cast<int>(km * type.farePerKm + 0.5));
+				}
+			}
+
+			out << type.prefix << nextNumber[typeIdx]++ << ",";
+			for (size_t i = 0; i < m; ++i) {
+				out << (i ? "|" : "") << stations[stops[i]].name;
+			}
+			out << ",";
+			for (size_t i = 0; i < times.size(); ++i) {
+				out << (i ? "|" : "") << times[i];
+			}
+			out << "," << joinMatrix(seatMatrix) << "," << joinMatrix(priceMatrix) << "\n";
+			written++;
+		}
+	}
+}
+
+// 身份证校验码（GB 11643）
+char idCheckDigit(const string& first17) {
+	static const int weights[17] = {7, 9, 10, 5, 8, 4, 2, 1, 6, 3, 7, 9, 10, 5, 8, 4, 2};
+	static const char codes[] = "10X98765432";
+	int sum = 0;
+	for (int i = 0; i < 17; ++i) sum += (first17[i] - '0') * weights[i];
+	return codes[sum % 11];
+}
+
+// 生成用户：手机号按序号唯一，密码满足程序的强度要求
+void writeUsers(const string& path, int userCount, Random& rng) {
+	ofstream out(path);
+	static const char alnum[] = "abcdefghijkmnpqrstuvwxyz23456789";
+	static const int regions[] = {110101, 310104, 440106, 510107, 330106, 420106, 610113, 320102, 500103, 120101};
+
+	for (int i = 0; i < userCount; ++i) {
+		char phone[16];
+		snprintf(phone, sizeof(phone), "1%d%09d", 3 + static_cast<int>(rng.below(7)), i);
+
+		string password = "Rw";
+		for (int c = 0; c < 6; ++c) password += alnum[rng.below(sizeof(alnum) - 1)];
+		password += to_string(rng.below(10));
+
+		string name = SURNAMES[rng.below(SURNAMES.size())] + GIVEN_NAME_CHARS[rng.below(GIVEN_NAME_CHARS.size())];
+		if (rng.unit() < 0.6) name += GIVEN_NAME_CHARS[rng.below(GIVEN_NAME_CHARS.size())];
+
+		char id17[20];
+		snprintf(id17, sizeof(id17), "%06d%04d%02d%02d%03d", regions[rng.below(10)], rng.range(1950, 2008),
+				 rng.range(1, 12), rng.range(1, 28), rng.range(0, 999));
+		string idNumber = string(id17) + idCheckDigit(id17);
+
+		char balance[32];
+		snprintf(balance, sizeof(balance), "%.2f", rng.range(0, 500000) / 100.0);
+
+		out << phone << "\n" << password << "\n" << name << "\n" << idNumber << "\n" << balance << "\n";
+	}
+}
+
+int main(int argc, char* argv[]) {
+	Options options;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		string arg = argv[i];
+		string value = argv[i + 1];
+		if (arg == "--seed") options.seed = stoull(value);
+		else if (arg == "--stations") options.stationCount = stoi(value);
+		else if (arg == "--trains") options.trainCount = stoi(value);
+		else if (arg == "--users") options.userCount = stoi(value);
+		else if (arg == "--out") options.outDir = value;
+		else {
+			cout << "未知参数: " << arg << endl;
+			return 1;
+		}
+	}
+	if (options.stationCount < MIN_STOPS) {
+		cout << "站点数量至少为 " << MIN_STOPS << endl;
+		return 1;
+	}
+
+	// 每类数据使用独立的随机数序列，调整一类数量不影响其他类的内容
+	Random stationRng(options.seed);
+	Random trainRng(options.seed ^ 0x5452414953ULL);
+	Random userRng(options.seed ^ 0x5553455253ULL);
+
+	vector<Station> stations = generateStations(stationRng, options.stationCount);
+	vector<vector<Edge>> graph = generateNetwork(stations, stationRng);
+
+	filesystem::create_directories(options.outDir);
+	string dir = options.outDir + "/";
+	writeMap(dir + "map.txt", stations, graph);
+	cout << "已生成 " << stations.size() << " 个站点: " << dir << "map.txt" << endl;
+
+	writeTrains(dir + "new_trains.txt", stations, graph, options.trainCount, trainRng);
+	cout << "已生成 " << options.trainCount << " 个车次: " << dir << "new_trains.txt" << endl;
+
+	writeUsers(dir + "users.txt", options.userCount, userRng);
+	cout << "已生成 " << options.userCount << " 个用户: " << dir << "users.txt" << endl;
+	return 0;
+}
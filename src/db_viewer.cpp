@@ -1,89 +1,704 @@
 #include <iostream>
-#include <QApplication>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <QCoreApplication>
 #include <QSqlDatabase>
 #include <QSqlQuery>
+#include <QSqlRecord>
 #include <QSqlError>
+#include <QVariant>
+#include <QStringList>
 #include <QDebug>
 
 using namespace std;
 
-void printTable(const QString& tableName) {
-    cout << "\n========== " << tableName.toStdString() << " 表 ==========" << endl;
-    
+// 用法：db_viewer [选项]
+//   --db 文件          数据库文件（默认 railway_system.db）
+//   --table 表名       只查看指定的表，可重复；默认查看全部表
+//   --columns a,b,c    只输出指定的列
+//   --where 条件       SQL 过滤条件，例如 --where "user_id = 3 AND price > 100"
+//   --limit N          最多输出 N 行（table 格式默认 100 行，csv / ndjson 默认不限）
+//   --offset N         跳过前 N 行（LIMIT/OFFSET 分页）
+//   --after ROWID      只输出 rowid 大于 ROWID 的行（按 rowid 的 keyset 分页，大偏移时比 --offset 快）
+//   --format 格式      table（默认）、csv 或 ndjson
+//   --output 文件      输出到文件（默认输出到终端）
+//   --analytics        运营分析报表：上座率、车次收入、热门区间、停开影响
+//   --top N            分析报表每节输出前 N 行（默认 20，0 表示全部）
+// 查询以只进游标逐行读取并写入缓冲区，内存占用与表的大小无关。
+// 主库启用过分片（settings 表记录了分片数）时自动挂接各分片文件：user_trips 和 dated_seats 逐个分片输出，
+// --limit、--offset、--after 分别作用于每个分片；分析报表合并全部分片计算。
+
+const int DEFAULT_TABLE_LIMIT = 100;
+const size_t OUTPUT_BUFFER_BYTES = 64 * 1024;
+const int DEFAULT_ANALYTICS_TOP = 20;
+
+// 分片模式下存放在分片文件中的表及其列（与 railway 的分片表结构一致）
+const vector<pair<QString, QString>> SHARDED_TABLES = {
+    {"user_trips", "id, user_id, train_number, start_station, end_station, departure_time, arrival_time, price, "
+                   "travel_date, seat_class, car_number, seat_number, ticket_id"},
+    {"dated_seats", "train_number, service_date, seats"},
+};
+
+// 提示信息的输出位置：csv / ndjson 输出到终端时改为 stderr，重定向导出的文件中只有数据
+ostream* info = &cout;
+
+struct ViewerOptions {
+    QString dbPath = "railway_system.db";
+    QStringList tables;
+    QStringList columns;
+    QString where;
+    long long limit = -1;
+    long long offset = 0;
+    long long afterRowid = -1;
+    QString format = "table";
+    QString outputPath;
+    bool analytics = false;
+    long long top = DEFAULT_ANALYTICS_TOP;
+};
+
+// 带缓冲的输出：攒满缓冲区再写出，避免逐行刷新
+class BufferedWriter {
+public:
+    explicit BufferedWriter(ostream& out) : out(out) {
+        buffer.reserve(OUTPUT_BUFFER_BYTES);
+    }
+    ~BufferedWriter() {
+        flush();
+    }
+    void write(const string& text) {
+        buffer += text;
+        if (buffer.size() >= OUTPUT_BUFFER_BYTES) {
+            flush();
+        }
+    }
+    void flush() {
+        out.write(buffer.data(), buffer.size());
+        out.flush();
+        buffer.clear();
+    }
+private:
+    ostream& out;
+    string buffer;
+};
+
+// 给标识符加引号（表名、列名已校验存在，这里只防止关键字冲突）
+QString quoteIdentifier(const QString& name) {
+    return "\"" + QString(name).replace("\"", "\"\"") + "\"";
+}
+
+string csvField(const QVariant& value) {
+    if (value.isNull()) return "";
+    string text = value.toString().toStdString();
+    if (text.find_first_of(",\"\r\n") == string::npos) {
+        return text;
+    }
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+string jsonString(const string& text) {
+    string result = "\"";
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    result += escaped;
+                } else {
+                    result += static_cast<char>(c);
+                }
+        }
+    }
+    return result + "\"";
+}
+
+string jsonValue(const QVariant& value) {
+    if (value.isNull()) return "null";
+    switch (value.typeId()) {
+        case QMetaType::Int:
+        case QMetaType::LongLong:
+        case QMetaType::UInt:
+        case QMetaType::ULongLong:
+        case QMetaType::Double:
+            return value.toString().toStdString();
+        default:
+            return jsonString(value.toString().toStdString());
+    }
+}
+
+// 表的全部列名
+QStringList tableColumns(const QString& schema, const QString& tableName) {
+    QStringList columns;
+    QSqlQuery query;
+    if (query.exec("PRAGMA " + quoteIdentifier(schema) + ".table_info(" + quoteIdentifier(tableName) + ")")) {
+        while (query.next()) {
+            columns << query.value(1).toString();
+        }
+    }
+    return columns;
+}
+
+// 按选项拼出查询语句，列名不存在时返回空字符串
+QString buildSelect(const QString& schema, const QString& tableName, const ViewerOptions& options, long long limit) {
+    QStringList existing = tableColumns(schema, tableName);
+    QStringList selected;
+    for (const QString& column : options.columns) {
+        if (!existing.contains(column)) {
+            *info << "表 " << tableName.toStdString() << " 没有列 " << column.toStdString() << endl;
+            return "";
+        }
+        selected << quoteIdentifier(column);
+    }
+
+    // 最后附加 rowid 列（不输出），用于给出 keyset 分页的下一页位置
+    QString sql = "SELECT " + (selected.isEmpty() ? QString("*") : selected.join(", ")) + ", rowid FROM " + quoteIdentifier(schema) + "." + quoteIdentifier(tableName);
+    QStringList conditions;
+    if (!options.where.isEmpty()) conditions << "(" + options.where + ")";
+    if (options.afterRowid >= 0) conditions << "rowid > " + QString::number(options.afterRowid);
+    if (!conditions.isEmpty()) sql += " WHERE " + conditions.join(" AND ");
+    sql += " ORDER BY rowid";
+    sql += " LIMIT " + QString::number(limit);
+    if (options.offset > 0) sql += " OFFSET " + QString::number(options.offset);
+    return sql;
+}
+
+// 输出 schema 库（main 或挂接的分片 shardK）中的一张表
+void printTable(const QString& schema, const QString& tableName, const ViewerOptions& options, ostream& out) {
+    long long limit = options.limit >= 0 ? options.limit : (options.format == "table" ? DEFAULT_TABLE_LIMIT : -1);
+    QString sql = buildSelect(schema, tableName, options, limit);
+    string title = tableName.toStdString() + (schema == "main" ? "" : "（" + schema.toStdString() + "）");
+    if (sql.isEmpty()) {
+        return;
+    }
+
+    // 只进游标：驱动不缓存已读的行
     QSqlQuery query;
-    if (!query.exec("SELECT * FROM " + tableName)) {
-        cout << "查询失败: " << query.lastError().text().toStdString() << endl;
+    query.setForwardOnly(true);
+    if (!query.exec(sql)) {
+        *info << "查询失败: " << query.lastError().text().toStdString() << endl;
         return;
     }
-    
-    // 获取列数
-    int columnCount = query.record().count();
-    
+
+    QSqlRecord record = query.record();
+    int columnCount = record.count() - 1;
+    int rowidColumn = columnCount;
+    BufferedWriter writer(out);
+
+    if (options.format == "table") {
+        writer.write("\n========== " + title + " 表 ==========\n");
+    }
+
     // 打印列标题
-    for (int i = 0; i < columnCount; i++) {
-        cout << query.record().fieldName(i).toStdString();
-        if (i < columnCount - 1) cout << " | ";
+    if (options.format == "table" || options.format == "csv") {
+        string header;
+        for (int i = 0; i < columnCount; i++) {
+            header += record.fieldName(i).toStdString();
+            if (i < columnCount - 1) header += options.format == "csv" ? "," : " | ";
+        }
+        writer.write(header + "\n");
     }
-    cout << endl;
-    
+
     // 打印分隔线
-    for (int i = 0; i < columnCount; i++) {
-        cout << "----------";
-        if (i < columnCount - 1) cout << "---";
+    if (options.format == "table") {
+        string separator;
+        for (int i = 0; i < columnCount; i++) {
+            separator += "----------";
+            if (i < columnCount - 1) separator += "---";
+        }
+        writer.write(separator + "\n");
     }
-    cout << endl;
-    
+
     // 打印数据行
-    int rowCount = 0;
+    long long rowCount = 0;
+    long long lastRowid = -1;
+    string line;
     while (query.next()) {
+        lastRowid = query.value(rowidColumn).toLongLong();
+        line.clear();
+        if (options.format == "ndjson") line += "{";
         for (int i = 0; i < columnCount; i++) {
-            QString value = query.value(i).toString();
-            if (value.length() > 30) {
-                value = value.left(27) + "...";
+            QVariant value = query.value(i);
+            if (options.format == "csv") {
+                line += csvField(value);
+                if (i < columnCount - 1) line += ",";
+            } else if (options.format == "ndjson") {
+                line += jsonString(record.fieldName(i).toStdString()) + ":" + jsonValue(value);
+                if (i < columnCount - 1) line += ",";
+            } else {
+                QString text = value.toString();
+                if (text.length() > 30) {
+                    text = text.left(27) + "...";
+                }
+                line += text.toStdString();
+                if (i < columnCount - 1) line += " | ";
             }
-            cout << value.toStdString();
-            if (i < columnCount - 1) cout << " | ";
         }
-        cout << endl;
+        if (options.format == "ndjson") line += "}";
+        writer.write(line + "\n");
         rowCount++;
     }
-    cout << "总共 " << rowCount << " 行数据" << endl;
+    writer.flush();
+
+    *info << title << ": 输出 " << rowCount << " 行数据";
+    if (limit >= 0 && rowCount == limit) {
+        *info << "（已达到行数上限，下一页: --after " << lastRowid << "）";
+    }
+    *info << endl;
+}
+
+// ==================== 运营分析 ====================
+// 上座率来自余票：trains.segment_available_seats 是每个运行日的初始余票（模板），
+// dated_seats 是已售过票的运行日的实际余票，两者之差即为该区间售出的座位数。
+// dated_seats 按车次排序后逐行扫描，每个车次的数据在内存中累加完即输出，内存只与单个车次的站数有关。
+// 收入、热门区间和停开影响直接用 user_trips 上的聚合查询在 SQLite 中计算。
+
+struct TrainTemplate {
+    vector<string> stations;
+    vector<int> seats; // 按 from * 站数 + to 平铺的初始余票
+};
+
+// 解析 "a;b;c|d;e;f" 格式的矩阵到平铺数组（逐字符扫描，不产生临时字符串）
+void parseFlatMatrix(const string& text, size_t n, vector<int>& out) {
+    out.assign(n * n, 0);
+    size_t row = 0, col = 0;
+    int value = 0;
+    bool negative = false;
+    for (size_t k = 0; k <= text.size(); k++) {
+        char c = k < text.size() ? text[k] : '|';
+        if (c >= '0' && c <= '9') {
+            value = value * 10 + (c - '0');
+        } else if (c == '-') {
+            negative = true;
+        } else if (c == ';' || c == '|') {
+            if (row < n && col < n) out[row * n + col] = negative ? -value : value;
+            value = 0;
+            negative = false;
+            if (c == ';') {
+                col++;
+            } else {
+                row++;
+                col = 0;
+            }
+        }
+    }
+}
+
+string formatPercent(double ratio) {
+    char text[16];
+    snprintf(text, sizeof(text), "%.1f%%", ratio * 100.0);
+    return text;
+}
+
+string formatAmount(double amount) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.0f", amount);
+    return text;
+}
+
+// 把若干列按固定宽度拼成一行（中文按显示宽度 2 计算）
+string formatRow(const vector<string>& fields, const vector<int>& widths) {
+    string line;
+    for (size_t i = 0; i < fields.size(); i++) {
+        line += fields[i];
+        if (i + 1 == fields.size()) break;
+        int width = 0;
+        for (size_t k = 0; k < fields[i].size(); k++) {
+            unsigned char c = fields[i][k];
+            if (c < 0x80) width += 1;
+            else if ((c & 0xC0) == 0xC0) width += 2;
+        }
+        line += string(max(1, widths[i] - width), ' ');
+    }
+    return line + "\n";
+}
+
+// 每个车次的上座率汇总
+struct TrainLoad {
+    string trainNumber;
+    int serviceDays = 0;
+    long long soldSeats = 0;
+    long long capacity = 0;
+    string busiestLeg;
+    double busiestLegAverage = 0; // 最繁忙的相邻两站间平均每天在车人数
+};
+
+// 单个区间（起止站）的上座率
+struct SegmentLoad {
+    string trainNumber;
+    string fromStation;
+    string toStation;
+    long long soldSeats = 0;
+    long long capacity = 0;
+    double loadFactor() const { return capacity > 0 ? double(soldSeats) / capacity : 0; }
+};
+
+bool higherLoad(const SegmentLoad& a, const SegmentLoad& b) {
+    if (a.loadFactor() != b.loadFactor()) return a.loadFactor() > b.loadFactor();
+    return a.soldSeats > b.soldSeats;
+}
+
+void printLoadFactors(const ViewerOptions& options, BufferedWriter& writer) {
+    unordered_map<string, TrainTemplate> templates;
+    QSqlQuery trainQuery;
+    trainQuery.setForwardOnly(true);
+    if (!trainQuery.exec("SELECT train_number, stations, segment_available_seats FROM trains")) {
+        *info << "查询列车数据失败: " << trainQuery.lastError().text().toStdString() << endl;
+        return;
+    }
+    while (trainQuery.next()) {
+        TrainTemplate& tpl = templates[trainQuery.value(0).toString().toStdString()];
+        for (const QString& station : trainQuery.value(1).toString().split("|")) {
+            tpl.stations.push_back(station.toStdString());
+        }
+        parseFlatMatrix(trainQuery.value(2).toString().toStdString(), tpl.stations.size(), tpl.seats);
+    }
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT train_number, seats FROM dated_seats ORDER BY train_number")) {
+        *info << "查询运行日余票失败: " << query.lastError().text().toStdString() << endl;
+        return;
+    }
+
+    vector<TrainLoad> trainLoads;
+    vector<SegmentLoad> topSegments; // 上座率最高的区间（保持为最小堆，堆顶是当前第 N 名）
+    size_t segmentLimit = options.top > 0 ? size_t(options.top) : SIZE_MAX;
+
+    // 当前车次的累加状态
+    string current;
+    const TrainTemplate* tpl = nullptr;
+    vector<long long> soldCells; // 各区间累计售出
+    vector<long long> legLoad;   // 相邻两站间累计在车人数
+    vector<int> seats;
+    TrainLoad load;
+
+    auto finishTrain = [&]() {
+        if (!tpl || load.serviceDays == 0) return;
+        size_t n = tpl->stations.size();
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = i + 1; j < n; j++) {
+                long long capacity = (long long)tpl->seats[i * n + j] * load.serviceDays;
+                if (capacity <= 0) continue;
+                load.soldSeats += soldCells[i * n + j];
+                load.capacity += capacity;
+                SegmentLoad segment{load.trainNumber, tpl->stations[i], tpl->stations[j], soldCells[i * n + j], capacity};
+                if (segment.soldSeats <= 0) continue;
+                if (topSegments.size() < segmentLimit) {
+                    topSegments.push_back(segment);
+                    push_heap(topSegments.begin(), topSegments.end(), higherLoad);
+                } else if (higherLoad(segment, topSegments.front())) {
+                    pop_heap(topSegments.begin(), topSegments.end(), higherLoad);
+                    topSegments.back() = segment;
+                    push_heap(topSegments.begin(), topSegments.end(), higherLoad);
+                }
+            }
+        }
+        // 差分数组求前缀和得到每段在车人数
+        long long onBoard = 0;
+        for (size_t k = 0; k + 1 < n; k++) {
+            onBoard += legLoad[k];
+            double average = double(onBoard) / load.serviceDays;
+            if (average > load.busiestLegAverage) {
+                load.busiestLegAverage = average;
+                load.busiestLeg = tpl->stations[k] + "-" + tpl->stations[k + 1];
+            }
+        }
+        trainLoads.push_back(load);
+    };
+
+    while (query.next()) {
+        string trainNumber = query.value(0).toString().toStdString();
+        if (trainNumber != current) {
+            finishTrain();
+            current = trainNumber;
+            auto it = templates.find(trainNumber);
+            tpl = it == templates.end() ? nullptr : &it->second;
+            load = TrainLoad();
+            load.trainNumber = trainNumber;
+            if (tpl) {
+                size_t n = tpl->stations.size();
+                soldCells.assign(n * n, 0);
+                legLoad.assign(n, 0);
+            }
+        }
+        if (!tpl) continue;
+
+        size_t n = tpl->stations.size();
+        parseFlatMatrix(query.value(1).toString().toStdString(), n, seats);
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = i + 1; j < n; j++) {
+                int sold = tpl->seats[i * n + j] - seats[i * n + j];
+                if (sold <= 0) continue;
+                soldCells[i * n + j] += sold;
+                legLoad[i] += sold;
+                legLoad[j] -= sold;
+            }
+        }
+        load.serviceDays++;
+    }
+    finishTrain();
+
+    sort(trainLoads.begin(), trainLoads.end(), [](const TrainLoad& a, const TrainLoad& b) {
+        double la = a.capacity > 0 ? double(a.soldSeats) / a.capacity : 0;
+        double lb = b.capacity > 0 ? double(b.soldSeats) / b.capacity : 0;
+        return la > lb;
+    });
+    size_t trainCount = options.top > 0 ? min(trainLoads.size(), size_t(options.top)) : trainLoads.size();
+    vector<int> trainWidths = {12, 10, 10, 12, 10, 24};
+    writer.write("\n========== 车次上座率（按已售运行日统计，共 " + to_string(trainLoads.size()) + " 个车次） ==========\n");
+    writer.write(formatRow({"车次", "运行日数", "售出座位", "座位容量", "上座率", "最繁忙区段", "日均在车"}, trainWidths));
+    for (size_t i = 0; i < trainCount; i++) {
+        const TrainLoad& t = trainLoads[i];
+        writer.write(formatRow({t.trainNumber, to_string(t.serviceDays), to_string(t.soldSeats), to_string(t.capacity),
+                                formatPercent(t.capacity > 0 ? double(t.soldSeats) / t.capacity : 0),
+                                t.busiestLeg.empty() ? "-" : t.busiestLeg, formatAmount(t.busiestLegAverage)}, trainWidths));
+    }
+
+    sort_heap(topSegments.begin(), topSegments.end(), higherLoad);
+    vector<int> segmentWidths = {12, 24, 10, 10};
+    writer.write("\n========== 上座率最高的区间 ==========\n");
+    writer.write(formatRow({"车次", "区间", "售出座位", "座位容量", "上座率"}, segmentWidths));
+    for (const SegmentLoad& segment : topSegments) {
+        writer.write(formatRow({segment.trainNumber, segment.fromStation + "-" + segment.toStation,
+                                to_string(segment.soldSeats), to_string(segment.capacity),
+                                formatPercent(segment.loadFactor())}, segmentWidths));
+    }
+}
+
+// 执行一条聚合查询并按列输出
+void printAggregate(const string& title, const QString& sql, const vector<string>& headers, const vector<int>& widths,
+                    const ViewerOptions& options, BufferedWriter& writer) {
+    QString limited = sql;
+    if (options.top > 0) limited += " LIMIT " + QString::number(options.top);
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!query.exec(limited)) {
+        *info << title << " 查询失败: " << query.lastError().text().toStdString() << endl;
+        return;
+    }
+
+    writer.write("\n========== " + title + " ==========\n");
+    writer.write(formatRow(headers, widths));
+    vector<string> fields(headers.size());
+    while (query.next()) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            fields[i] = query.value(int(i)).toString().toStdString();
+        }
+        writer.write(formatRow(fields, widths));
+    }
+}
+
+void printAnalytics(const ViewerOptions& options, ostream& out) {
+    auto started = chrono::steady_clock::now();
+    BufferedWriter writer(out);
+
+    printLoadFactors(options, writer);
+
+    printAggregate("车次收入",
+                   "SELECT train_number, COUNT(*), SUM(price), COUNT(DISTINCT travel_date) FROM user_trips "
+                   "GROUP BY train_number ORDER BY SUM(price) DESC",
+                   {"车次", "售票数", "收入", "乘车日期数"}, {12, 10, 12}, options, writer);
+
+    printAggregate("最繁忙的起止站",
+                   "SELECT start_station, end_station, COUNT(*), SUM(price) FROM user_trips "
+                   "GROUP BY start_station, end_station ORDER BY COUNT(*) DESC",
+                   {"出发站", "到达站", "售票数", "收入"}, {14, 14, 10}, options, writer);
+
+    // 停开影响：今天及以后乘车、需要退票或改签的车票
+    printAggregate("停开列车影响（今天及以后的车票）",
+                   "SELECT s.train_number, COUNT(t.id), COUNT(DISTINCT t.user_id), COALESCE(SUM(t.price), 0) "
+                   "FROM suspended_trains s LEFT JOIN user_trips t "
+                   "ON t.train_number = s.train_number AND t.travel_date >= date('now', 'localtime') "
+                   "GROUP BY s.train_number ORDER BY COUNT(t.id) DESC",
+                   {"车次", "受影响车票", "受影响用户", "涉及金额"}, {12, 12, 12}, options, writer);
+
+    writer.flush();
+    long long elapsedMs = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+    *info << "分析完成，用时 " << elapsedMs << " ms" << endl;
+}
+
+// 主库的 settings 表记录了分片数时，把分片文件挂接为 shard0、shard1 …，返回分片数；出错时返回 -1
+int attachShards(const QString& dbPath) {
+    QSqlQuery query;
+    if (!query.exec("SELECT value FROM settings WHERE key = 'shard_count'") || !query.next()) {
+        return 0;
+    }
+    int count = query.value(0).toInt();
+    QString base = dbPath.endsWith(".db") ? dbPath.left(dbPath.size() - 3) : dbPath;
+    for (int k = 0; k < count; k++) {
+        QString path = base + ".shard" + QString::number(k) + ".db";
+        if (!ifstream(path.toStdString()).good()) {
+            *info << "缺少分片文件: " << path.toStdString() << endl;
+            return -1;
+        }
+        QSqlQuery attach;
+        attach.prepare("ATTACH DATABASE ? AS shard" + QString::number(k));
+        attach.addBindValue(path);
+        if (!attach.exec()) {
+            *info << "无法挂接分片 " << path.toStdString() << ": " << attach.lastError().text().toStdString() << endl;
+            return -1;
+        }
+    }
+    return count;
+}
+
+// 分析报表用：为分片表建立同名的临时视图（临时库优先于主库解析），合并全部分片
+bool createShardViews(int shardCount) {
+    for (const auto& table : SHARDED_TABLES) {
+        QStringList parts;
+        for (int k = 0; k < shardCount; k++) {
+            parts << "SELECT " + table.second + " FROM shard" + QString::number(k) + "." + table.first;
+        }
+        QSqlQuery query;
+        if (!query.exec("CREATE TEMP VIEW " + table.first + " AS " + parts.join(" UNION ALL "))) {
+            *info << "合并分片 " << table.first.toStdString() << " 失败: " << query.lastError().text().toStdString() << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseOptions(const QStringList& args, ViewerOptions& options) {
+    for (int i = 1; i < args.size(); i++) {
+        const QString& arg = args[i];
+        if (arg == "--analytics") {
+            options.analytics = true;
+            continue;
+        }
+        if (i + 1 >= args.size()) {
+            cout << "参数缺少取值: " << arg.toStdString() << endl;
+            return false;
+        }
+        QString value = args[++i];
+        bool ok = true;
+        if (arg == "--db") options.dbPath = value;
+        else if (arg == "--table") options.tables << value;
+        else if (arg == "--columns") options.columns = value.split(",", Qt::SkipEmptyParts);
+        else if (arg == "--where") options.where = value;
+        else if (arg == "--limit") options.limit = value.toLongLong(&ok);
+        else if (arg == "--offset") options.offset = value.toLongLong(&ok);
+        else if (arg == "--after") options.afterRowid = value.toLongLong(&ok);
+        else if (arg == "--format") options.format = value;
+        else if (arg == "--output") options.outputPath = value;
+        else if (arg == "--top") options.top = value.toLongLong(&ok);
+        else {
+            cout << "未知参数: " << arg.toStdString() << endl;
+            return false;
+        }
+        if (!ok) {
+            cout << "参数 " << arg.toStdString() << " 需要整数" << endl;
+            return false;
+        }
+    }
+    if (options.format != "table" && options.format != "csv" && options.format != "ndjson") {
+        cout << "不支持的输出格式: " << options.format.toStdString() << endl;
+        return false;
+    }
+    return true;
 }
 
 int main(int argc, char *argv[]) {
-    QApplication app(argc, argv);
-    
+    QCoreApplication app(argc, argv);
+
+    ViewerOptions options;
+    if (!parseOptions(app.arguments(), options)) {
+        return -1;
+    }
+    if (options.format != "table" && options.outputPath.isEmpty()) {
+        info = &cerr;
+    }
+
     // 连接数据库
     QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
-    db.setDatabaseName("railway_system.db");
-    
+    db.setDatabaseName(options.dbPath);
+
     if (!db.open()) {
-        cout << "无法打开数据库: " << db.lastError().text().toStdString() << endl;
+        *info << "无法打开数据库: " << db.lastError().text().toStdString() << endl;
+        return -1;
+    }
+
+    *info << "=== 铁路系统数据库查看器 ===" << endl;
+    *info << "数据库文件: " << options.dbPath.toStdString() << endl;
+    int shardCount = attachShards(options.dbPath);
+    if (shardCount < 0) {
         return -1;
     }
-    
-    cout << "=== 铁路系统数据库查看器 ===" << endl;
-    cout << "数据库文件: railway_system.db" << endl;
-    
+    if (shardCount > 0) {
+        *info << "已挂接 " << shardCount << " 个分片文件" << endl;
+    }
+
     // 获取所有表名
-    QSqlQuery query("SELECT name FROM sqlite_master WHERE type='table'");
+    QSqlQuery query("SELECT name FROM sqlite_master WHERE type='table' AND name NOT LIKE 'sqlite_%'");
     QStringList tables;
     while (query.next()) {
         tables << query.value(0).toString();
     }
-    
-    cout << "数据库包含以下表: ";
+
+    *info << "数据库包含以下表: ";
     for (const QString& table : tables) {
-        cout << table.toStdString() << " ";
+        *info << table.toStdString() << " ";
+    }
+    *info << endl;
+
+    for (const QString& table : options.tables) {
+        if (!tables.contains(table)) {
+            *info << "表不存在: " << table.toStdString() << endl;
+            return -1;
+        }
+    }
+    if (!options.tables.isEmpty()) {
+        tables = options.tables;
+    }
+
+    ofstream file;
+    if (!options.outputPath.isEmpty()) {
+        file.open(options.outputPath.toStdString(), ios::binary | ios::trunc);
+        if (!file) {
+            *info << "无法创建输出文件: " << options.outputPath.toStdString() << endl;
+            return -1;
+        }
+    }
+    ostream& out = file.is_open() ? static_cast<ostream&>(file) : cout;
+
+    if (options.analytics) {
+        if (shardCount > 0 && !createShardViews(shardCount)) {
+            return -1;
+        }
+        printAnalytics(options, out);
+        *info << "\n数据库查看完成!" << endl;
+        return 0;
     }
-    cout << endl;
-    
-    // 显示每个表的内容
+
+    // 显示每个表的内容，分片表逐个分片输出
     for (const QString& table : tables) {
-        printTable(table);
+        bool sharded = shardCount > 0 && any_of(SHARDED_TABLES.begin(), SHARDED_TABLES.end(),
+                                                [&table](const pair<QString, QString>& s) { return s.first == table; });
+        if (!sharded) {
+            printTable("main", table, options, out);
+            continue;
+        }
+        for (int k = 0; k < shardCount; k++) {
+            printTable("shard" + QString::number(k), table, options, out);
+        }
     }
-    
-    cout << "\n数据库查看完成!" << endl;
-    
+
+    *info << "\n数据库查看完成!" << endl;
+
     return 0;
 } 
\ No newline at end of file
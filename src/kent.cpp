@@ -3,8 +3,39 @@
 #include <string>
 #include <sstream>
 #include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+#include <list>
+#include <map>
+#include <set>
+#include <tuple>
+#include <chrono>
+#include <mutex>
+#include <cmath>
 #include <cctype>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <array>
+#include <memory_resource>
+#include <string_view>
+#include <charconv>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include <iostream>
+#ifndef RAILWAY_HEADLESS
 #include <QApplication>
 #include <QMainWindow>
 #include <QVBoxLayout>
@@ -24,25 +55,130 @@
 #include <QFormLayout>
 #include <QGroupBox>
 #include <QIntValidator>
+#include <QComboBox>
+#endif
+#ifdef RAILWAY_HEADLESS
+#include <QCoreApplication>
+#include <QThread>
+#include <QThreadPool>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QUrl>
+#include <QUuid>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonValue>
+#endif
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QStandardPaths>
 #include <QDir>
 #include <QVariant>
+#include <QDate>
+#include <QTimer>
+#include <QSharedMemory>
 
 using namespace std;
 
+// 席别
+enum SeatClass : unsigned char {
+	BusinessClass = 0,
+	FirstClass = 1,
+	SecondClass = 2,
+	SleeperClass = 3
+};
+const int SEAT_CLASS_COUNT = 4;
+
+// 席别的名称、接口代码和票价系数（相对二等座，千分之一）
+struct SeatClassInfo {
+	const char* name;
+	const char* code;
+	int fareFactor;
+};
+const SeatClassInfo SEAT_CLASSES[SEAT_CLASS_COUNT] = {
+	{"商务座", "business", 3000},
+	{"一等座", "first", 1600},
+	{"二等座", "second", 1000},
+	{"卧铺", "sleeper", 1800}
+};
+
+// 编组中的一组同席别车厢
+struct CarGroup {
+	int seatClass;
+	int cars;
+	int seatsPerCar;
+};
+
+// 区间矩阵只用到 from < to 的上三角（两个方向的行程都按 min/max 取下标），按行平铺保存：
+// 站数为 n 的车次共 n(n-1)/2 个区间，区间 (from, to) 的下标由下面的闭式公式给出
+constexpr size_t triangleCells(size_t n) {
+	return n * (n - 1) / 2;
+}
+constexpr size_t triangleCell(size_t n, size_t from, size_t to) {
+	return from * (2 * n - from - 1) / 2 + (to - from - 1);
+}
+
+// 把矩阵元素转换为 T：超出 T 的取值范围时截断到边界，而不是回绕成很大或很小的值
+template <typename T>
+T clampCell(int value) {
+	long long clamped = min<long long>(max<long long>(value, 0), numeric_limits<T>::max());
+	if (clamped != value) {
+		cout << "矩阵元素 " << value << " 超出范围，按 " << clamped << " 处理" << endl;
+	}
+	return static_cast<T>(clamped);
+}
+
+// 把 n×n 矩阵的上三角压缩为平铺数组，缺失的元素填 missing
+template <typename T>
+vector<T> packTriangle(const vector<vector<int>>& matrix, size_t n, T missing) {
+	vector<T> packed(triangleCells(n), missing);
+	for (size_t i = 0; i < n && i < matrix.size(); ++i) {
+		for (size_t j = i + 1; j < n && j < matrix[i].size(); ++j) {
+			packed[triangleCell(n, i, j)] = clampCell<T>(matrix[i][j]);
+		}
+	}
+	return packed;
+}
+
+const uint32_t MISSING_FARE = UINT32_MAX;
+
 // 定义列车信息结构体
 struct Train {
 	string trainNumber;
 	vector<string> stations;
 	vector<string> arrivalTimes;
-	vector<vector<int>> segmentAvailableSeats; // 二维数组：segmentAvailableSeats[i][j] 表示从站i到站j的余票
-	vector<vector<int>> priceMatrix; // 二维数组：priceMatrix[i][j] 表示从站i到站j的票价
-	
-	Train(string tn, vector<string> sta, vector<string> arr, vector<vector<int>> sas, vector<vector<int>> pm = {})
-	: trainNumber(tn), stations(sta), arrivalTimes(arr), segmentAvailableSeats(sas), priceMatrix(pm) {}
+	vector<uint16_t> seatCapacity;   // 上三角平铺：每个运行日各区间的初始余票，下标 triangleCell(站数, from, to)
+	vector<uint32_t> fareTable;      // 上三角平铺：各区间的票价（元），MISSING_FARE 表示缺失或按里程计算；全部区间都按里程计算时不保存
+	vector<uint32_t> routeKm;        // 沿本车次停站累加的里程，routeKm[i] 为始发站到第 i 站；有站点不在路网地图上时为空
+	vector<CarGroup> carLayout;      // 编组：按顺序的各组车厢，车厢号从1开始连续编排
+	vector<unsigned char> carClasses; // 由编组展开：每节车厢的席别
+	vector<unsigned short> carSeats;  // 每节车厢的座位数
+	vector<unsigned> carWordOffsets;  // 每节车厢在座位位图中的起始下标
+	unsigned seatWordCount = 0;       // 一个运行日的座位位图共多少个64位字
+	
+	// sas、pm 为数据库中的 n×n 余票矩阵和票价矩阵，构造时压缩为上三角
+	Train(string tn, vector<string> sta, vector<string> arr, const vector<vector<int>>& sas, const vector<vector<int>>& pm = {})
+	: trainNumber(tn), stations(sta), arrivalTimes(arr),
+	  seatCapacity(packTriangle<uint16_t>(sas, stations.size(), 0)),
+	  fareTable(pm.empty() ? vector<uint32_t>() : packTriangle<uint32_t>(pm, stations.size(), MISSING_FARE)) {}
+};
+
+// 定义行程（已购车票）结构体
+struct Trip {
+	string trainNumber;
+	string startStation;
+	string endStation;
+	string departureTime;
+	string arrivalTime;
+	int price = 0;
+	string travelDate; // 乘车日期 yyyy-MM-dd
+	int seatClass = SecondClass;
+	int carNumber = 0;  // 车厢号，从1开始；0 表示旧版本未分配座位的车票
+	int seatNumber = 0; // 车厢内座位号，从1开始
+	long long ticketId = 0; // 车票编号，全局唯一，退票按编号定位
 };
 
 // 定义用户结构体
@@ -52,7 +188,8 @@ struct User {
 	string password;
 	string name;
 	string idNumber;
-	vector<Train> trips;
+	vector<Trip> trips;
+	unordered_map<long long, size_t> tripIndex; // 车票编号 -> trips 中的下标
 	double balance; // 账户余额
 	
 	User(string phone, string pwd, string nm, string id_num, double bal = 3000.0, int user_id = -1)
@@ -71,13 +208,33 @@ struct Admin {
 };
 
 // 全局变量
-vector<User> users;
-vector<Admin> admins;
+// 用户和管理员用 deque 保存：注册时在尾部追加不会使其他窗口会话持有的 User* / Admin* 失效
+deque<User> users;
+deque<Admin> admins;
 vector<Train> trains;
-vector<string> suspendedTrains; // 停开的列车车次
-string currentStartStation;
-string currentEndStation;
-string currentDepartureTimeFilter;
+unordered_set<string> suspendedTrains; // 停开的列车车次（哈希集合，按车次O(1)查询）
+vector<bool> suspendedBitmap; // 停开状态位图：suspendedBitmap[i] 对应 trains[i]，供查票等全表扫描使用
+unordered_map<string, size_t> trainIndexByNumber; // 车次号 -> trains 下标
+
+// 查票结果缓存的失效依据
+vector<unsigned> trainVersions; // 每个车次的库存版本号：余票变化或停开/复开时递增
+unsigned fleetEpoch = 0;        // 列车数据整体重新加载时递增，使全部缓存失效
+
+const int SALES_WINDOW_DAYS = 30; // 预售期：从今天起30天
+
+// 一个运行日的余票，按 from * 站数 + to 平铺为连续数组
+struct ServiceDaySeats {
+	int day = -1; // 运行日（儒略日），-1 表示槽位空闲
+	vector<uint16_t> seats;            // 各区间的余票，上三角平铺（triangleCell）
+	vector<unsigned char> loadPercent; // 各区间的上座率（百分比），与 seats 同样平铺，余票变化时逐个更新
+	vector<uint64_t> seatBits;         // 座位占用位图：每节车厢每个相邻两站区段一组64位字，置1表示该座位在该区段已占用
+};
+
+vector<vector<ServiceDaySeats>> datedInventory; // datedInventory[车次下标][运行日 % SALES_WINDOW_DAYS]
+int currentServiceDay = 0;                      // 今天（儒略日）
+
+// 未确认的座位预留数量：heldSeats[(车次下标, 运行日)][(from, to)]，持久化余票时需要加回
+map<pair<size_t, int>, map<pair<size_t, size_t>, int>> heldSeats;
 
 // 数据库连接
 QSqlDatabase db;
@@ -85,33 +242,25 @@ QSqlDatabase db;
 // 数据库相关函数声明
 bool initDatabase();
 bool loadUsersFromDB();
-bool saveUsersToDB();
 bool loadAdminsFromDB();
 bool saveAdminsToDB();
 bool loadTrainsFromDB();
-bool saveTrainsToDB();
+void rebuildTrainColumns();
 bool loadSuspendedTrainsFromDB();
-bool saveSuspendedTrainsToDB();
+bool addSuspendedTrainToDB(const string& trainNumber);
+bool removeSuspendedTrainFromDB(const string& trainNumber);
+bool updateUserBalanceInDB(const User& user);
+class ShardBatch;
+bool insertTripToDB(int userId, const Trip& trip, ShardBatch* batch = nullptr);
+bool deleteTripFromDB(int userId, const Trip& trip, ShardBatch* batch = nullptr);
+bool saveDatedSeatsToDB(size_t trainIdx, int day, ShardBatch* batch = nullptr);
+bool loadDatedSeatsFromDB();
+void recordSuspendEvent(const string& trainNumber, bool suspended);
+void rebuildSeatOccupancy();
 
 // 数据库表名常量
 const string DB_NAME = "railway_system.db";
-
-// 全局界面变量
-User* currentUser = nullptr;
-Admin* currentAdmin = nullptr;
-QStackedWidget* stackedWidget = nullptr;
-QWidget* startMenuWidget = nullptr;
-QWidget* loginWidget = nullptr;
-QWidget* registerWidget = nullptr;
-QWidget* adminLoginWidget = nullptr;
-QWidget* adminRegisterWidget = nullptr;
-QWidget* mainMenuWidget = nullptr;
-QWidget* adminMenuWidget = nullptr;
-QTableWidget* ticketTable = nullptr;
-QTableWidget* myTripsTable = nullptr;
-QTableWidget* adminTrainTable = nullptr;
-QLabel* balanceLabel = nullptr;
-QLineEdit* rechargeAmountEdit = nullptr;
+string dbPath = DB_NAME; // 实际使用的数据库文件，无界面服务可用 --db 指定（例如回放时使用副本）
 
 // 模拟 MD5 哈希函数（简化版）
 string md5(string input) {
@@ -141,12 +290,32 @@ bool isValidPassword(const string& password) {
 	return hasUpper && hasLower && hasDigit;
 }
 
+// 表中缺少某列时补上（用于兼容旧版本数据库）
+bool addColumnIfMissing(const QString& table, const QString& column, const QString& definition) {
+	QSqlQuery query;
+	if (!query.exec("PRAGMA table_info(" + table + ")")) {
+		cout << "读取表结构失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	while (query.next()) {
+		if (query.value(1).toString() == column) {
+			return true;
+		}
+	}
+	
+	if (!query.exec("ALTER TABLE " + table + " ADD COLUMN " + column + " " + definition)) {
+		cout << "添加列失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	return true;
+}
+
 // 数据库初始化函数
 bool initDatabase() {
 	// 创建数据库连接
 	db = QSqlDatabase::addDatabase("QSQLITE");
 	// 为了调试方便，将数据库放在当前目录
-	db.setDatabaseName(QString::fromStdString(DB_NAME));
+	db.setDatabaseName(QString::fromStdString(dbPath));
 	
 	if (!db.open()) {
 		cout << "数据库连接失败: " << db.lastError().text().toStdString() << endl;
@@ -239,10 +408,470 @@ bool initDatabase() {
 		return false;
 	}
 	
+	// 旧版本的行程表没有乘车日期列和座位列，补上
+	if (!addColumnIfMissing("user_trips", "travel_date", "TEXT NOT NULL DEFAULT ''") ||
+		!addColumnIfMissing("user_trips", "seat_class", "INTEGER NOT NULL DEFAULT 2") ||
+		!addColumnIfMissing("user_trips", "car_number", "INTEGER NOT NULL DEFAULT 0") ||
+		!addColumnIfMissing("user_trips", "seat_number", "INTEGER NOT NULL DEFAULT 0") ||
+		!addColumnIfMissing("user_trips", "ticket_id", "INTEGER NOT NULL DEFAULT 0")) {
+		return false;
+	}
+	// 退票按车票编号删除单行
+	if (!query.exec("CREATE INDEX IF NOT EXISTS idx_user_trips_ticket_id ON user_trips (ticket_id)")) {
+		cout << "创建车票编号索引失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	
+	// 旧版本的列车表没有编组列，为空时按车次类型使用默认编组
+	if (!addColumnIfMissing("trains", "car_layout", "TEXT NOT NULL DEFAULT ''")) {
+		return false;
+	}
+	
+	// 创建按运行日的余票表（只保存售过票的运行日）
+	QString createDatedSeatsTable = R"(
+		CREATE TABLE IF NOT EXISTS dated_seats (
+			train_number TEXT NOT NULL,
+			service_date TEXT NOT NULL,
+			seats TEXT NOT NULL,
+			PRIMARY KEY (train_number, service_date)
+		)
+	)";
+	
+	if (!query.exec(createDatedSeatsTable)) {
+		cout << "创建运行日余票表失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	
+	// 创建设置表（键值对，目前记录分片数）
+	if (!query.exec("CREATE TABLE IF NOT EXISTS settings (key TEXT PRIMARY KEY, value TEXT NOT NULL)")) {
+		cout << "创建设置表失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	
 	cout << "数据库表初始化完成" << endl;
 	return true;
 }
 
+// ==================== 分片存储（可选） ====================
+// 默认全部数据在一个数据库文件中。用 --shards N 启动时，运行日余票（dated_seats）和车票（user_trips）
+// 按车次号哈希分到 N 个分片文件（<数据库名>.shard<k>.db），用户、管理员、列车等其余表仍在主库。
+// 每个分片一个写线程，持有自己的数据库连接。写线程每次取出队列中的全部操作在一个事务中提交（组提交），
+// 每个操作包在一个保存点里，单个操作失败只撤销它自己，不影响同一批的其他操作。
+// 购票和退票用 ShardBatch 让所在分片并行提交，全部成功后才开启并提交主库事务，主库失败时撤销分片上的写入；
+// 其余写操作提交到队列后立即返回。内存中的数据始终是最新的，分片只在启动时读取。
+// 一个数据库启用分片后分片数不能再改变（车次到分片的映射取决于分片数），主库 settings 表记录分片数，启动时校验。
+
+int shardCount = 0; // 0 表示不分片
+
+class ShardWriter {
+public:
+	using Job = function<bool(QSqlDatabase&)>; // 返回 false 时撤销该操作的写入
+	
+	ShardWriter(int index, const string& path) : index(index), path(path) {
+		worker = thread([this]() { run(); });
+	}
+	
+	~ShardWriter() {
+		stop();
+	}
+	
+	// 提交一个操作，立即返回；同一分片的操作按提交顺序执行
+	void submit(Job job) {
+		enqueue(std::move(job), nullptr);
+	}
+	
+	// 提交一个操作，返回的 future 在它（及之前提交的全部操作）执行并提交后就绪，操作成功且事务提交成功时为 true
+	future<bool> post(Job job) {
+		auto done = make_unique<promise<bool>>();
+		future<bool> finished = done->get_future();
+		enqueue(std::move(job), std::move(done));
+		return finished;
+	}
+	
+	// 提交一个操作并等待结果
+	bool runSync(const Job& job) {
+		return post(job).get();
+	}
+	
+	// 写完队列中剩余的操作后结束写线程
+	void stop() {
+		{
+			lock_guard<mutex> lock(queueMutex);
+			stopping = true;
+		}
+		queueReady.notify_one();
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+	
+private:
+	struct Entry {
+		Job job;
+		unique_ptr<promise<bool>> done; // 等待结果时非空，异步提交为空
+	};
+	
+	void enqueue(Job job, unique_ptr<promise<bool>> done) {
+		{
+			lock_guard<mutex> lock(queueMutex);
+			jobs.push_back({std::move(job), std::move(done)});
+		}
+		queueReady.notify_one();
+	}
+	
+	void run() {
+		QString connectionName = "shard_" + QString::number(index);
+		{
+			QSqlDatabase shardDb = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+			shardDb.setDatabaseName(QString::fromStdString(path));
+			if (!shardDb.open() || !createShardTables(shardDb)) {
+				cout << "分片数据库 " << path << " 初始化失败: " << shardDb.lastError().text().toStdString() << endl;
+			}
+			
+			deque<Entry> batch;
+			vector<char> succeeded;
+			while (true) {
+				{
+					unique_lock<mutex> lock(queueMutex);
+					queueReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+					if (jobs.empty()) {
+						break;
+					}
+					batch.swap(jobs);
+				}
+				shardDb.transaction();
+				QSqlQuery savepoint(shardDb);
+				succeeded.clear();
+				for (auto& entry : batch) {
+					savepoint.exec("SAVEPOINT shard_job");
+					bool ok = entry.job(shardDb);
+					if (!ok) {
+						savepoint.exec("ROLLBACK TO shard_job");
+					}
+					savepoint.exec("RELEASE shard_job");
+					succeeded.push_back(ok);
+				}
+				bool committed = shardDb.commit();
+				if (!committed) {
+					cout << "分片 " << index << " 提交失败: " << shardDb.lastError().text().toStdString() << endl;
+					shardDb.rollback();
+				}
+				for (size_t i = 0; i < batch.size(); ++i) {
+					if (batch[i].done) {
+						batch[i].done->set_value(committed && succeeded[i]);
+					}
+				}
+				batch.clear();
+			}
+			shardDb.close();
+		}
+		QSqlDatabase::removeDatabase(connectionName);
+	}
+	
+	// 旧版本创建的分片没有车票编号列，补上
+	static bool ensureShardTicketColumn(QSqlDatabase& shardDb) {
+		QSqlQuery query(shardDb);
+		if (!query.exec("PRAGMA table_info(user_trips)")) {
+			return false;
+		}
+		while (query.next()) {
+			if (query.value(1).toString() == "ticket_id") {
+				return true;
+			}
+		}
+		return query.exec("ALTER TABLE user_trips ADD COLUMN ticket_id INTEGER NOT NULL DEFAULT 0");
+	}
+	
+	static bool createShardTables(QSqlDatabase& shardDb) {
+		QSqlQuery query(shardDb);
+		return query.exec(R"(
+			CREATE TABLE IF NOT EXISTS user_trips (
+				id INTEGER PRIMARY KEY AUTOINCREMENT,
+				user_id INTEGER NOT NULL,
+				train_number TEXT NOT NULL,
+				start_station TEXT NOT NULL,
+				end_station TEXT NOT NULL,
+				departure_time TEXT NOT NULL,
+				arrival_time TEXT NOT NULL,
+				price INTEGER NOT NULL,
+				travel_date TEXT NOT NULL DEFAULT '',
+				seat_class INTEGER NOT NULL DEFAULT 2,
+				car_number INTEGER NOT NULL DEFAULT 0,
+				seat_number INTEGER NOT NULL DEFAULT 0,
+				ticket_id INTEGER NOT NULL DEFAULT 0
+			)
+		)") && ensureShardTicketColumn(shardDb) &&
+			query.exec("CREATE INDEX IF NOT EXISTS idx_user_trips_ticket_id ON user_trips (ticket_id)") && query.exec(R"(
+			CREATE TABLE IF NOT EXISTS dated_seats (
+				train_number TEXT NOT NULL,
+				service_date TEXT NOT NULL,
+				seats TEXT NOT NULL,
+				PRIMARY KEY (train_number, service_date)
+			)
+		)");
+	}
+	
+	int index;
+	string path;
+	thread worker;
+	mutex queueMutex;
+	condition_variable queueReady;
+	deque<Entry> jobs;
+	bool stopping = false;
+};
+
+vector<unique_ptr<ShardWriter>> shardWriters;
+
+// 等待分片提交期间放开的调用方锁：无头服务器处理写请求时指向 engineMutex 的独占锁，其余情况为空。
+// 写请求都在主线程执行，等待期间不会有其他写入，登录等读请求也不必等分片落盘
+unique_lock<shared_mutex>* shardWaitLock = nullptr;
+
+// 车次所在的分片（FNV-1a 哈希，与平台和运行次数无关）
+ShardWriter& trainShard(const string& trainNumber) {
+	uint32_t hash = 2166136261u;
+	for (unsigned char c : trainNumber) {
+		hash = (hash ^ c) * 16777619u;
+	}
+	return *shardWriters[hash % shardWriters.size()];
+}
+
+// 一次购票或退票在各分片上的写入：按分片分组，各分片同时提交一次，再等待全部结果。
+// 某个分片失败时撤销已提交的分片；主库事务随后提交失败时由调用方调用 revert 撤销。
+// 余票行不登记撤销操作，调用方回滚内存后重新保存即可
+class ShardBatch {
+public:
+	void add(const string& trainNumber, ShardWriter::Job job, ShardWriter::Job undo = nullptr) {
+		Writes& shardWrites = writes[&trainShard(trainNumber)];
+		shardWrites.jobs.push_back(std::move(job));
+		if (undo) {
+			shardWrites.undo.push_back(std::move(undo));
+		}
+	}
+	
+	// 提交全部分片并等待，全部成功时返回 true
+	bool commit() {
+		vector<pair<ShardWriter*, future<bool>>> pending;
+		for (auto& entry : writes) {
+			const vector<ShardWriter::Job>& jobs = entry.second.jobs;
+			pending.emplace_back(entry.first, entry.first->post([&jobs](QSqlDatabase& shardDb) {
+				for (const auto& job : jobs) {
+					if (!job(shardDb)) {
+						return false;
+					}
+				}
+				return true;
+			}));
+		}
+		bool ok = true;
+		{
+			WaitUnlocked unlocked;
+			for (auto& entry : pending) {
+				if (entry.second.get()) {
+					committed.push_back(entry.first);
+				} else {
+					ok = false;
+				}
+			}
+		}
+		if (!ok) {
+			cout << "分片写入失败，撤销本次操作" << endl;
+			revert();
+		}
+		return ok;
+	}
+	
+	// 撤销已提交分片上的写入（各分片倒序执行撤销操作）
+	void revert() {
+		vector<future<bool>> pending;
+		for (ShardWriter* writer : committed) {
+			const vector<ShardWriter::Job>& undo = writes[writer].undo;
+			pending.push_back(writer->post([&undo](QSqlDatabase& shardDb) {
+				bool ok = true;
+				for (auto it = undo.rbegin(); it != undo.rend(); ++it) {
+					ok = (*it)(shardDb) && ok;
+				}
+				return ok;
+			}));
+		}
+		WaitUnlocked unlocked;
+		for (auto& finished : pending) {
+			if (!finished.get()) {
+				cout << "撤销分片写入失败，分片与主库可能不一致" << endl;
+			}
+		}
+		committed.clear();
+	}
+	
+private:
+	// 等待分片期间放开 shardWaitLock
+	struct WaitUnlocked {
+		WaitUnlocked() {
+			if (shardWaitLock) shardWaitLock->unlock();
+		}
+		~WaitUnlocked() {
+			if (shardWaitLock) shardWaitLock->lock();
+		}
+	};
+	
+
+	struct Writes {
+		vector<ShardWriter::Job> jobs;
+		vector<ShardWriter::Job> undo;
+	};
+	map<ShardWriter*, Writes> writes;
+	vector<ShardWriter*> committed;
+};
+
+// 把主库中某张表的数据按车次搬到各分片：每个分片在一个事务中写入并核对新增行数，
+// 全部分片成功后才从主库删除；有分片失败时删掉其他分片本次写入的行，主库数据保留
+bool migrateTableToShards(const QString& table, const QStringList& columns) {
+	QSqlQuery query;
+	if (!query.exec("SELECT " + columns.join(", ") + " FROM " + table)) {
+		cout << "读取 " << table.toStdString() << " 失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	
+	QString placeholders;
+	for (int i = 0; i < columns.size(); ++i) {
+		placeholders += i == 0 ? "?" : ", ?";
+	}
+	QString insertSql = "INSERT OR REPLACE INTO " + table + " (" + columns.join(", ") + ") VALUES (" + placeholders + ")";
+	int trainColumn = columns.indexOf("train_number");
+	
+	map<ShardWriter*, vector<vector<QVariant>>> rowsByShard;
+	int moved = 0;
+	while (query.next()) {
+		vector<QVariant> row;
+		for (int i = 0; i < columns.size(); ++i) {
+			row.push_back(query.value(i));
+		}
+		rowsByShard[&trainShard(row[trainColumn].toString().toStdString())].push_back(std::move(row));
+		moved++;
+	}
+	if (moved == 0) {
+		return true;
+	}
+	
+	// 新写入的行 rowid 都大于写入前的最大 rowid（INSERT OR REPLACE 替换的行也会分配新的 rowid）
+	map<ShardWriter*, long long> previousMaxRowid;
+	bool ok = true;
+	for (auto& entry : rowsByShard) {
+		const vector<vector<QVariant>>& rows = entry.second;
+		long long& maxRowid = previousMaxRowid[entry.first];
+		ok = entry.first->runSync([&](QSqlDatabase& shardDb) {
+			QSqlQuery shardQuery(shardDb);
+			if (!shardQuery.exec("SELECT COALESCE(MAX(rowid), 0) FROM " + table) || !shardQuery.next()) {
+				return false;
+			}
+			maxRowid = shardQuery.value(0).toLongLong();
+			shardQuery.prepare(insertSql);
+			for (const auto& row : rows) {
+				for (const QVariant& value : row) {
+					shardQuery.addBindValue(value);
+				}
+				if (!shardQuery.exec()) {
+					cout << "迁移数据到分片失败: " << shardQuery.lastError().text().toStdString() << endl;
+					return false;
+				}
+			}
+			if (!shardQuery.exec("SELECT COUNT(*) FROM " + table + " WHERE rowid > " + QString::number(maxRowid)) ||
+				!shardQuery.next() || shardQuery.value(0).toLongLong() != static_cast<long long>(rows.size())) {
+				cout << "迁移到分片的行数与主库不符" << endl;
+				return false;
+			}
+			return true;
+		});
+		if (!ok) {
+			break;
+		}
+	}
+	QSqlQuery cleanup;
+	if (ok && !cleanup.exec("DELETE FROM " + table)) {
+		cout << "删除主库中已迁移的 " << table.toStdString() << " 失败: " << cleanup.lastError().text().toStdString() << endl;
+		ok = false;
+	}
+	if (!ok) {
+		for (auto& entry : previousMaxRowid) {
+			long long maxRowid = entry.second;
+			entry.first->runSync([&table, maxRowid](QSqlDatabase& shardDb) {
+				return QSqlQuery(shardDb).exec("DELETE FROM " + table + " WHERE rowid > " + QString::number(maxRowid));
+			});
+		}
+		cout << "迁移 " << table.toStdString() << " 到分片失败，主库数据保留" << endl;
+		return false;
+	}
+	cout << "已将 " << moved << " 行 " << table.toStdString() << " 迁移到分片" << endl;
+	return true;
+}
+
+// 第 k 个分片的文件名
+string shardPath(int k) {
+	string base = dbPath;
+	if (base.size() > 3 && base.compare(base.size() - 3, 3, ".db") == 0) {
+		base.erase(base.size() - 3);
+	}
+	return base + ".shard" + to_string(k) + ".db";
+}
+
+// 校验分片数与数据库记录的一致：分片数改变后车次会映射到其他分片，已有数据读写错位。
+// 第一次用 --shards 启动时记录分片数，主库中已有的数据随后迁移到分片；不分片启动不做记录，
+// 以后仍可改为分片。没有记录但已存在分片文件（旧版本启用过分片）时拒绝以不分片方式启动
+bool checkShardCount(int count) {
+	QSqlQuery query;
+	if (!query.exec("SELECT value FROM settings WHERE key = 'shard_count'")) {
+		cout << "读取分片数失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	// 早先的版本在不分片启动时也记录了 0，按没有记录处理
+	int recorded = query.next() ? query.value(0).toInt() : 0;
+	if (recorded != 0) {
+		if (recorded == count) {
+			return true;
+		}
+		cout << "该数据库使用 " << recorded << " 个分片，请用 --shards " << recorded << " 启动" << endl;
+		return false;
+	}
+	if (count == 0) {
+		if (ifstream(shardPath(0)).good()) {
+			cout << "发现分片文件 " << shardPath(0) << "，请用启用分片时的 --shards 启动" << endl;
+			return false;
+		}
+		return true;
+	}
+	query.prepare("INSERT OR REPLACE INTO settings (key, value) VALUES ('shard_count', ?)");
+	query.addBindValue(count);
+	if (!query.exec()) {
+		cout << "记录分片数失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	return true;
+}
+
+// 启动分片写线程（需在 initDatabase 之后、加载数据之前调用，count 为0表示不分片），
+// 先校验分片数，主库中已有的余票和车票迁移到分片
+bool startShardWriters(int count) {
+	if (!checkShardCount(count)) {
+		return false;
+	}
+	if (count == 0) {
+		return true;
+	}
+	shardCount = count;
+	for (int k = 0; k < count; ++k) {
+		shardWriters.push_back(make_unique<ShardWriter>(k, shardPath(k)));
+	}
+	cout << "已启用 " << count << " 个存储分片" << endl;
+	
+	return migrateTableToShards("user_trips", {"user_id", "train_number", "start_station", "end_station", "departure_time",
+											   "arrival_time", "price", "travel_date", "seat_class", "car_number", "seat_number", "ticket_id"}) &&
+		   migrateTableToShards("dated_seats", {"train_number", "service_date", "seats"});
+}
+
+// 写完全部分片的剩余操作并结束写线程（程序退出前调用）
+void stopShardWriters() {
+	shardWriters.clear();
+}
+
 // 辅助函数：将字符串分割成向量
 vector<string> split(const string& str, char delimiter) {
 	vector<string> tokens;
@@ -273,35 +902,34 @@ string toLowerCase(const string& str) {
 	return lowerStr;
 }
 
-// 辅助函数：时间字符串转换为分钟数
-int timeToMinutes(const string& timeStr) {
-	string normalizedTime = timeStr;
-	
-	// 处理不同的时间格式
-	if (timeStr.length() == 4 && timeStr[1] == ':') {
+// 辅助函数：时间字符串转换为分钟数（查票时每个车次调用两次，只读 string_view，不构造临时字符串）
+int timeToMinutes(string_view timeStr) {
+	// 处理不同的时间格式，统一取出时、分共4位数字
+	char digits[4];
+	if (timeStr.length() == 5 && timeStr[2] == ':') {
+		// 格式 "13:45"
+		digits[0] = timeStr[0]; digits[1] = timeStr[1]; digits[2] = timeStr[3]; digits[3] = timeStr[4];
+	} else if (timeStr.length() == 4 && timeStr[1] == ':') {
 		// 格式 "3:45" -> "03:45"
-		normalizedTime = "0" + timeStr;
-	} else if (timeStr.length() == 3 && timeStr.find(':') == string::npos) {
+		digits[0] = '0'; digits[1] = timeStr[0]; digits[2] = timeStr[2]; digits[3] = timeStr[3];
+	} else if (timeStr.length() == 3 && timeStr.find(':') == string_view::npos) {
 		// 格式 "345" -> "03:45"
-		if (timeStr.length() == 3) {
-			normalizedTime = "0" + timeStr.substr(0, 1) + ":" + timeStr.substr(1, 2);
-		}
-	} else if (timeStr.length() == 4 && timeStr.find(':') == string::npos) {
+		digits[0] = '0'; digits[1] = timeStr[0]; digits[2] = timeStr[1]; digits[3] = timeStr[2];
+	} else if (timeStr.length() == 4 && timeStr.find(':') == string_view::npos) {
 		// 格式 "1345" -> "13:45"
-		normalizedTime = timeStr.substr(0, 2) + ":" + timeStr.substr(2, 2);
-	}
-	
-	if (normalizedTime.length() != 5 || normalizedTime[2] != ':') {
+		digits[0] = timeStr[0]; digits[1] = timeStr[1]; digits[2] = timeStr[2]; digits[3] = timeStr[3];
+	} else {
 		return 0; // 无效时间格式，返回0
 	}
 	
-	try {
-		int hours = stoi(normalizedTime.substr(0, 2));
-		int minutes = stoi(normalizedTime.substr(3, 2));
-		return hours * 60 + minutes;
-	} catch (const exception& e) {
-		return 0; // 解析失败，返回0
+	for (char c : digits) {
+		if (!isdigit(static_cast<unsigned char>(c))) {
+			return 0; // 解析失败，返回0
+		}
 	}
+	int hours = (digits[0] - '0') * 10 + (digits[1] - '0');
+	int minutes = (digits[2] - '0') * 10 + (digits[3] - '0');
+	return hours * 60 + minutes;
 }
 
 // 辅助函数：分钟数转换为时间字符串
@@ -323,6 +951,22 @@ string minutesToTime(int totalMinutes) {
 	return hourStr + ":" + minuteStr;
 }
 
+// 辅助函数：今天的运行日编号（儒略日）
+int todayServiceDay() {
+	return static_cast<int>(QDate::currentDate().toJulianDay());
+}
+
+// 辅助函数：运行日编号转换为 yyyy-MM-dd
+string serviceDayToString(int day) {
+	return QDate::fromJulianDay(day).toString("yyyy-MM-dd").toStdString();
+}
+
+// 辅助函数：yyyy-MM-dd 转换为运行日编号，格式错误返回 -1
+int parseServiceDay(const string& dateStr) {
+	QDate date = QDate::fromString(QString::fromStdString(dateStr), "yyyy-MM-dd");
+	return date.isValid() ? static_cast<int>(date.toJulianDay()) : -1;
+}
+
 // 辅助函数：从时刻表中获取指定方向的时间
 vector<string> getDirectionalSchedule(const vector<string>& allTimes, size_t startIdx, size_t endIdx) {
 	if (allTimes.empty()) {
@@ -348,6 +992,17 @@ vector<string> getDirectionalSchedule(const vector<string>& allTimes, size_t sta
 	}
 }
 
+// 辅助函数：取对应方向时刻表中某站的时间（不复制整张时刻表）
+const string& getDirectionalTime(const vector<string>& allTimes, size_t startIdx, size_t endIdx, size_t stationIdx) {
+	static const string emptyTime;
+	size_t numStations = allTimes.size() / 2;
+	size_t offset = (startIdx < numStations && endIdx < numStations && startIdx > endIdx) ? numStations : 0;
+	if (offset + stationIdx >= allTimes.size()) {
+		return emptyTime;
+	}
+	return allTimes[offset + stationIdx];
+}
+
 // 数据迁移函数：将文件数据导入到数据库
 bool migrateDataFromFiles() {
 	cout << "开始检查并迁移文件数据..." << endl;
@@ -454,10 +1109,73 @@ bool migrateDataFromFiles() {
 	return true;
 }
 
+// 车票表中构成一张 Trip 的列，顺序与 tripFromQuery 一致
+const QString TRIP_COLUMNS = "train_number, start_station, end_station, departure_time, arrival_time, price, travel_date, seat_class, car_number, seat_number, ticket_id";
+
+// 从查询结果的第 first 列开始读取一张车票
+Trip tripFromQuery(const QSqlQuery& query, int first) {
+	Trip trip;
+	trip.trainNumber = query.value(first).toString().toStdString();
+	trip.startStation = query.value(first + 1).toString().toStdString();
+	trip.endStation = query.value(first + 2).toString().toStdString();
+	trip.departureTime = query.value(first + 3).toString().toStdString();
+	trip.arrivalTime = query.value(first + 4).toString().toStdString();
+	trip.price = query.value(first + 5).toInt();
+	trip.travelDate = query.value(first + 6).toString().toStdString();
+	trip.seatClass = query.value(first + 7).toInt();
+	trip.carNumber = query.value(first + 8).toInt();
+	trip.seatNumber = query.value(first + 9).toInt();
+	trip.ticketId = query.value(first + 10).toLongLong();
+	return trip;
+}
+
+// 下一张车票的编号（加载车票后设为已有最大编号 + 1）
+long long nextTicketId = 1;
+
+// 把车票加入用户行程，同时登记编号索引
+void addTrip(User& user, const Trip& trip) {
+	user.tripIndex[trip.ticketId] = user.trips.size();
+	user.trips.push_back(trip);
+}
+
+// 删除用户的第 index 张车票：最后一张车票移到该位置，O(1)
+void removeTripAt(User& user, size_t index) {
+	user.tripIndex.erase(user.trips[index].ticketId);
+	if (index + 1 != user.trips.size()) {
+		user.trips[index] = std::move(user.trips.back());
+		user.tripIndex[user.trips[index].ticketId] = index;
+	}
+	user.trips.pop_back();
+}
+
+// 在指定的数据库连接中给旧版本的车票写回补发的编号，rows 为 (行号, 车票编号)
+bool writeTicketIdsInto(QSqlDatabase& database, const vector<pair<long long, long long>>& rows) {
+	QSqlQuery update(database);
+	update.prepare("UPDATE user_trips SET ticket_id = ? WHERE id = ?");
+	for (const auto& row : rows) {
+		update.addBindValue(row.second);
+		update.addBindValue(row.first);
+		if (!update.exec()) {
+			cout << "保存车票编号失败: " << update.lastError().text().toStdString() << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
 // 从数据库加载用户数据
 bool loadUsersFromDB() {
 	users.clear();
 	
+	// 旧版本没有编号（编号为0）的车票：所在分片（主库为空）、行号，以及在内存中的用户和车票下标
+	struct LegacyTrip {
+		ShardWriter* shard;
+		long long rowId;
+		size_t userIdx;
+		size_t tripIdx;
+	};
+	vector<LegacyTrip> legacyTrips;
+	
 	QSqlQuery query;
 	if (!query.exec("SELECT id, phone_number, password, name, id_number, balance FROM users")) {
 		cout << "查询用户数据失败: " << query.lastError().text().toStdString() << endl;
@@ -474,96 +1192,191 @@ bool loadUsersFromDB() {
 		
 		User user(phoneNumber, password, name, idNumber, balance, userId);
 		
-		// 加载用户行程
-		QSqlQuery tripQuery;
-		tripQuery.prepare("SELECT train_number, start_station, end_station, departure_time, arrival_time, price FROM user_trips WHERE user_id = ?");
-		tripQuery.addBindValue(userId);
-		
-		if (tripQuery.exec()) {
-			while (tripQuery.next()) {
-				string trainNumber = tripQuery.value(0).toString().toStdString();
-				string startStation = tripQuery.value(1).toString().toStdString();
-				string endStation = tripQuery.value(2).toString().toStdString();
-				string departureTime = tripQuery.value(3).toString().toStdString();
-				string arrivalTime = tripQuery.value(4).toString().toStdString();
-				int price = tripQuery.value(5).toInt();
-				
-				// 创建简化的行程记录
-				vector<string> tripStations = {startStation, endStation};
-				vector<string> tripTimes = {departureTime, arrivalTime};
-				vector<vector<int>> tripSeats(2, vector<int>(2, 0));
-				vector<vector<int>> tripPrices(2, vector<int>(2, 0));
-				tripPrices[0][1] = price;
-				
-				Train tripRecord(trainNumber, tripStations, tripTimes, tripSeats, tripPrices);
-				user.trips.push_back(tripRecord);
+		// 加载用户行程（分片模式下车票在各分片中，之后统一读取）
+		if (shardCount == 0) {
+			QSqlQuery tripQuery;
+			tripQuery.prepare("SELECT id, " + TRIP_COLUMNS + " FROM user_trips WHERE user_id = ?");
+			tripQuery.addBindValue(userId);
+			
+			if (tripQuery.exec()) {
+				while (tripQuery.next()) {
+					Trip trip = tripFromQuery(tripQuery, 1);
+					if (trip.ticketId == 0) {
+						legacyTrips.push_back({nullptr, tripQuery.value(0).toLongLong(), users.size(), user.trips.size()});
+					}
+					addTrip(user, trip);
+				}
 			}
 		}
 		
 		users.push_back(user);
 	}
 	
+	// 分片模式：逐个分片读取全部车票，按用户ID归还给用户
+	if (shardCount > 0) {
+		unordered_map<int, size_t> userIndex;
+		for (size_t i = 0; i < users.size(); ++i) {
+			userIndex[users[i].id] = i;
+		}
+		for (auto& writer : shardWriters) {
+			ShardWriter* shard = writer.get();
+			writer->runSync([&userIndex, &legacyTrips, shard](QSqlDatabase& shardDb) {
+				QSqlQuery tripQuery(shardDb);
+				if (!tripQuery.exec("SELECT user_id, id, " + TRIP_COLUMNS + " FROM user_trips")) {
+					cout << "查询分片行程数据失败: " << tripQuery.lastError().text().toStdString() << endl;
+					return false;
+				}
+				while (tripQuery.next()) {
+					auto it = userIndex.find(tripQuery.value(0).toInt());
+					if (it != userIndex.end()) {
+						User& user = users[it->second];
+						Trip trip = tripFromQuery(tripQuery, 2);
+						if (trip.ticketId == 0) {
+							legacyTrips.push_back({shard, tripQuery.value(1).toLongLong(), it->second, user.trips.size()});
+						}
+						addTrip(user, trip);
+					}
+				}
+				return true;
+			});
+		}
+	}
+	
+	// 旧版本的车票没有编号：在已有最大编号之后补发，按行号逐行写回，每个数据库文件一个事务
+	nextTicketId = 1;
+	for (const auto& user : users) {
+		for (const auto& trip : user.trips) {
+			nextTicketId = max(nextTicketId, trip.ticketId + 1);
+		}
+	}
+	map<ShardWriter*, vector<pair<long long, long long>>> ticketIdRows;
+	for (const auto& legacy : legacyTrips) {
+		User& user = users[legacy.userIdx];
+		long long ticketId = nextTicketId++;
+		user.trips[legacy.tripIdx].ticketId = ticketId;
+		user.tripIndex.erase(0);
+		user.tripIndex[ticketId] = legacy.tripIdx;
+		ticketIdRows[legacy.shard].push_back({legacy.rowId, ticketId});
+	}
+	for (const auto& entry : ticketIdRows) {
+		const vector<pair<long long, long long>>& rows = entry.second;
+		bool ok;
+		if (entry.first) {
+			ok = entry.first->runSync([&rows](QSqlDatabase& shardDb) { return writeTicketIdsInto(shardDb, rows); });
+		} else {
+			ok = db.transaction() && writeTicketIdsInto(db, rows) && db.commit();
+			if (!ok) {
+				db.rollback();
+			}
+		}
+		if (!ok) {
+			cout << "补发的 " << rows.size() << " 个车票编号未能保存，下次启动时重新补发" << endl;
+		}
+	}
+	
+	rebuildSeatOccupancy();
+	
 	cout << "从数据库加载了 " << users.size() << " 个用户" << endl;
 	return true;
 }
 
-// 保存用户数据到数据库
-bool saveUsersToDB() {
+// 插入一个新注册的用户（单行插入，不影响其他进程写入的用户），成功时回写数据库分配的ID
+bool insertUserToDB(User& user) {
 	QSqlQuery query;
-	
-	// 清空现有的用户数据和行程数据
-	if (!query.exec("DELETE FROM user_trips") || !query.exec("DELETE FROM users")) {
-		cout << "清空用户数据失败: " << query.lastError().text().toStdString() << endl;
+	query.prepare("INSERT INTO users (phone_number, password, name, id_number, balance) VALUES (?, ?, ?, ?, ?)");
+	query.addBindValue(QString::fromStdString(user.phoneNumber));
+	query.addBindValue(QString::fromStdString(user.password));
+	query.addBindValue(QString::fromStdString(user.name));
+	query.addBindValue(QString::fromStdString(user.idNumber));
+	query.addBindValue(user.balance);
+	
+	if (!query.exec()) {
+		cout << "插入用户数据失败: " << query.lastError().text().toStdString() << endl;
 		return false;
 	}
-	
-	for (const auto& user : users) {
-		// 插入用户数据
-		query.prepare("INSERT INTO users (phone_number, password, name, id_number, balance) VALUES (?, ?, ?, ?, ?)");
-		query.addBindValue(QString::fromStdString(user.phoneNumber));
-		query.addBindValue(QString::fromStdString(user.password));
-		query.addBindValue(QString::fromStdString(user.name));
-		query.addBindValue(QString::fromStdString(user.idNumber));
-		query.addBindValue(user.balance);
-		
-		if (!query.exec()) {
-			cout << "插入用户数据失败: " << query.lastError().text().toStdString() << endl;
-			continue;
+	user.id = query.lastInsertId().toInt();
+	return true;
+}
+
+// 在指定的数据库连接中插入一条用户行程记录
+bool insertTripInto(QSqlDatabase& database, int userId, const Trip& trip) {
+	QSqlQuery tripQuery(database);
+	tripQuery.prepare("INSERT INTO user_trips (user_id, train_number, start_station, end_station, departure_time, arrival_time, price, travel_date, seat_class, car_number, seat_number, ticket_id) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+	tripQuery.addBindValue(userId);
+	tripQuery.addBindValue(QString::fromStdString(trip.trainNumber));
+	tripQuery.addBindValue(QString::fromStdString(trip.startStation));
+	tripQuery.addBindValue(QString::fromStdString(trip.endStation));
+	tripQuery.addBindValue(QString::fromStdString(trip.departureTime));
+	tripQuery.addBindValue(QString::fromStdString(trip.arrivalTime));
+	tripQuery.addBindValue(trip.price);
+	tripQuery.addBindValue(QString::fromStdString(trip.travelDate));
+	tripQuery.addBindValue(trip.seatClass);
+	tripQuery.addBindValue(trip.carNumber);
+	tripQuery.addBindValue(trip.seatNumber);
+	tripQuery.addBindValue(trip.ticketId);
+	
+	if (!tripQuery.exec()) {
+		cout << "插入行程数据失败: " << tripQuery.lastError().text().toStdString() << endl;
+		return false;
+	}
+	return true;
+}
+
+// 在指定的数据库连接中按用户和车票编号删除一条用户行程记录
+bool deleteTripFrom(QSqlDatabase& database, int userId, long long ticketId) {
+	QSqlQuery tripQuery(database);
+	tripQuery.prepare("DELETE FROM user_trips WHERE ticket_id = ? AND user_id = ?");
+	tripQuery.addBindValue(ticketId);
+	tripQuery.addBindValue(userId);
+	
+	if (!tripQuery.exec()) {
+		cout << "删除行程数据失败: " << tripQuery.lastError().text().toStdString() << endl;
+		return false;
+	}
+	return true;
+}
+
+// 插入一条用户行程记录。分片模式下写入车次所在分片：给出 batch 时加入该批同步提交（可撤销），否则异步提交
+bool insertTripToDB(int userId, const Trip& trip, ShardBatch* batch) {
+	if (shardCount > 0) {
+		auto insert = [userId, trip](QSqlDatabase& shardDb) { return insertTripInto(shardDb, userId, trip); };
+		if (batch) {
+			long long ticketId = trip.ticketId;
+			batch->add(trip.trainNumber, insert, [userId, ticketId](QSqlDatabase& shardDb) { return deleteTripFrom(shardDb, userId, ticketId); });
+		} else {
+			trainShard(trip.trainNumber).submit(insert);
 		}
-		
-		// 获取插入的用户ID
-		int userId = query.lastInsertId().toInt();
-		
-		// 插入用户行程数据
-		for (const auto& trip : user.trips) {
-			if (!trip.stations.empty() && trip.stations.size() >= 2) {
-				string startStation = trip.stations[0];
-				string endStation = trip.stations[trip.stations.size() - 1];
-				string departureTime = trip.arrivalTimes.empty() ? "" : trip.arrivalTimes[0];
-				string arrivalTime = trip.arrivalTimes.size() > 1 ? trip.arrivalTimes[trip.arrivalTimes.size() - 1] : departureTime;
-				int price = 0;
-				if (!trip.priceMatrix.empty() && !trip.priceMatrix[0].empty()) {
-					price = trip.priceMatrix[0][trip.priceMatrix[0].size() - 1];
-				}
-				
-				QSqlQuery tripQuery;
-				tripQuery.prepare("INSERT INTO user_trips (user_id, train_number, start_station, end_station, departure_time, arrival_time, price) VALUES (?, ?, ?, ?, ?, ?, ?)");
-				tripQuery.addBindValue(userId);
-				tripQuery.addBindValue(QString::fromStdString(trip.trainNumber));
-				tripQuery.addBindValue(QString::fromStdString(startStation));
-				tripQuery.addBindValue(QString::fromStdString(endStation));
-				tripQuery.addBindValue(QString::fromStdString(departureTime));
-				tripQuery.addBindValue(QString::fromStdString(arrivalTime));
-				tripQuery.addBindValue(price);
-				
-				if (!tripQuery.exec()) {
-					cout << "插入行程数据失败: " << tripQuery.lastError().text().toStdString() << endl;
-				}
-			}
+		return true;
+	}
+	return insertTripInto(db, userId, trip);
+}
+
+// 删除一条用户行程记录。分片模式下写入车次所在分片：给出 batch 时加入该批同步提交（可撤销），否则异步提交
+bool deleteTripFromDB(int userId, const Trip& trip, ShardBatch* batch) {
+	if (shardCount > 0) {
+		long long ticketId = trip.ticketId;
+		auto remove = [userId, ticketId](QSqlDatabase& shardDb) { return deleteTripFrom(shardDb, userId, ticketId); };
+		if (batch) {
+			batch->add(trip.trainNumber, remove, [userId, trip](QSqlDatabase& shardDb) { return insertTripInto(shardDb, userId, trip); });
+		} else {
+			trainShard(trip.trainNumber).submit(remove);
 		}
+		return true;
 	}
+	return deleteTripFrom(db, userId, trip.ticketId);
+}
+
+// 只更新某个用户的余额
+bool updateUserBalanceInDB(const User& user) {
+	QSqlQuery query;
+	query.prepare("UPDATE users SET balance = ? WHERE id = ?");
+	query.addBindValue(user.balance);
+	query.addBindValue(user.id);
 	
-	cout << "保存了 " << users.size() << " 个用户到数据库" << endl;
+	if (!query.exec()) {
+		cout << "更新用户余额失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
 	return true;
 }
 
@@ -593,6 +1406,21 @@ bool saveAdminsToDB() {
 	return true;
 }
 
+// 插入一个新注册的管理员（单行插入）
+bool insertAdminToDB(const Admin& admin) {
+	QSqlQuery query;
+	query.prepare("INSERT INTO admins (username, password, name) VALUES (?, ?, ?)");
+	query.addBindValue(QString::fromStdString(admin.username));
+	query.addBindValue(QString::fromStdString(admin.password));
+	query.addBindValue(QString::fromStdString(admin.name));
+	
+	if (!query.exec()) {
+		cout << "插入管理员数据失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	return true;
+}
+
 // 从数据库加载管理员数据
 bool loadAdminsFromDB() {
 	admins.clear();
@@ -616,27 +1444,98 @@ bool loadAdminsFromDB() {
 	return true;
 }
 
-// 保存停开列车数据到数据库
-bool saveSuspendedTrainsToDB() {
+// 新增一条停开记录（单行插入，不再整表重写）
+bool addSuspendedTrainToDB(const string& trainNumber) {
 	QSqlQuery query;
+	query.prepare("INSERT OR IGNORE INTO suspended_trains (train_number) VALUES (?)");
+	query.addBindValue(QString::fromStdString(trainNumber));
 	
-	// 清空现有的停开列车数据
-	if (!query.exec("DELETE FROM suspended_trains")) {
-		cout << "清空停开列车数据失败: " << query.lastError().text().toStdString() << endl;
+	if (!query.exec()) {
+		cout << "插入停开列车数据失败: " << query.lastError().text().toStdString() << endl;
 		return false;
 	}
+	return true;
+}
+
+// 删除一条停开记录（单行删除）
+bool removeSuspendedTrainFromDB(const string& trainNumber) {
+	QSqlQuery query;
+	query.prepare("DELETE FROM suspended_trains WHERE train_number = ?");
+	query.addBindValue(QString::fromStdString(trainNumber));
 	
-	for (const auto& trainNumber : suspendedTrains) {
-		query.prepare("INSERT INTO suspended_trains (train_number) VALUES (?)");
-		query.addBindValue(QString::fromStdString(trainNumber));
-		
-		if (!query.exec()) {
-			cout << "插入停开列车数据失败: " << query.lastError().text().toStdString() << endl;
-			return false;
+	if (!query.exec()) {
+		cout << "删除停开列车数据失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	return true;
+}
+
+// 某车次库存（余票/停开状态）发生变化，使依赖它的查票缓存失效
+void bumpTrainVersion(size_t trainIdx) {
+	if (trainIdx < trainVersions.size()) {
+		trainVersions[trainIdx]++;
+	}
+}
+
+// 重建车次号到下标的索引（加载列车数据后调用）
+void rebuildTrainIndex() {
+	trainIndexByNumber.clear();
+	trainIndexByNumber.reserve(trains.size());
+	for (size_t i = 0; i < trains.size(); ++i) {
+		trainIndexByNumber[trains[i].trainNumber] = i;
+	}
+}
+
+// 按车次号查找列车下标，不存在时返回 -1
+int findTrainIndex(const string& trainNumber) {
+	auto it = trainIndexByNumber.find(trainNumber);
+	return it == trainIndexByNumber.end() ? -1 : static_cast<int>(it->second);
+}
+
+// 查找站点在车次中的下标，不存在时返回 -1
+int findStationIndex(const Train& train, const string& station) {
+	for (size_t i = 0; i < train.stations.size(); ++i) {
+		if (train.stations[i] == station) {
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+// 根据停开集合重建按列车下标的停开位图（加载列车或停开数据后调用）
+void rebuildSuspendedBitmap() {
+	suspendedBitmap.assign(trains.size(), false);
+	for (size_t i = 0; i < trains.size(); ++i) {
+		if (suspendedTrains.count(trains[i].trainNumber)) {
+			suspendedBitmap[i] = true;
 		}
 	}
+}
+
+// 查询某车次是否停开
+bool isTrainSuspended(const string& trainNumber) {
+	return suspendedTrains.count(trainNumber) > 0;
+}
+
+// 设置某车次的停开状态：同步更新集合、位图，并只持久化这一行
+bool setTrainSuspended(const string& trainNumber, bool suspended) {
+	recordSuspendEvent(trainNumber, suspended);
+	bool ok = suspended ? addSuspendedTrainToDB(trainNumber) : removeSuspendedTrainFromDB(trainNumber);
+	if (!ok) {
+		return false;
+	}
+	
+	if (suspended) {
+		suspendedTrains.insert(trainNumber);
+	} else {
+		suspendedTrains.erase(trainNumber);
+	}
 	
-	cout << "保存了 " << suspendedTrains.size() << " 个停开列车到数据库" << endl;
+	int trainIdx = findTrainIndex(trainNumber);
+	if (trainIdx >= 0 && static_cast<size_t>(trainIdx) < suspendedBitmap.size()) {
+		suspendedBitmap[trainIdx] = suspended;
+		bumpTrainVersion(trainIdx);
+	}
 	return true;
 }
 
@@ -652,246 +1551,3185 @@ bool loadSuspendedTrainsFromDB() {
 	
 	while (query.next()) {
 		string trainNumber = query.value(0).toString().toStdString();
-		suspendedTrains.push_back(trainNumber);
+		suspendedTrains.insert(trainNumber);
 	}
+	rebuildSuspendedBitmap();
 	
 	cout << "从数据库加载了 " << suspendedTrains.size() << " 个停开列车" << endl;
 	return true;
 }
 
-// 从数据库加载列车数据
-bool loadTrainsFromDB() {
-	trains.clear();
-	
-	QSqlQuery query;
-	if (!query.exec("SELECT train_number, stations, arrival_times, segment_available_seats, price_matrix FROM trains")) {
-		cout << "查询列车数据失败: " << query.lastError().text().toStdString() << endl;
+// 辅助函数：解析 "a;b;c|d;e;f" 格式的二维矩阵，无法解析的值按0处理
+vector<vector<int>> parseMatrix(const string& str) {
+	vector<vector<int>> matrix;
+	for (const string& row : split(str, '|')) {
+		vector<int> values;
+		for (const string& value : split(row, ';')) {
+			try {
+				values.push_back(stoi(trim(value)));
+			} catch (const exception& e) {
+				values.push_back(0);
+			}
+		}
+		matrix.push_back(values);
+	}
+	return matrix;
+}
+
+// ==================== 里程与票价 ====================
+// 票价 = 车次沿自己的停站经过的里程 × 每公里票价。站间里程在启动时由 map.txt 计算一次：
+// 以每个站为起点各做一次 Dijkstra，起点按线程分组并行计算，结果存入上三角矩阵（N 个站只占 N(N-1)/2 个 uint32）。
+// 加载车次时把相邻两站的里程沿停站顺序累加，区间里程为两站累计里程之差（不是两站间的路网最短里程）。
+// 票价矩阵中与按里程算出的票价（按数据原本的每公里0.5元）一致的区间不再保存，票价按需计算，修改每公里票价后立即生效；
+// 不一致的区间保留矩阵中的票价。有站点不在地图上的车次仍全部使用自带的票价矩阵。
+
+const double DEFAULT_FARE_PER_KM = 0.5;
+const uint32_t UNREACHABLE_DISTANCE = UINT32_MAX;
+
+double farePerKm = DEFAULT_FARE_PER_KM;   // 每公里票价（元）
+vector<string> mapStations;                // 路网地图中的站点
+unordered_map<string, int> mapStationIndex; // 站名 -> 地图下标
+vector<uint32_t> stationDistances;         // 上三角里程矩阵，按 triangleCell(站数, i, j) 存放 i < j 的两站最短里程
+
+// 两站间的路网最短里程（地图下标），不连通时返回 UNREACHABLE_DISTANCE
+uint32_t stationDistance(int a, int b) {
+	if (a == b) {
+		return 0;
+	}
+	if (a > b) {
+		swap(a, b);
+	}
+	return stationDistances[triangleCell(mapStations.size(), a, b)];
+}
+
+// 从 map.txt 读取路网并计算全部站点对的最短里程
+// 文件格式：每行 "站点,相邻站,距离,相邻站,距离,..."，边按无向处理
+bool loadStationMap(const string& path) {
+	ifstream file(path);
+	if (!file.is_open()) {
 		return false;
 	}
 	
-	while (query.next()) {
-		string trainNumber = query.value(0).toString().toStdString();
-		
-		// 解析站点
-		string stationsStr = query.value(1).toString().toStdString();
-		vector<string> stations = split(stationsStr, '|');
-		
-		// 解析到达时间
-		string timesStr = query.value(2).toString().toStdString();
-		vector<string> arrivalTimes = split(timesStr, '|');
-		
-		// 解析余票矩阵
-		string seatsStr = query.value(3).toString().toStdString();
-		vector<vector<int>> segmentAvailableSeats;
-		vector<string> seatRows = split(seatsStr, '|');
-		for (const string& row : seatRows) {
-			vector<int> seats;
-			vector<string> seatValues = split(row, ';');
-			for (const string& value : seatValues) {
-				try {
-					seats.push_back(stoi(trim(value)));
-				} catch (const exception& e) {
-					seats.push_back(0);
-				}
+	mapStations.clear();
+	mapStationIndex.clear();
+	auto stationId = [](const string& name) {
+		auto it = mapStationIndex.find(name);
+		if (it != mapStationIndex.end()) {
+			return it->second;
+		}
+		int id = static_cast<int>(mapStations.size());
+		mapStations.push_back(name);
+		mapStationIndex[name] = id;
+		return id;
+	};
+	
+	vector<vector<pair<int, uint32_t>>> graph;
+	string line;
+	while (getline(file, line)) {
+		vector<string> parts = split(line, ',');
+		if (parts.empty() || trim(parts[0]).empty()) {
+			continue;
+		}
+		int from = stationId(trim(parts[0]));
+		for (size_t k = 1; k + 1 < parts.size(); k += 2) {
+			int to = stationId(trim(parts[k]));
+			uint32_t km = 0;
+			try {
+				km = static_cast<uint32_t>(stoul(trim(parts[k + 1])));
+			} catch (const exception& e) {
+				continue;
 			}
-			segmentAvailableSeats.push_back(seats);
+			if (graph.size() < mapStations.size()) {
+				graph.resize(mapStations.size());
+			}
+			graph[from].push_back({to, km});
+			graph[to].push_back({from, km});
 		}
-		
-		// 解析票价矩阵
-		string pricesStr = query.value(4).toString().toStdString();
-		vector<vector<int>> priceMatrix;
-		vector<string> priceRows = split(pricesStr, '|');
-		for (const string& row : priceRows) {
-			vector<int> prices;
-			vector<string> priceValues = split(row, ';');
-			for (const string& value : priceValues) {
-				try {
-					prices.push_back(stoi(trim(value)));
-				} catch (const exception& e) {
-					prices.push_back(0);
+	}
+	graph.resize(mapStations.size());
+	
+	size_t n = mapStations.size();
+	stationDistances.assign(n > 1 ? triangleCells(n) : 0, UNREACHABLE_DISTANCE);
+	
+	// 每个线程负责若干起点，只写 j > 起点 的那一行，互不重叠
+	unsigned threadCount = max(1u, min<unsigned>(thread::hardware_concurrency(), static_cast<unsigned>(n)));
+	vector<thread> workers;
+	for (unsigned t = 0; t < threadCount; ++t) {
+		workers.emplace_back([&graph, n, t, threadCount]() {
+			vector<uint32_t> dist(n);
+			priority_queue<pair<uint32_t, int>, vector<pair<uint32_t, int>>, greater<pair<uint32_t, int>>> heap;
+			for (size_t source = t; source < n; source += threadCount) {
+				fill(dist.begin(), dist.end(), UNREACHABLE_DISTANCE);
+				dist[source] = 0;
+				heap.push({0, static_cast<int>(source)});
+				while (!heap.empty()) {
+					auto [d, u] = heap.top();
+					heap.pop();
+					if (d > dist[u]) {
+						continue;
+					}
+					for (const auto& [v, km] : graph[u]) {
+						if (d + km < dist[v]) {
+							dist[v] = d + km;
+							heap.push({dist[v], v});
+						}
+					}
+				}
+				for (size_t j = source + 1; j < n; ++j) {
+					stationDistances[triangleCell(n, source, j)] = dist[j];
 				}
 			}
-			priceMatrix.push_back(prices);
-		}
-		
-		trains.emplace_back(trainNumber, stations, arrivalTimes, segmentAvailableSeats, priceMatrix);
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
 	}
 	
-	cout << "从数据库加载了 " << trains.size() << " 个车次" << endl;
+	cout << "从 " << path << " 加载了 " << n << " 个站点的路网，计算了 " << stationDistances.size() << " 个站点对的里程" << endl;
 	return true;
 }
 
-// 保存列车数据到数据库
-bool saveTrainsToDB() {
-	QSqlQuery query;
-	
-	// 清空现有的列车数据
-	if (!query.exec("DELETE FROM trains")) {
-		cout << "清空列车数据失败: " << query.lastError().text().toStdString() << endl;
-		return false;
+// 按车次沿停站的里程计算区间票价，不足1元的部分舍去
+inline int routeFare(const Train& train, size_t fromIdx, size_t toIdx, double rate) {
+	return static_cast<int>((train.routeKm[toIdx] - train.routeKm[fromIdx]) * rate);
+}
+
+// 沿停站累加车次的里程；票价矩阵中与里程票价一致的区间改为按里程计算，全部一致时丢弃票价矩阵
+void resolveTrainFares(Train& train) {
+	size_t n = train.stations.size();
+	train.routeKm.clear();
+	if (mapStations.empty()) {
+		return;
 	}
-	
-	for (const auto& train : trains) {
-		// 序列化站点
-		string stationsStr = "";
-		for (size_t i = 0; i < train.stations.size(); ++i) {
-			stationsStr += train.stations[i];
-			if (i != train.stations.size() - 1) {
-				stationsStr += "|";
+	vector<uint32_t> routeKm(n, 0);
+	int previous = -1;
+	for (size_t i = 0; i < n; ++i) {
+		auto it = mapStationIndex.find(train.stations[i]);
+		if (it == mapStationIndex.end()) {
+			return;
+		}
+		if (i > 0) {
+			uint32_t leg = stationDistance(previous, it->second);
+			if (leg == UNREACHABLE_DISTANCE) {
+				return;
 			}
+			routeKm[i] = routeKm[i - 1] + leg;
 		}
-		
-		// 序列化到达时间
-		string timesStr = "";
-		for (size_t i = 0; i < train.arrivalTimes.size(); ++i) {
-			timesStr += train.arrivalTimes[i];
-			if (i != train.arrivalTimes.size() - 1) {
-				timesStr += "|";
+		previous = it->second;
+	}
+	train.routeKm = std::move(routeKm);
+	
+	if (train.fareTable.size() != triangleCells(n)) {
+		vector<uint32_t>().swap(train.fareTable);
+		return;
+	}
+	size_t kept = 0;
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t j = i + 1; j < n; ++j) {
+			uint32_t& fare = train.fareTable[triangleCell(n, i, j)];
+			if (fare != MISSING_FARE && static_cast<int>(fare) != routeFare(train, i, j, DEFAULT_FARE_PER_KM)) {
+				kept++;
+			} else {
+				fare = MISSING_FARE;
 			}
 		}
+	}
+	if (kept == 0) {
+		vector<uint32_t>().swap(train.fareTable);
+	} else {
+		cout << "车次 " << train.trainNumber << " 有 " << kept << " 个区间的票价与里程不一致，沿用票价矩阵" << endl;
+	}
+}
+
+// 某车次从站 fromIdx 到站 toIdx（fromIdx < toIdx）的票价，数据缺失时返回 -1
+int segmentFare(const Train& train, size_t fromIdx, size_t toIdx) {
+	size_t n = train.stations.size();
+	if (toIdx >= n) {
+		return -1;
+	}
+	if (train.fareTable.size() == triangleCells(n)) {
+		uint32_t fare = train.fareTable[triangleCell(n, fromIdx, toIdx)];
+		if (fare != MISSING_FARE) {
+			return static_cast<int>(fare);
+		}
+	}
+	return train.routeKm.empty() ? -1 : routeFare(train, fromIdx, toIdx, farePerKm);
+}
+
+// 修改每公里票价：按里程计价的车次立即生效，查票缓存全部失效
+void setFarePerKm(double rate) {
+	if (rate <= 0) {
+		return;
+	}
+	farePerKm = rate;
+	rebuildTrainColumns();
+	fleetEpoch++;
+}
+
+// ==================== 编组 ====================
+// 编组保存在 trains.car_layout 列，格式 "席别;车厢数;每车座位数|..."，车厢按顺序从1开始编号。
+// 旧数据没有编组时按车次类型给默认编组：G/D/C 字头为动车组（商务座、一等座、二等座），其余为卧铺加二等座，都是16节车厢。
+
+vector<CarGroup> defaultCarLayout(const string& trainNumber) {
+	char type = trainNumber.empty() ? ' ' : static_cast<char>(toupper(static_cast<unsigned char>(trainNumber[0])));
+	if (type == 'G' || type == 'D' || type == 'C') {
+		return {{BusinessClass, 1, 24}, {FirstClass, 2, 56}, {SecondClass, 13, 90}};
+	}
+	return {{SleeperClass, 8, 66}, {SecondClass, 8, 118}};
+}
+
+vector<CarGroup> parseCarLayout(const string& str) {
+	vector<CarGroup> layout;
+	for (const vector<int>& group : parseMatrix(str)) {
+		if (group.size() == 3 && group[0] >= 0 && group[0] < SEAT_CLASS_COUNT && group[1] > 0 && group[2] > 0) {
+			layout.push_back({group[0], group[1], group[2]});
+		}
+	}
+	return layout;
+}
+
+// 按编组展开每节车厢的席别、座位数和位图位置：每节车厢每个区段占 ceil(座位数/64) 个字
+void expandCarLayout(Train& train) {
+	train.carClasses.clear();
+	train.carSeats.clear();
+	train.carWordOffsets.clear();
+	size_t legs = train.stations.size() > 1 ? train.stations.size() - 1 : 0;
+	unsigned offset = 0;
+	for (const auto& group : train.carLayout) {
+		for (int c = 0; c < group.cars; ++c) {
+			train.carClasses.push_back(static_cast<unsigned char>(group.seatClass));
+			train.carSeats.push_back(static_cast<unsigned short>(group.seatsPerCar));
+			train.carWordOffsets.push_back(offset);
+			offset += static_cast<unsigned>((group.seatsPerCar + 63) / 64 * legs);
+		}
+	}
+	train.seatWordCount = offset;
+}
+
+// 某席别的座位总数
+int seatClassCapacity(const Train& train, int seatClass) {
+	int capacity = 0;
+	for (const auto& group : train.carLayout) {
+		if (group.seatClass == seatClass) {
+			capacity += group.cars * group.seatsPerCar;
+		}
+	}
+	return capacity;
+}
+
+// 上座率百分比（0~100），容量为0时为0
+inline unsigned char loadPercentOf(int capacity, int available) {
+	if (capacity <= 0) {
+		return 0;
+	}
+	return static_cast<unsigned char>(max(0, min(100, (capacity - available) * 100 / capacity)));
+}
+
+// ==================== 列存车次表 ====================
+// 查票要扫描全部车次。trains 中每个车次的站名、时刻、余票和票价各是一块独立的堆内存，
+// 逐个车次扫描时大部分时间花在追指针上。列车数据加载后（以及修改每公里票价后）另外生成一份按列连续存放的副本：
+// 站名换成整数编号，所有车次的停站首尾相接放在同一个数组里，时刻换算成分钟，
+// 每日初始余票和里程票价按车次平铺。
+// 候选车次用站点位图求交：每个站点保存经过它的车次集合（按64个车次一块的稀疏位图，只存非空的块），
+// 起点和终点的位图按块号归并、逐块按位与，得到同时经过两站的车次，不需要逐个车次检查站点列表，
+// 耗时与两站的车次数成正比而与车次总数无关。再在每个候选车次的停站中用 SSE2/AVX2 一次比较 4/8 个编号，找出起终点的位置。
+// 列存表建好后只读，新表整体替换旧表，查票快照持有当时的表，旧表在最后一个使用者释放后回收。
+
+struct TrainColumns {
+	vector<string> stationNames;              // 站点编号 -> 站名（预先按停站总数预留，元素地址不变）
+	unordered_map<string_view, int> stationIds; // 站名 -> 站点编号，键指向 stationNames 中的字符串
+	vector<int> stops;                        // 各车次停站的站点编号，按车次首尾相接
+	vector<unsigned> stopOffsets;             // 车次 i 的停站为 stops[stopOffsets[i], stopOffsets[i + 1])
+	vector<short> forwardMinutes;             // 与 stops 对齐：正向时刻表中该站的时间（分钟）
+	vector<short> backwardMinutes;            // 与 stops 对齐：反向时刻表中该站的时间（分钟）
+	vector<unsigned> matrixOffsets;           // 车次 i 的区间数据从 matrixOffsets[i] 开始，按上三角下标 triangleCell 存放
+	vector<uint16_t> templateSeats;           // 每个运行日的初始余票
+	vector<int> baseFares;                    // 里程票价（未乘动态系数），-1 表示缺失
+	vector<unsigned> stationBlockOffsets;     // 站点 s 的车次位图块为 [stationBlockOffsets[s], stationBlockOffsets[s + 1])
+	vector<unsigned> stationBlockIds;         // 块号（车次下标 / 64），同一站点内递增
+	vector<uint64_t> stationBlockBits;        // 块内经过该站的车次，第 k 位对应车次 块号 * 64 + k
+	
+	// 站名对应的编号，没有车次经过时返回 -1
+	int stationId(string_view name) const {
+		auto it = stationIds.find(name);
+		return it == stationIds.end() ? -1 : it->second;
+	}
+	size_t stopCount(size_t trainIdx) const { return stopOffsets[trainIdx + 1] - stopOffsets[trainIdx]; }
+};
+
+shared_ptr<const TrainColumns> trainColumns = make_shared<TrainColumns>();
+
+// 按 trains 重新生成列存表
+void rebuildTrainColumns() {
+	auto columns = make_shared<TrainColumns>();
+	size_t totalStops = 0;
+	size_t totalCells = 0;
+	for (const auto& train : trains) {
+		totalStops += train.stations.size();
+		totalCells += train.seatCapacity.size();
+	}
+	columns->stationNames.reserve(totalStops);
+	columns->stops.reserve(totalStops);
+	columns->forwardMinutes.reserve(totalStops);
+	columns->backwardMinutes.reserve(totalStops);
+	columns->stopOffsets.reserve(trains.size() + 1);
+	columns->matrixOffsets.reserve(trains.size() + 1);
+	columns->templateSeats.reserve(totalCells);
+	columns->baseFares.reserve(totalCells);
+	
+	for (size_t trainIdx = 0; trainIdx < trains.size(); ++trainIdx) {
+		const Train& train = trains[trainIdx];
+		size_t n = train.stations.size();
+		columns->stopOffsets.push_back(static_cast<unsigned>(columns->stops.size()));
+		columns->matrixOffsets.push_back(static_cast<unsigned>(columns->templateSeats.size()));
 		
-		// 序列化余票矩阵
-		string seatsStr = "";
-		for (size_t i = 0; i < train.segmentAvailableSeats.size(); ++i) {
-			for (size_t j = 0; j < train.segmentAvailableSeats[i].size(); ++j) {
-				seatsStr += to_string(train.segmentAvailableSeats[i][j]);
-				if (j != train.segmentAvailableSeats[i].size() - 1) {
-					seatsStr += ";";
-				}
-			}
-			if (i != train.segmentAvailableSeats.size() - 1) {
-				seatsStr += "|";
+		for (size_t i = 0; i < n; ++i) {
+			auto it = columns->stationIds.find(train.stations[i]);
+			if (it == columns->stationIds.end()) {
+				columns->stationNames.push_back(train.stations[i]);
+				it = columns->stationIds.emplace(columns->stationNames.back(), static_cast<int>(columns->stationNames.size() - 1)).first;
 			}
+			columns->stops.push_back(it->second);
+			// 正向行程（起点下标小于终点）和反向行程分别取时刻表的前半和后半
+			columns->forwardMinutes.push_back(static_cast<short>(timeToMinutes(getDirectionalTime(train.arrivalTimes, 0, 1, i))));
+			columns->backwardMinutes.push_back(static_cast<short>(timeToMinutes(getDirectionalTime(train.arrivalTimes, 1, 0, i))));
 		}
 		
-		// 序列化票价矩阵
-		string pricesStr = "";
-		for (size_t i = 0; i < train.priceMatrix.size(); ++i) {
-			for (size_t j = 0; j < train.priceMatrix[i].size(); ++j) {
-				pricesStr += to_string(train.priceMatrix[i][j]);
-				if (j != train.priceMatrix[i].size() - 1) {
-					pricesStr += ";";
-				}
+		columns->templateSeats.insert(columns->templateSeats.end(), train.seatCapacity.begin(), train.seatCapacity.end());
+		for (size_t i = 0; i < n; ++i) {
+			for (size_t j = i + 1; j < n; ++j) {
+				columns->baseFares.push_back(segmentFare(train, i, j));
 			}
-			if (i != train.priceMatrix.size() - 1) {
-				pricesStr += "|";
+		}
+	}
+	columns->stopOffsets.push_back(static_cast<unsigned>(columns->stops.size()));
+	columns->matrixOffsets.push_back(static_cast<unsigned>(columns->templateSeats.size()));
+	
+	// 站点 -> 车次位图：车次按下标递增处理，每个站点的块号自然有序
+	vector<vector<pair<unsigned, uint64_t>>> stationBlocks(columns->stationNames.size());
+	for (size_t trainIdx = 0; trainIdx < trains.size(); ++trainIdx) {
+		unsigned block = static_cast<unsigned>(trainIdx / 64);
+		uint64_t bit = 1ULL << (trainIdx % 64);
+		for (unsigned pos = columns->stopOffsets[trainIdx]; pos < columns->stopOffsets[trainIdx + 1]; ++pos) {
+			auto& blocks = stationBlocks[columns->stops[pos]];
+			if (blocks.empty() || blocks.back().first != block) {
+				blocks.push_back({block, 0});
 			}
+			blocks.back().second |= bit;
 		}
-		
-		// 插入到数据库
-		query.prepare("INSERT INTO trains (train_number, stations, arrival_times, segment_available_seats, price_matrix) VALUES (?, ?, ?, ?, ?)");
-		query.addBindValue(QString::fromStdString(train.trainNumber));
-		query.addBindValue(QString::fromStdString(stationsStr));
-		query.addBindValue(QString::fromStdString(timesStr));
-		query.addBindValue(QString::fromStdString(seatsStr));
-		query.addBindValue(QString::fromStdString(pricesStr));
-		
-		if (!query.exec()) {
-			cout << "插入列车数据失败: " << query.lastError().text().toStdString() << endl;
-			return false;
+	}
+	columns->stationBlockOffsets.reserve(stationBlocks.size() + 1);
+	for (const auto& blocks : stationBlocks) {
+		columns->stationBlockOffsets.push_back(static_cast<unsigned>(columns->stationBlockIds.size()));
+		for (const auto& block : blocks) {
+			columns->stationBlockIds.push_back(block.first);
+			columns->stationBlockBits.push_back(block.second);
 		}
 	}
+	columns->stationBlockOffsets.push_back(static_cast<unsigned>(columns->stationBlockIds.size()));
 	
-	cout << "保存了 " << trains.size() << " 个车次到数据库" << endl;
-	return true;
+	trainColumns = columns;
+}
+
+// 在一段停站编号中找出等于 a 或 b 的位置，按位置从小到大依次调用 visit(位置)。
+// 支持时用 AVX2 每次比较8个编号，否则用 SSE2 每次比较4个，剩余部分逐个比较
+template <typename Visit>
+void scanStops(const int* stops, size_t count, int a, int b, Visit visit) {
+	size_t i = 0;
+#if defined(__AVX2__)
+	const __m256i wantA = _mm256_set1_epi32(a);
+	const __m256i wantB = _mm256_set1_epi32(b);
+	for (; i + 8 <= count; i += 8) {
+		__m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stops + i));
+		__m256i hit = _mm256_or_si256(_mm256_cmpeq_epi32(ids, wantA), _mm256_cmpeq_epi32(ids, wantB));
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+		while (mask) {
+			visit(i + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+#elif defined(__SSE2__)
+	const __m128i wantA = _mm_set1_epi32(a);
+	const __m128i wantB = _mm_set1_epi32(b);
+	for (; i + 4 <= count; i += 4) {
+		__m128i ids = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stops + i));
+		__m128i hit = _mm_or_si128(_mm_cmpeq_epi32(ids, wantA), _mm_cmpeq_epi32(ids, wantB));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(hit)));
+		while (mask) {
+			visit(i + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; i < count; ++i) {
+		if (stops[i] == a || stops[i] == b) {
+			visit(i);
+		}
+	}
 }
 
-// 全局界面变量
-QLabel* passengerInfoLabel = nullptr;
-QLabel* tripsPassengerNameLabel = nullptr;
-QLabel* tripsPassengerPhoneLabel = nullptr;
+// ---- 短线路特化 ----
+// 绝大多数车次不超过16站。查票时按候选车次的站数分派到站数 N 为编译期常量的版本：停站比较的循环次数固定，
+// 可以完全展开，上三角下标 triangleCell(N, from, to) 的乘数也是常量；超过16站的车次按运行时站数计算。
+// 每个候选车次只在查票的调用处做一次分派，不经过函数指针。
+const size_t MAX_SPECIALIZED_STOPS = 16;
 
-// 更新余额显示
-void updateBalanceDisplay() {
-	if (currentUser && balanceLabel) {
-		balanceLabel->setText(QString("当前余额: ¥%1").arg(QString::number(currentUser->balance, 'f', 2)));
+// 车次的站数：N 不为0时是编译期常量，为0时使用运行时的 runtime
+template <size_t N>
+struct StopCount {
+	size_t runtime;
+	constexpr size_t value() const { return N != 0 ? N : runtime; }
+};
+
+// 按站数 n 调用 f(StopCount<N>)：n 不超过 MAX_SPECIALIZED_STOPS 时 N = n，否则 N = 0
+template <typename F, size_t... N>
+void dispatchStopCount(size_t n, F&& f, index_sequence<N...>) {
+	if (!((n == N && (f(StopCount<N>{n}), true)) || ...)) {
+		f(StopCount<0>{n});
 	}
-	
-	// 更新乘车人信息显示
-	if (currentUser) {
-		QString passengerInfo = QString("乘车人：%1 (手机号：%2)")
-			.arg(QString::fromStdString(currentUser->name))
-			.arg(QString::fromStdString(currentUser->phoneNumber));
-		
-		if (passengerInfoLabel) {
-			passengerInfoLabel->setText(passengerInfo);
+}
+
+template <typename F>
+void dispatchStopCount(size_t n, F&& f) {
+	dispatchStopCount(n, std::forward<F>(f), make_index_sequence<MAX_SPECIALIZED_STOPS + 1>());
+}
+
+// 找出同时经过站点 startId 和 endId 的车次，按车次下标从小到大调用 visit(车次下标, 起点下标, 终点下标, 站数)，
+// 站数为 StopCount（见“短线路特化”）。先对两站的车次位图求交，再在每个候选车次的停站中定位；
+// 站点在同一车次中重复出现时取第一次出现的位置
+template <typename Visit>
+void forEachTrainServing(const TrainColumns& columns, int startId, int endId, Visit visit) {
+	if (startId < 0 || endId < 0 || startId == endId) {
+		return;
+	}
+	const size_t none = SIZE_MAX;
+	size_t i = columns.stationBlockOffsets[startId];
+	size_t iEnd = columns.stationBlockOffsets[startId + 1];
+	size_t j = columns.stationBlockOffsets[endId];
+	size_t jEnd = columns.stationBlockOffsets[endId + 1];
+	
+	while (i < iEnd && j < jEnd) {
+		unsigned blockI = columns.stationBlockIds[i];
+		unsigned blockJ = columns.stationBlockIds[j];
+		if (blockI < blockJ) {
+			++i;
+			continue;
 		}
-		
-		// 更新我的行程页面的乘车人信息
-		if (tripsPassengerNameLabel) {
-			tripsPassengerNameLabel->setText(QString("乘车人：%1").arg(QString::fromStdString(currentUser->name)));
+		if (blockJ < blockI) {
+			++j;
+			continue;
 		}
 		
-		if (tripsPassengerPhoneLabel) {
-			tripsPassengerPhoneLabel->setText(QString("手机号：%1").arg(QString::fromStdString(currentUser->phoneNumber)));
+		uint64_t both = columns.stationBlockBits[i] & columns.stationBlockBits[j];
+		while (both) {
+			size_t trainIdx = static_cast<size_t>(blockI) * 64 + __builtin_ctzll(both);
+			both &= both - 1;
+			
+			const int* stops = columns.stops.data() + columns.stopOffsets[trainIdx];
+			dispatchStopCount(columns.stopCount(trainIdx), [&](auto stopCount) {
+				size_t startIdx = none;
+				size_t endIdx = none;
+				scanStops(stops, stopCount.value(), startId, endId, [&](size_t pos) {
+					if (stops[pos] == startId) {
+						if (startIdx == none) startIdx = pos;
+					} else if (endIdx == none) {
+						endIdx = pos;
+					}
+				});
+				visit(trainIdx, startIdx, endIdx, stopCount);
+			});
 		}
+		++i;
+		++j;
 	}
 }
 
-// 更新个人行程表
-void updateMyTripsTable() {
-	myTripsTable->setRowCount(0);
+// 从数据库加载列车数据
+bool loadTrainsFromDB() {
+	trains.clear();
 	
-	if (!currentUser) return;
+	QSqlQuery query;
+	if (!query.exec("SELECT train_number, stations, arrival_times, segment_available_seats, price_matrix, car_layout FROM trains")) {
+		cout << "查询列车数据失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
 	
-	int row = 0;
-	for (const auto& trip : currentUser->trips) {
-		if (!trip.stations.empty() && trip.stations.size() >= 2) {
-			string startStation = trip.stations.front();
-			string endStation = trip.stations.back();
-			size_t startIdx = 0;
-			size_t endIdx = trip.stations.size() - 1;
-			
-			// 获取票价 - 修复双向支持后的票价计算
-			int price = 0;
-			if (!trip.priceMatrix.empty() && !trip.priceMatrix[0].empty()) {
-				// 对于行程记录，使用第一行最后一列的价格（总价格）
-				price = trip.priceMatrix[0][trip.priceMatrix[0].size() - 1];
-			}
-			
-			// 获取时间信息
-			string departureTime = "";
-			string arrivalTime = "";
-			if (startIdx < trip.arrivalTimes.size()) {
-				departureTime = trip.arrivalTimes[startIdx];
-			}
-			if (endIdx < trip.arrivalTimes.size()) {
-				arrivalTime = trip.arrivalTimes[endIdx];
-			}
-			
-			myTripsTable->insertRow(row);
-			
-			QTableWidgetItem* trainItem = new QTableWidgetItem(QString::fromStdString(trip.trainNumber));
-			trainItem->setTextAlignment(Qt::AlignCenter);
-			myTripsTable->setItem(row, 0, trainItem);
-			
-			QTableWidgetItem* startItem = new QTableWidgetItem(QString::fromStdString(startStation));
-			startItem->setTextAlignment(Qt::AlignCenter);
-			myTripsTable->setItem(row, 1, startItem);
-			
-			QTableWidgetItem* endItem = new QTableWidgetItem(QString::fromStdString(endStation));
-			endItem->setTextAlignment(Qt::AlignCenter);
-			myTripsTable->setItem(row, 2, endItem);
-			
-			QTableWidgetItem* depTimeItem = new QTableWidgetItem(QString::fromStdString(departureTime));
-			depTimeItem->setTextAlignment(Qt::AlignCenter);
-			myTripsTable->setItem(row, 3, depTimeItem);
-			
-			QTableWidgetItem* arrTimeItem = new QTableWidgetItem(QString::fromStdString(arrivalTime));
-			arrTimeItem->setTextAlignment(Qt::AlignCenter);
-			myTripsTable->setItem(row, 4, arrTimeItem);
-			
-			QTableWidgetItem* priceItem = new QTableWidgetItem(QString::number(price));
-			priceItem->setTextAlignment(Qt::AlignCenter);
-			myTripsTable->setItem(row, 5, priceItem);
-			
-			row++;
+	while (query.next()) {
+		string trainNumber = query.value(0).toString().toStdString();
+		
+		// 解析站点
+		string stationsStr = query.value(1).toString().toStdString();
+		vector<string> stations = split(stationsStr, '|');
+		
+		// 解析到达时间
+		string timesStr = query.value(2).toString().toStdString();
+		vector<string> arrivalTimes = split(timesStr, '|');
+		
+		// 解析余票矩阵和票价矩阵
+		vector<vector<int>> segmentAvailableSeats = parseMatrix(query.value(3).toString().toStdString());
+		vector<vector<int>> priceMatrix = parseMatrix(query.value(4).toString().toStdString());
+		
+		trains.emplace_back(trainNumber, stations, arrivalTimes, segmentAvailableSeats, priceMatrix);
+		resolveTrainFares(trains.back());
+		
+		// 解析编组
+		Train& train = trains.back();
+		train.carLayout = parseCarLayout(query.value(5).toString().toStdString());
+		if (train.carLayout.empty()) {
+			train.carLayout = defaultCarLayout(trainNumber);
 		}
+		expandCarLayout(train);
+	}
+	rebuildTrainIndex();
+	rebuildSuspendedBitmap();
+	rebuildTrainColumns();
+	trainVersions.assign(trains.size(), 0);
+	datedInventory.assign(trains.size(), vector<ServiceDaySeats>(SALES_WINDOW_DAYS));
+	fleetEpoch++;
+	
+	cout << "从数据库加载了 " << trains.size() << " 个车次" << endl;
+	return true;
+}
+
+// ==================== 动态票价 ====================
+// 实际票价 = 里程票价 × 上座率系数 × 提前天数系数。
+// 两条系数曲线预先算成查找表（上座率按 0~100% 共101档，提前天数按 0~预售期），查票时每行只需两次查表和一次整数乘除。
+// 上座率按运行日、按区间保存在 ServiceDaySeats.loadPercent 中，只在该区间余票变化时重新计算，查票时不再计算；
+// 尚未售票的运行日上座率为0。需求的变化通过上座率体现：卖得越快，上座率越早进入上浮区间。
+
+const int PRICE_FACTOR_SCALE = 1000; // 系数以千分之一为单位
+
+// 上座率系数：低于50%时九折起逐步回到原价，50%~80%原价，80%以上逐步上浮，满座时上浮30%
+vector<int> buildLoadFactorCurve() {
+	vector<int> curve(101);
+	for (int percent = 0; percent <= 100; ++percent) {
+		if (percent < 50) {
+			curve[percent] = 900 + percent * 2;
+		} else if (percent < 80) {
+			curve[percent] = 1000;
+		} else {
+			curve[percent] = 1000 + (percent - 80) * 15;
+		}
+	}
+	return curve;
+}
+
+// 提前天数系数：提前15天及以上九五折，发车前2天内上浮5%
+vector<int> buildAdvanceCurve() {
+	vector<int> curve(SALES_WINDOW_DAYS + 1);
+	for (int days = 0; days <= SALES_WINDOW_DAYS; ++days) {
+		if (days >= 15) {
+			curve[days] = 950;
+		} else if (days < 2) {
+			curve[days] = 1050;
+		} else {
+			curve[days] = 1000;
+		}
+	}
+	return curve;
+}
+
+const vector<int> loadFactorCurve = buildLoadFactorCurve();
+const vector<int> advanceCurve = buildAdvanceCurve();
+
+// 重新计算某运行日某区间的上座率
+void updateLoadPercent(const Train& train, ServiceDaySeats& slot, size_t fromIdx, size_t toIdx) {
+	size_t cell = triangleCell(train.stations.size(), fromIdx, toIdx);
+	slot.loadPercent[cell] = loadPercentOf(train.seatCapacity[cell], slot.seats[cell]);
+}
+
+// 重新计算某运行日全部区间的上座率（从数据库加载余票后调用）
+void refreshLoadPercents(const Train& train, ServiceDaySeats& slot) {
+	for (size_t k = 0; k < train.seatCapacity.size(); ++k) {
+		slot.loadPercent[k] = loadPercentOf(train.seatCapacity[k], slot.seats[k]);
+	}
+}
+
+// 里程票价乘以上座率系数和提前天数系数
+inline int applyPriceFactors(int baseFare, int loadPercent, int daysAhead) {
+	daysAhead = max(0, min(SALES_WINDOW_DAYS, daysAhead));
+	long long fare = static_cast<long long>(baseFare) * loadFactorCurve[loadPercent] * advanceCurve[daysAhead];
+	return static_cast<int>(fare / (PRICE_FACTOR_SCALE * PRICE_FACTOR_SCALE));
+}
+
+// 按给定的运行日槽位计算某区间（fromIdx < toIdx）的实际票价，数据缺失时返回 -1。
+// slots 可以是实时的 datedInventory[车次下标]，也可以是查票快照中的副本，today 为对应的今天
+int dynamicFareIn(const Train& train, const vector<ServiceDaySeats>& slots, int today, int day, size_t fromIdx, size_t toIdx) {
+	int baseFare = segmentFare(train, fromIdx, toIdx);
+	if (baseFare < 0) {
+		return -1;
+	}
+	const ServiceDaySeats& slot = slots[day % SALES_WINDOW_DAYS];
+	int percent = slot.day == day ? slot.loadPercent[triangleCell(train.stations.size(), fromIdx, toIdx)] : 0;
+	return applyPriceFactors(baseFare, percent, day - today);
+}
+
+// 某车次某运行日某区间（fromIdx < toIdx）当前的实际票价，数据缺失时返回 -1
+int dynamicFare(size_t trainIdx, int day, size_t fromIdx, size_t toIdx) {
+	return dynamicFareIn(trains[trainIdx], datedInventory[trainIdx], currentServiceDay, day, fromIdx, toIdx);
+}
+
+// ==================== 变更事件 ====================
+// 修改内存数据的操作发出细粒度的变更事件：某车次某运行日某区间的余票（以及随之变化的票价）变了、
+// 某用户新增或删除了一张车票、某用户充值后余额变了。界面订阅这些事件，只更新受影响的单元格或行，不必重新查票、重建整张表。
+// 事件在修改完成后同步发出，监听者在同一线程中执行；无界面服务没有监听者。
+
+enum class ChangeKind {
+	SeatsChanged, // trainIdx、day、fromIdx、toIdx 有效
+	TripAdded,    // userId、tripIndex 有效：新车票在 user.trips 中的下标
+	TripRemoved,  // userId、tripIndex 有效：被删除的车票原来的下标，原最后一张车票已移到该位置
+	BalanceChanged // userId 有效：余额变了但车票没有变（充值）
+};
+
+struct ChangeEvent {
+	ChangeKind kind;
+	size_t trainIdx = 0;
+	int day = 0;
+	size_t fromIdx = 0;
+	size_t toIdx = 0;
+	int userId = 0;
+	size_t tripIndex = 0;
+};
+
+vector<function<void(const ChangeEvent&)>> changeListeners;
+
+void addChangeListener(function<void(const ChangeEvent&)> listener) {
+	changeListeners.push_back(std::move(listener));
+}
+
+void emitChange(const ChangeEvent& event) {
+	for (const auto& listener : changeListeners) {
+		listener(event);
+	}
+}
+
+void emitSeatsChanged(size_t trainIdx, int day, size_t fromIdx, size_t toIdx) {
+	if (changeListeners.empty()) return;
+	ChangeEvent event{ChangeKind::SeatsChanged};
+	event.trainIdx = trainIdx;
+	event.day = day;
+	event.fromIdx = fromIdx;
+	event.toIdx = toIdx;
+	emitChange(event);
+}
+
+void emitTripChanged(ChangeKind kind, int userId, size_t tripIndex) {
+	if (changeListeners.empty()) return;
+	ChangeEvent event{kind};
+	event.userId = userId;
+	event.tripIndex = tripIndex;
+	emitChange(event);
+}
+
+void emitBalanceChanged(int userId) {
+	if (changeListeners.empty()) return;
+	ChangeEvent event{ChangeKind::BalanceChanged};
+	event.userId = userId;
+	emitChange(event);
+}
+
+// ==================== 按运行日的余票 ====================
+// 车次表中的余票矩阵是每个运行日的初始余票（模板）。实际余票按运行日分别保存：
+// 每个车次一个长度为预售期天数的环形槽位数组，槽位下标为 运行日 % SALES_WINDOW_DAYS。
+// 某运行日第一次售票时才按模板分配连续数组，已过去的运行日在跨天时回收，
+// 余票只保存上三角、每个区间一个16位整数，内存上限为 车次数 × 预售期 × 站数(站数-1)/2 × 2字节，
+// 且只有实际售过票的运行日占用内存。数据库中仍按原来的 n×n 格式保存。
+
+// 运行日是否在预售期内
+bool isInSalesWindow(int day) {
+	return day >= currentServiceDay && day < currentServiceDay + SALES_WINDOW_DAYS;
+}
+
+// 只读：按给定的运行日槽位取某区间的余票，尚未售票的运行日直接读模板
+int availableSeatsIn(const Train& train, const vector<ServiceDaySeats>& slots, int day, size_t fromIdx, size_t toIdx) {
+	const ServiceDaySeats& slot = slots[day % SALES_WINDOW_DAYS];
+	size_t cell = triangleCell(train.stations.size(), fromIdx, toIdx);
+	return slot.day == day ? slot.seats[cell] : train.seatCapacity[cell];
+}
+
+// 只读：某运行日某区间的余票，尚未售票的运行日直接读模板，不分配内存
+int getAvailableSeats(size_t trainIdx, int day, size_t fromIdx, size_t toIdx) {
+	return availableSeatsIn(trains[trainIdx], datedInventory[trainIdx], day, fromIdx, toIdx);
+}
+
+// 可写：取某运行日的余票数组，首次写入时按模板分配（复用已回收运行日的槽位）
+ServiceDaySeats& serviceDaySeats(size_t trainIdx, int day) {
+	const Train& train = trains[trainIdx];
+	ServiceDaySeats& slot = datedInventory[trainIdx][day % SALES_WINDOW_DAYS];
+	if (slot.day != day) {
+		size_t n = train.stations.size();
+		slot.day = day;
+		slot.seats = train.seatCapacity;
+		slot.loadPercent.assign(triangleCells(n), 0);
+		slot.seatBits.assign(train.seatWordCount, 0);
+	}
+	return slot;
+}
+
+// ==================== 多进程共享余票 ====================
+// 同一台机器上的多个进程（界面版或无界面服务）用 --shared-inventory 名称 挂接同一块共享内存，其中保存
+// 预售期内每个车次每个运行日的余票、未确认的预留数和座位位图，全部是无锁原子变量。各进程的 datedInventory
+// 作为本地副本：修改余票前在跨进程写锁内拉取其他进程的修改，修改后把整个槽位推回共享内存；查票和界面读本地副本，
+// 定时器每秒拉取一次。每次写入槽位都把槽位编号追加到变更日志，拉取时只读日志中的新槽位，日志被覆盖时才全量扫描。
+// 槽位版本号为奇数表示正在写入，拉取时跳过；写到一半崩溃时版本号停在奇数，接管写锁的进程用自己的副本重写。
+// 每个进程在进程表中登记并每秒更新心跳，预留的每个座位在共享内存中有一条记录，写明所属进程的登记号。
+// 第一个创建共享内存的进程是协调进程：每秒在写锁内取出有变化的槽位，释放锁后再写入 dated_seats，其他进程不写余票表；
+// 发现某个进程心跳超过5秒未更新时，协调进程按预留记录把它的座位还回余票。协调进程自己失联时由发现的进程接管。
+// 写锁持有超过10秒视为持有者已崩溃，强制接管。车票和余额仍由各进程逐行写入数据库；用户数据和停开状态不共享。
+
+const uint32_t SHARED_INVENTORY_MAGIC = 0x52574934; // "RWI4"
+const long long SHARED_HEARTBEAT_TIMEOUT_MS = 5000;
+const long long SHARED_LOCK_TIMEOUT_SECONDS = 10;
+const size_t SHARED_MAX_PROCESSES = 64;
+const size_t SHARED_HOLD_RECORDS = 65536; // 全部进程同时未确认的预留座位数上限
+const size_t SHARED_CHANGE_LOG = 4096;    // 变更日志长度（槽位编号的环形缓冲）
+
+static_assert(atomic<uint16_t>::is_always_lock_free && atomic<uint32_t>::is_always_lock_free &&
+			  atomic<uint64_t>::is_always_lock_free && atomic<long long>::is_always_lock_free,
+			  "共享内存中的原子变量必须是无锁的");
+
+// 共享内存头部
+struct SharedInventoryHeader {
+	uint32_t magic;
+	uint32_t slotCount;
+	uint64_t fingerprint;          // 列车布局指纹：挂接的进程必须加载了相同的列车数据
+	atomic<uint64_t> sequence;     // 变更日志已写入的条数，未变化时拉取直接返回
+	atomic<uint64_t> lockWord;     // 写锁：高32位为持有者进程号，低32位为取得写锁的时间（秒），0 表示空闲；
+	                               // 持有者和时间由同一次比较交换写入，接管时也比较整个字，不会与新持有者交错
+	atomic<long long> coordinator; // 协调进程的进程号
+	atomic<long long> heartbeat;   // 协调进程最近一次心跳（毫秒）
+	atomic<long long> nextTicketId; // 各进程共用的下一张车票编号，车票写入同一个数据库，编号不能各自分配
+	atomic<uint32_t> nextProcessToken; // 进程登记号，每次登记分配一个新的，不会重复
+	atomic<uint32_t> usedHoldRecords;  // 正在使用的预留记录数
+	atomic<uint32_t> changeLog[SHARED_CHANGE_LOG]; // 第 k 次变更的槽位编号存放在 k % SHARED_CHANGE_LOG
+};
+
+// 进程表的一项
+struct SharedProcessEntry {
+	atomic<uint32_t> token;      // 登记号，0 表示空闲
+	atomic<long long> pid;
+	atomic<long long> heartbeat; // 最近一次心跳（毫秒）
+};
+
+// 一个预留座位的记录（只在持有写锁时读写）：owner 在其余字段写完后才写入，释放时先清除，崩溃时不会留下半条记录
+struct SharedHoldRecord {
+	atomic<uint32_t> owner; // 所属进程的登记号，0 表示空闲
+	uint32_t trainIdx;
+	int32_t day;
+	uint16_t fromIdx;
+	uint16_t toIdx;
+	uint16_t carNumber;
+	uint16_t seatNumber;
+};
+
+// 共享内存中一个槽位的头部，之后依次是余票、预留数（各 triangleCells(站数) 个）和座位位图
+struct SharedSlotHeader {
+	atomic<int> day;
+	atomic<uint32_t> version;
+	atomic<uint32_t> persistedVersion; // 协调进程最近写入数据库的版本
+};
+
+inline size_t alignTo8(size_t bytes) {
+	return (bytes + 7) & ~size_t(7);
+}
+
+inline long long currentMillis() {
+	return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void adjustSeats(size_t trainIdx, int day, size_t fromIdx, size_t toIdx, int delta);
+void markSeat(size_t trainIdx, int day, int carNumber, int seatNumber, size_t fromIdx, size_t toIdx, bool occupied);
+string datedSeatsText(size_t trainIdx, int day);
+bool writeDatedSeatsRow(const string& trainNumber, const string& serviceDate, const string& seats, ShardBatch* batch);
+
+class SharedInventory {
+public:
+	// 创建或挂接名为 name 的共享余票（需在加载列车、余票和车票之后调用），失败时返回 false
+	bool open(const string& name) {
+		pid = QCoreApplication::applicationPid();
+		size_t total = alignTo8(sizeof(SharedInventoryHeader));
+		processOffset = total;
+		total += alignTo8(SHARED_MAX_PROCESSES * sizeof(SharedProcessEntry));
+		holdOffset = total;
+		total += alignTo8(SHARED_HOLD_RECORDS * sizeof(SharedHoldRecord));
+		slotOffsets.clear();
+		for (const Train& train : trains) {
+			size_t cells = triangleCells(train.stations.size());
+			size_t slotBytes = alignTo8(sizeof(SharedSlotHeader)) + alignTo8(2 * cells * sizeof(uint16_t)) +
+							   train.seatWordCount * sizeof(uint64_t);
+			for (int s = 0; s < SALES_WINDOW_DAYS; ++s) {
+				slotOffsets.push_back(total);
+				total += slotBytes;
+			}
+		}
+		localVersions.assign(slotOffsets.size(), 0);
+		
+		memory.setKey(QString::fromStdString("railway-inventory-" + name));
+		if (memory.create(static_cast<qsizetype>(total))) {
+			initialize();
+			cout << "已创建共享余票 " << name << "（" << total << " 字节），本进程负责持久化" << endl;
+			return true;
+		}
+		if (memory.error() != QSharedMemory::AlreadyExists || !memory.attach()) {
+			cout << "无法创建或挂接共享余票: " << memory.errorString().toStdString() << endl;
+			return false;
+		}
+		const SharedInventoryHeader* h = header();
+		if (static_cast<size_t>(memory.size()) < total || h->magic != SHARED_INVENTORY_MAGIC ||
+			h->slotCount != slotOffsets.size() || h->fingerprint != fingerprint()) {
+			cout << "共享余票与本进程的列车数据不一致，请确认各进程使用同一个数据库" << endl;
+			memory.detach();
+			return false;
+		}
+		if (!registerProcess()) {
+			cout << "共享余票的进程数已达上限 " << SHARED_MAX_PROCESSES << endl;
+			memory.detach();
+			return false;
+		}
+		
+		// 共享内存中的数据比数据库新（协调进程每秒落盘），以共享内存为准；
+		// 车票编号取两者中较大的，防止与数据库中已有的编号重复
+		long long sharedNext = h->nextTicketId.load();
+		while (sharedNext < nextTicketId && !header()->nextTicketId.compare_exchange_weak(sharedNext, nextTicketId)) {
+		}
+		cout << "已挂接共享余票 " << name << endl;
+		tick();
+		return true;
+	}
+	
+	// 退出前调用：归还本进程未确认的预留；协调进程把余票落盘后卸任
+	void close() {
+		lock();
+		reclaimHolds(token);
+		unlock();
+		if (isCoordinator()) {
+			flush();
+			header()->coordinator.store(0);
+		}
+		uint32_t expected = token;
+		processEntry(processIndex)->token.compare_exchange_strong(expected, 0);
+	}
+	
+	// 跨进程写锁（可重入）：取得后先拉取其他进程的修改
+	void lock() {
+		if (lockDepth++ > 0) {
+			return;
+		}
+		SharedInventoryHeader* h = header();
+		bool stolen = false;
+		while (true) {
+			uint64_t now = static_cast<uint64_t>(currentMillis() / 1000);
+			uint64_t word = 0;
+			lockWord = (static_cast<uint64_t>(pid) << 32) | (now & 0xffffffffULL);
+			if (h->lockWord.compare_exchange_weak(word, lockWord)) {
+				break;
+			}
+			// word 是当前持有者的整个锁字：只有它在比较交换时仍未改变才能接管
+			uint64_t since = word & 0xffffffffULL;
+			if (word != 0 && now > since + static_cast<uint64_t>(SHARED_LOCK_TIMEOUT_SECONDS) &&
+				h->lockWord.compare_exchange_strong(word, lockWord)) {
+				cout << "共享余票写锁被进程 " << (word >> 32) << " 持有超时，视为已崩溃并接管" << endl;
+				stolen = true;
+				break;
+			}
+			this_thread::yield();
+		}
+		pull();
+		if (stolen) {
+			repairTornSlots();
+		}
+	}
+	
+	void unlock() {
+		if (--lockDepth == 0) {
+			uint64_t expected = lockWord;
+			if (!header()->lockWord.compare_exchange_strong(expected, 0)) {
+				cout << "共享余票写锁已被其他进程接管" << endl;
+			}
+		}
+	}
+	
+	// 把本地的某个槽位整体写入共享内存（需持有写锁）
+	void push(size_t trainIdx, int day) {
+		size_t index = trainIdx * SALES_WINDOW_DAYS + day % SALES_WINDOW_DAYS;
+		const ServiceDaySeats& slot = datedInventory[trainIdx][day % SALES_WINDOW_DAYS];
+		SharedSlotHeader* sh = slotHeader(index);
+		uint32_t writing = sh->version.load() | 1;
+		sh->version.store(writing);
+		if (sh->day.load() != slot.day) {
+			// 槽位换成新的运行日：旧运行日的预留数作废
+			atomic<uint16_t>* held = heldCells(index);
+			for (size_t c = 0; c < slot.seats.size(); ++c) {
+				held[c].store(0);
+			}
+			sh->day.store(slot.day);
+		}
+		atomic<uint16_t>* seats = seatCells(index);
+		for (size_t c = 0; c < slot.seats.size(); ++c) {
+			seats[c].store(slot.seats[c], memory_order_relaxed);
+		}
+		atomic<uint64_t>* bits = bitWords(index);
+		for (size_t w = 0; w < slot.seatBits.size(); ++w) {
+			bits[w].store(slot.seatBits[w], memory_order_relaxed);
+		}
+		sh->version.store(writing + 1);
+		localVersions[index] = writing + 1;
+		logChange(index);
+	}
+	
+	// 分配一个车票编号（各进程唯一）
+	long long allocateTicketId() {
+		return header()->nextTicketId.fetch_add(1);
+	}
+	
+	// 下一个将要分配的车票编号
+	long long peekTicketId() {
+		return header()->nextTicketId.load();
+	}
+	
+	// 是否还有 count 条空闲的预留记录（需持有写锁）
+	bool hasHoldRecords(size_t count) {
+		return header()->usedHoldRecords.load() + count <= SHARED_HOLD_RECORDS;
+	}
+	
+	// 登记一个预留座位并计入共享的预留数（需持有写锁，且已用 hasHoldRecords 确认有空闲记录），返回记录编号
+	uint32_t addHoldRecord(size_t trainIdx, int day, size_t fromIdx, size_t toIdx, int carNumber, int seatNumber) {
+		while (holdRecord(holdCursor)->owner.load() != 0) {
+			holdCursor = (holdCursor + 1) % SHARED_HOLD_RECORDS;
+		}
+		uint32_t record = holdCursor;
+		SharedHoldRecord* r = holdRecord(record);
+		r->trainIdx = static_cast<uint32_t>(trainIdx);
+		r->day = day;
+		r->fromIdx = static_cast<uint16_t>(fromIdx);
+		r->toIdx = static_cast<uint16_t>(toIdx);
+		r->carNumber = static_cast<uint16_t>(carNumber);
+		r->seatNumber = static_cast<uint16_t>(seatNumber);
+		r->owner.store(token);
+		header()->usedHoldRecords.fetch_add(1);
+		changeHeld(trainIdx, day, fromIdx, toIdx, 1);
+		return record;
+	}
+	
+	// 预留记录是否仍属于本进程（本进程停顿过久被视为崩溃时，协调进程已回收它的预留）
+	bool ownsHoldRecord(uint32_t record) {
+		return holdRecord(record)->owner.load() == token;
+	}
+	
+	// 释放一条本进程的预留记录（需持有写锁），共享的预留数随之减少
+	void removeHoldRecord(uint32_t record) {
+		SharedHoldRecord* r = holdRecord(record);
+		if (r->owner.load() != token) {
+			return;
+		}
+		r->owner.store(0);
+		header()->usedHoldRecords.fetch_sub(1);
+		changeHeld(r->trainIdx, r->day, r->fromIdx, r->toIdx, -1);
+	}
+	
+	// 某运行日某区间全部进程的未确认预留数
+	int heldAt(size_t trainIdx, int day, size_t cell) {
+		size_t index = trainIdx * SALES_WINDOW_DAYS + day % SALES_WINDOW_DAYS;
+		return slotHeader(index)->day.load() == day ? heldCells(index)[cell].load() : 0;
+	}
+	
+	// 拉取其他进程写入的槽位到本地副本，变化的区间发出余票变更事件
+	void pull() {
+		uint64_t sequence = header()->sequence.load();
+		if (sequence == seenSequence) {
+			return;
+		}
+		vector<uint32_t> changed;
+		bool complete = true;
+		if (!changedSlots(seenSequence, sequence, changed)) {
+			for (size_t index = 0; index < slotOffsets.size(); ++index) {
+				complete = pullSlot(index) && complete;
+			}
+		} else {
+			for (uint32_t index : changed) {
+				complete = pullSlot(index) && complete;
+			}
+		}
+		if (complete) {
+			seenSequence = sequence;
+		}
+	}
+	
+	// 定时器每秒调用：拉取修改并更新本进程心跳；协调进程回收失联进程的预留并落盘，协调进程失联时接管
+	void tick() {
+		pull();
+		SharedInventoryHeader* h = header();
+		long long now = currentMillis();
+		SharedProcessEntry* own = processEntry(processIndex);
+		if (own->token.load() != token) {
+			cout << "本进程停顿过久，预留已被回收，重新登记共享余票" << endl;
+			registerProcess();
+			own = processEntry(processIndex);
+		}
+		own->heartbeat.store(now);
+		
+		long long coordinator = h->coordinator.load();
+		if (coordinator != pid && now - h->heartbeat.load() > SHARED_HEARTBEAT_TIMEOUT_MS &&
+			h->coordinator.compare_exchange_strong(coordinator, pid)) {
+			cout << "协调进程 " << coordinator << " 已失联，本进程接管余票持久化" << endl;
+			fullFlush = true;
+		}
+		if (isCoordinator()) {
+			h->heartbeat.store(now);
+			reclaimDeadProcesses(now);
+			flush();
+		}
+	}
+	
+private:
+	QSharedMemory memory;
+	size_t processOffset = 0;
+	size_t holdOffset = 0;
+	vector<size_t> slotOffsets;     // 槽位 trainIdx * SALES_WINDOW_DAYS + 运行日 % SALES_WINDOW_DAYS 的偏移
+	vector<uint32_t> localVersions; // 本地副本对应的槽位版本
+	uint64_t seenSequence = ~0ULL;
+	long long pid = 0;
+	uint32_t token = 0;             // 本进程的登记号
+	size_t processIndex = 0;        // 本进程在进程表中的位置
+	uint32_t holdCursor = 0;        // 查找空闲预留记录的起点
+	int lockDepth = 0;
+	uint64_t lockWord = 0;          // 本进程持有写锁时写入的锁字
+	// 协调进程：尚未落盘的槽位，以及已读到的变更日志位置；刚成为协调进程时全量检查一次
+	set<uint32_t> unpersisted;
+	uint64_t flushSequence = 0;
+	bool fullFlush = true;
+	
+	SharedInventoryHeader* header() {
+		return static_cast<SharedInventoryHeader*>(memory.data());
+	}
+	SharedProcessEntry* processEntry(size_t i) {
+		return reinterpret_cast<SharedProcessEntry*>(static_cast<char*>(memory.data()) + processOffset) + i;
+	}
+	SharedHoldRecord* holdRecord(size_t i) {
+		return reinterpret_cast<SharedHoldRecord*>(static_cast<char*>(memory.data()) + holdOffset) + i;
+	}
+	SharedSlotHeader* slotHeader(size_t index) {
+		return reinterpret_cast<SharedSlotHeader*>(static_cast<char*>(memory.data()) + slotOffsets[index]);
+	}
+	atomic<uint16_t>* seatCells(size_t index) {
+		return reinterpret_cast<atomic<uint16_t>*>(reinterpret_cast<char*>(slotHeader(index)) + alignTo8(sizeof(SharedSlotHeader)));
+	}
+	atomic<uint16_t>* heldCells(size_t index) {
+		return seatCells(index) + triangleCells(trains[index / SALES_WINDOW_DAYS].stations.size());
+	}
+	atomic<uint64_t>* bitWords(size_t index) {
+		size_t cells = triangleCells(trains[index / SALES_WINDOW_DAYS].stations.size());
+		return reinterpret_cast<atomic<uint64_t>*>(reinterpret_cast<char*>(seatCells(index)) + alignTo8(2 * cells * sizeof(uint16_t)));
+	}
+	
+	bool isCoordinator() {
+		return header()->coordinator.load() == pid;
+	}
+	
+	static uint64_t fingerprint() {
+		uint64_t hash = 1469598103934665603ULL; // FNV-1a
+		auto mix = [&hash](uint64_t value) {
+			hash = (hash ^ value) * 1099511628211ULL;
+		};
+		mix(SALES_WINDOW_DAYS);
+		for (const Train& train : trains) {
+			for (char c : train.trainNumber) {
+				mix(static_cast<unsigned char>(c));
+			}
+			mix(train.stations.size());
+			mix(train.seatWordCount);
+		}
+		return hash;
+	}
+	
+	// 在进程表中登记：先写心跳再占用表项，协调进程不会把刚登记的进程当成失联
+	bool registerProcess() {
+		token = header()->nextProcessToken.fetch_add(1);
+		for (size_t i = 0; i < SHARED_MAX_PROCESSES; ++i) {
+			SharedProcessEntry* entry = processEntry(i);
+			if (entry->token.load() != 0) {
+				continue;
+			}
+			entry->heartbeat.store(currentMillis());
+			uint32_t expected = 0;
+			if (entry->token.compare_exchange_strong(expected, token)) {
+				entry->pid.store(pid);
+				processIndex = i;
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	// 记录一次槽位变更（需持有写锁，只有一个写入者）
+	void logChange(size_t index) {
+		SharedInventoryHeader* h = header();
+		uint64_t sequence = h->sequence.load();
+		h->changeLog[sequence % SHARED_CHANGE_LOG].store(static_cast<uint32_t>(index));
+		h->sequence.store(sequence + 1);
+	}
+	
+	// 读出变更日志 [from, to) 中的槽位（去重）；日志已被覆盖时返回 false，调用方改为全量扫描
+	bool changedSlots(uint64_t from, uint64_t to, vector<uint32_t>& slots) {
+		if (from == ~0ULL || to - from > SHARED_CHANGE_LOG) {
+			return false;
+		}
+		SharedInventoryHeader* h = header();
+		for (uint64_t k = from; k < to; ++k) {
+			slots.push_back(h->changeLog[k % SHARED_CHANGE_LOG].load());
+		}
+		// 读取期间写入者可能已绕回覆盖了读过的位置
+		if (h->sequence.load() > from + SHARED_CHANGE_LOG) {
+			return false;
+		}
+		sort(slots.begin(), slots.end());
+		slots.erase(unique(slots.begin(), slots.end()), slots.end());
+		return true;
+	}
+	
+	// 调整共享的预留数（需持有写锁），槽位已换成其他运行日时忽略；预留数变化同样需要落盘，版本号前进一个写入周期
+	void changeHeld(size_t trainIdx, int day, size_t fromIdx, size_t toIdx, int delta) {
+		size_t index = trainIdx * SALES_WINDOW_DAYS + day % SALES_WINDOW_DAYS;
+		SharedSlotHeader* sh = slotHeader(index);
+		if (sh->day.load() != day) {
+			return;
+		}
+		heldCells(index)[triangleCell(trains[trainIdx].stations.size(), fromIdx, toIdx)].fetch_add(static_cast<uint16_t>(delta));
+		uint32_t version = sh->version.load();
+		if ((version & 1) == 0) {
+			sh->version.store(version + 2);
+			if (localVersions[index] == version) {
+				localVersions[index] = version + 2;
+			}
+		}
+		logChange(index);
+	}
+	
+	// 把登记号为 owner 的进程的全部预留座位还回余票（需持有写锁）
+	void reclaimHolds(uint32_t owner) {
+		int reclaimed = 0;
+		for (size_t i = 0; i < SHARED_HOLD_RECORDS; ++i) {
+			SharedHoldRecord* r = holdRecord(i);
+			if (r->owner.load() != owner) {
+				continue;
+			}
+			r->owner.store(0);
+			header()->usedHoldRecords.fetch_sub(1);
+			size_t index = r->trainIdx * SALES_WINDOW_DAYS + r->day % SALES_WINDOW_DAYS;
+			if (isInSalesWindow(r->day) && slotHeader(index)->day.load() == r->day) {
+				changeHeld(r->trainIdx, r->day, r->fromIdx, r->toIdx, -1);
+				adjustSeats(r->trainIdx, r->day, r->fromIdx, r->toIdx, 1);
+				markSeat(r->trainIdx, r->day, r->carNumber, r->seatNumber, r->fromIdx, r->toIdx, false);
+			}
+			reclaimed++;
+		}
+		if (reclaimed > 0) {
+			cout << "回收了 " << reclaimed << " 个未确认的预留座位" << endl;
+		}
+	}
+	
+	// 协调进程：回收心跳超时的进程的预留，并清空它的进程表项
+	void reclaimDeadProcesses(long long now) {
+		for (size_t i = 0; i < SHARED_MAX_PROCESSES; ++i) {
+			SharedProcessEntry* entry = processEntry(i);
+			uint32_t owner = entry->token.load();
+			if (owner == 0 || owner == token || now - entry->heartbeat.load() <= SHARED_HEARTBEAT_TIMEOUT_MS) {
+				continue;
+			}
+			cout << "进程 " << entry->pid.load() << " 已失联，回收它的预留" << endl;
+			lock();
+			reclaimHolds(owner);
+			unlock();
+			entry->token.compare_exchange_strong(owner, 0);
+		}
+	}
+	
+	// 新建的共享内存：构造原子变量，并用本进程从数据库加载的余票初始化
+	void initialize() {
+		memset(memory.data(), 0, static_cast<size_t>(memory.size()));
+		SharedInventoryHeader* h = new (memory.data()) SharedInventoryHeader();
+		h->magic = SHARED_INVENTORY_MAGIC;
+		h->slotCount = static_cast<uint32_t>(slotOffsets.size());
+		h->fingerprint = fingerprint();
+		h->coordinator.store(pid);
+		h->heartbeat.store(currentMillis());
+		h->nextTicketId.store(nextTicketId);
+		h->nextProcessToken.store(1);
+		for (size_t i = 0; i < SHARED_MAX_PROCESSES; ++i) {
+			new (processEntry(i)) SharedProcessEntry();
+		}
+		for (size_t i = 0; i < SHARED_HOLD_RECORDS; ++i) {
+			new (holdRecord(i)) SharedHoldRecord();
+		}
+		for (size_t index = 0; index < slotOffsets.size(); ++index) {
+			const Train& train = trains[index / SALES_WINDOW_DAYS];
+			size_t cells = triangleCells(train.stations.size());
+			SharedSlotHeader* sh = new (slotHeader(index)) SharedSlotHeader();
+			sh->day.store(-1);
+			for (size_t c = 0; c < 2 * cells; ++c) {
+				new (seatCells(index) + c) atomic<uint16_t>(0);
+			}
+			for (size_t w = 0; w < train.seatWordCount; ++w) {
+				new (bitWords(index) + w) atomic<uint64_t>(0);
+			}
+		}
+		registerProcess();
+		lock();
+		for (size_t trainIdx = 0; trainIdx < trains.size(); ++trainIdx) {
+			for (const ServiceDaySeats& slot : datedInventory[trainIdx]) {
+				if (slot.day >= 0) {
+					push(trainIdx, slot.day);
+					slotHeader(trainIdx * SALES_WINDOW_DAYS + slot.day % SALES_WINDOW_DAYS)->persistedVersion.store(
+						localVersions[trainIdx * SALES_WINDOW_DAYS + slot.day % SALES_WINDOW_DAYS]);
+				}
+			}
+		}
+		unlock();
+		seenSequence = header()->sequence.load();
+		flushSequence = seenSequence;
+		fullFlush = false;
+	}
+	
+	// 崩溃的进程可能留下写到一半的槽位（版本号为奇数）：用本地副本的同一运行日整体重写
+	void repairTornSlots() {
+		for (size_t index = 0; index < slotOffsets.size(); ++index) {
+			SharedSlotHeader* sh = slotHeader(index);
+			size_t trainIdx = index / SALES_WINDOW_DAYS;
+			int day = datedInventory[trainIdx][index % SALES_WINDOW_DAYS].day;
+			if ((sh->version.load() & 1) && day >= 0 && sh->day.load() == day) {
+				push(trainIdx, day);
+			}
+		}
+	}
+	
+	// 拉取一个槽位；槽位正在写入或读取期间被改写时返回 false，下次再拉取
+	bool pullSlot(size_t index) {
+		SharedSlotHeader* sh = slotHeader(index);
+		uint32_t version = sh->version.load();
+		if (version == localVersions[index]) {
+			return true;
+		}
+		if (version & 1) {
+			return false;
+		}
+		size_t trainIdx = index / SALES_WINDOW_DAYS;
+		const Train& train = trains[trainIdx];
+		size_t n = train.stations.size();
+		int day = sh->day.load();
+		vector<uint16_t> seats(triangleCells(n));
+		vector<uint64_t> bits(train.seatWordCount);
+		const atomic<uint16_t>* sharedSeats = seatCells(index);
+		for (size_t c = 0; c < seats.size(); ++c) {
+			seats[c] = sharedSeats[c].load(memory_order_relaxed);
+		}
+		const atomic<uint64_t>* sharedBits = bitWords(index);
+		for (size_t w = 0; w < bits.size(); ++w) {
+			bits[w] = sharedBits[w].load(memory_order_relaxed);
+		}
+		if (sh->version.load() != version) {
+			return false;
+		}
+		localVersions[index] = version;
+		if (!isInSalesWindow(day)) {
+			return true; // 已过去的运行日，本地槽位已回收
+		}
+		
+		ServiceDaySeats& slot = datedInventory[trainIdx][index % SALES_WINDOW_DAYS];
+		bool sameDay = slot.day == day;
+		vector<uint16_t> previous = sameDay ? std::move(slot.seats) : vector<uint16_t>();
+		slot.day = day;
+		slot.seats = std::move(seats);
+		slot.seatBits = std::move(bits);
+		slot.loadPercent.assign(slot.seats.size(), 0);
+		refreshLoadPercents(train, slot);
+		bumpTrainVersion(trainIdx);
+		for (size_t i = 0; i < n; ++i) {
+			for (size_t j = i + 1; j < n; ++j) {
+				size_t cell = triangleCell(n, i, j);
+				if (!sameDay || previous[cell] != slot.seats[cell]) {
+					emitSeatsChanged(trainIdx, day, i, j);
+				}
+			}
+		}
+		return true;
+	}
+	
+	// 协调进程：在写锁内取出有变化且未落盘的槽位的余票文本，释放写锁后再写数据库，
+	// 数据库写入不会阻塞其他进程购票；写入成功后记下已落盘的版本
+	void flush() {
+		struct Row {
+			uint32_t index;
+			uint32_t version;
+			string trainNumber;
+			string serviceDate;
+			string seats;
+		};
+		vector<Row> rows;
+		lock();
+		uint64_t sequence = header()->sequence.load();
+		vector<uint32_t> changed;
+		if (fullFlush || !changedSlots(flushSequence, sequence, changed)) {
+			for (size_t index = 0; index < slotOffsets.size(); ++index) {
+				unpersisted.insert(static_cast<uint32_t>(index));
+			}
+			fullFlush = false;
+		} else {
+			unpersisted.insert(changed.begin(), changed.end());
+		}
+		flushSequence = sequence;
+		for (auto it = unpersisted.begin(); it != unpersisted.end();) {
+			SharedSlotHeader* sh = slotHeader(*it);
+			size_t trainIdx = *it / SALES_WINDOW_DAYS;
+			uint32_t version = sh->version.load();
+			int day = sh->day.load();
+			if (version & 1) {
+				++it; // 写到一半的槽位下次再写
+				continue;
+			}
+			if (version == sh->persistedVersion.load() || !isInSalesWindow(day) ||
+				datedInventory[trainIdx][*it % SALES_WINDOW_DAYS].day != day) {
+				it = unpersisted.erase(it);
+				continue;
+			}
+			rows.push_back({*it, version, trains[trainIdx].trainNumber, serviceDayToString(day), datedSeatsText(trainIdx, day)});
+			it = unpersisted.erase(it);
+		}
+		unlock();
+		if (rows.empty()) {
+			return;
+		}
+		
+		ShardBatch shardBatch;
+		bool ok = shardCount > 0 || db.transaction();
+		for (const Row& row : rows) {
+			ok = ok && writeDatedSeatsRow(row.trainNumber, row.serviceDate, row.seats, &shardBatch);
+		}
+		ok = ok && shardBatch.commit();
+		if (ok && shardCount == 0 && !db.commit()) {
+			ok = false;
+		}
+		if (!ok) {
+			cout << "共享余票落盘失败: " << db.lastError().text().toStdString() << endl;
+			if (shardCount == 0) {
+				db.rollback();
+			}
+			for (const Row& row : rows) {
+				unpersisted.insert(row.index);
+			}
+			return;
+		}
+		for (const Row& row : rows) {
+			slotHeader(row.index)->persistedVersion.store(row.version);
+		}
+	}
+};
+
+unique_ptr<SharedInventory> sharedInventory; // 未启用共享余票时为空
+
+// 共享余票写锁的作用域守卫，未启用共享余票时什么也不做；release 可在作用域结束前提前释放
+struct SharedInventoryLock {
+	SharedInventoryLock() {
+		if (sharedInventory) sharedInventory->lock();
+	}
+	~SharedInventoryLock() {
+		release();
+	}
+	void release() {
+		if (sharedInventory && held) sharedInventory->unlock();
+		held = false;
+	}
+	bool held = true;
+	SharedInventoryLock(const SharedInventoryLock&) = delete;
+	SharedInventoryLock& operator=(const SharedInventoryLock&) = delete;
+};
+
+// 退出前关闭共享余票（此时 sharedInventory 仍有效，归还的预留会推回共享内存）
+void closeSharedInventory() {
+	if (sharedInventory) {
+		sharedInventory->close();
+		sharedInventory.reset();
+	}
+}
+
+// 启用共享余票（命令行 --shared-inventory），之后每秒调用 tickSharedInventory
+bool openSharedInventory(const string& name) {
+	auto inventory = make_unique<SharedInventory>();
+	if (!inventory->open(name)) {
+		return false;
+	}
+	sharedInventory = std::move(inventory);
+	return true;
+}
+
+void tickSharedInventory() {
+	if (sharedInventory) {
+		sharedInventory->tick();
+	}
+}
+
+// 分配新车票的编号：共享余票时由共享内存中的计数器分配，多个进程不会重复
+long long allocateTicketId() {
+	return sharedInventory ? sharedInventory->allocateTicketId() : nextTicketId++;
+}
+
+// 下一个将要分配的车票编号（不分配）
+long long peekTicketId() {
+	return sharedInventory ? sharedInventory->peekTicketId() : nextTicketId;
+}
+
+// 调整本进程某运行日某区间未确认的预留数（共享余票时全部进程的预留数由预留记录维护），
+// 减到0的区间和运行日随即删除；已过去的运行日在滚动预售期时整体删除，之后的调整忽略
+void adjustHeldSeats(size_t trainIdx, int day, size_t fromIdx, size_t toIdx, int delta) {
+	if (!isInSalesWindow(day)) {
+		return;
+	}
+	auto dayIt = heldSeats.find({trainIdx, day});
+	if (dayIt == heldSeats.end()) {
+		dayIt = heldSeats.emplace(make_pair(trainIdx, day), map<pair<size_t, size_t>, int>()).first;
+	}
+	int& held = dayIt->second[{fromIdx, toIdx}];
+	held += delta;
+	if (held == 0) {
+		dayIt->second.erase({fromIdx, toIdx});
+		if (dayIt->second.empty()) {
+			heldSeats.erase(dayIt);
+		}
+	}
+}
+
+// 调整某运行日某区间的余票（预售期外的运行日忽略）
+void adjustSeats(size_t trainIdx, int day, size_t fromIdx, size_t toIdx, int delta) {
+	if (!isInSalesWindow(day)) {
+		return;
+	}
+	ServiceDaySeats& slot = serviceDaySeats(trainIdx, day);
+	uint16_t& seats = slot.seats[triangleCell(trains[trainIdx].stations.size(), fromIdx, toIdx)];
+	seats = static_cast<uint16_t>(seats + delta);
+	updateLoadPercent(trains[trainIdx], slot, fromIdx, toIdx);
+	bumpTrainVersion(trainIdx);
+	emitSeatsChanged(trainIdx, day, fromIdx, toIdx);
+	if (sharedInventory) {
+		sharedInventory->push(trainIdx, day);
+	}
+}
+
+// 待持久化的某运行日余票：内存余票加上尚未确认的预留（预留不落盘），
+// 按数据库中的格式展开为对称的 n×n 平铺数组。共享余票时加回的是全部进程的预留
+vector<int> persistableSeats(size_t trainIdx, int day) {
+	const vector<uint16_t>& packed = serviceDaySeats(trainIdx, day).seats;
+	size_t n = trains[trainIdx].stations.size();
+	vector<int> seats(n * n, 0);
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t j = i + 1; j < n; ++j) {
+			size_t cell = triangleCell(n, i, j);
+			int held = sharedInventory ? sharedInventory->heldAt(trainIdx, day, cell) : 0;
+			seats[i * n + j] = seats[j * n + i] = packed[cell] + held;
+		}
+	}
+	if (sharedInventory) {
+		return seats;
+	}
+	auto heldIt = heldSeats.find({trainIdx, day});
+	if (heldIt != heldSeats.end()) {
+		for (const auto& held : heldIt->second) {
+			size_t i = held.first.first;
+			size_t j = held.first.second;
+			seats[i * n + j] += held.second;
+			seats[j * n + i] += held.second;
+		}
+	}
+	return seats;
+}
+
+// 辅助函数：将二维矩阵序列化为 "a;b;c|d;e;f" 格式
+string serializeMatrix(const vector<vector<int>>& matrix) {
+	string result = "";
+	for (size_t i = 0; i < matrix.size(); ++i) {
+		for (size_t j = 0; j < matrix[i].size(); ++j) {
+			result += to_string(matrix[i][j]);
+			if (j != matrix[i].size() - 1) {
+				result += ";";
+			}
+		}
+		if (i != matrix.size() - 1) {
+			result += "|";
+		}
+	}
+	return result;
+}
+
+// 旧版本数据库迁移：旧版本只有一份余票，trains.segment_available_seats 在每次售票、退票时扣减或加回；
+// 现在它是每个运行日的初始余票（模板），实际余票在 dated_seats 中按运行日保存。
+// 旧版本的车票没有乘车日期（travel_date 为空），把这些车票加回各自区间，恢复出原始模板。
+// 只执行一次，完成后在 settings 中记录（需在迁移车票到分片之前调用）
+bool restoreSeatTemplates() {
+	QSqlQuery query;
+	if (!query.exec("SELECT value FROM settings WHERE key = 'seat_templates'")) {
+		cout << "读取设置失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	if (query.next()) {
+		return true;
+	}
+	
+	// 每个车次每个区间的旧车票张数
+	map<string, map<pair<string, string>, int>> legacySold;
+	if (!query.exec("SELECT train_number, start_station, end_station, COUNT(*) FROM user_trips WHERE travel_date = '' "
+					"GROUP BY train_number, start_station, end_station")) {
+		cout << "读取旧版本车票失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	while (query.next()) {
+		legacySold[query.value(0).toString().toStdString()][{query.value(1).toString().toStdString(),
+															  query.value(2).toString().toStdString()}] = query.value(3).toInt();
+	}
+	
+	bool ok = db.transaction();
+	int restored = 0;
+	for (const auto& train : legacySold) {
+		if (!ok) break;
+		QSqlQuery select;
+		select.prepare("SELECT stations, segment_available_seats FROM trains WHERE train_number = ?");
+		select.addBindValue(QString::fromStdString(train.first));
+		if (!select.exec() || !select.next()) {
+			continue; // 车次已删除
+		}
+		vector<string> stations = split(select.value(0).toString().toStdString(), '|');
+		vector<vector<int>> matrix = parseMatrix(select.value(1).toString().toStdString());
+		for (const auto& segment : train.second) {
+			auto startIt = find(stations.begin(), stations.end(), segment.first.first);
+			auto endIt = find(stations.begin(), stations.end(), segment.first.second);
+			if (startIt == stations.end() || endIt == stations.end()) {
+				continue;
+			}
+			size_t i = min(startIt, endIt) - stations.begin();
+			size_t j = max(startIt, endIt) - stations.begin();
+			if (i >= matrix.size() || j >= matrix[i].size()) {
+				continue;
+			}
+			matrix[i][j] += segment.second;
+			restored += segment.second;
+		}
+		QSqlQuery update;
+		update.prepare("UPDATE trains SET segment_available_seats = ? WHERE train_number = ?");
+		update.addBindValue(QString::fromStdString(serializeMatrix(matrix)));
+		update.addBindValue(QString::fromStdString(train.first));
+		ok = update.exec();
+	}
+	if (ok) {
+		QSqlQuery mark;
+		ok = mark.exec("INSERT INTO settings (key, value) VALUES ('seat_templates', '1')");
+	}
+	if (!ok || !db.commit()) {
+		cout << "恢复余票模板失败: " << db.lastError().text().toStdString() << endl;
+		db.rollback();
+		return false;
+	}
+	if (restored > 0) {
+		cout << "已把 " << restored << " 张旧版本车票加回列车的初始余票" << endl;
+	}
+	return true;
+}
+
+// 辅助函数：将平铺的 n×n 数组序列化为与 serializeMatrix 相同的格式
+string serializeFlatMatrix(const vector<int>& flat, size_t n) {
+	string result = "";
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t j = 0; j < n; ++j) {
+			result += to_string(flat[i * n + j]);
+			if (j != n - 1) {
+				result += ";";
+			}
+		}
+		if (i != n - 1) {
+			result += "|";
+		}
+	}
+	return result;
+}
+
+// 在指定的数据库连接中保存一个运行日的余票
+bool saveDatedSeatsInto(QSqlDatabase& database, const string& trainNumber, const string& serviceDate, const string& seats) {
+	QSqlQuery query(database);
+	query.prepare("INSERT OR REPLACE INTO dated_seats (train_number, service_date, seats) VALUES (?, ?, ?)");
+	query.addBindValue(QString::fromStdString(trainNumber));
+	query.addBindValue(QString::fromStdString(serviceDate));
+	query.addBindValue(QString::fromStdString(seats));
+	
+	if (!query.exec()) {
+		cout << "保存运行日余票失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	return true;
+}
+
+// 写入某车次某运行日的余票（单行插入或替换）
+bool writeDatedSeatsToDB(size_t trainIdx, int day, ShardBatch* batch) {
+	return writeDatedSeatsRow(trains[trainIdx].trainNumber, serviceDayToString(day), datedSeatsText(trainIdx, day), batch);
+}
+
+// 某车次某运行日待保存的余票文本
+string datedSeatsText(size_t trainIdx, int day) {
+	return serializeFlatMatrix(persistableSeats(trainIdx, day), trains[trainIdx].stations.size());
+}
+
+// 写入一行运行日余票。分片模式下写入车次所在分片：给出 batch 时加入该批同步提交，否则异步提交
+bool writeDatedSeatsRow(const string& trainNumber, const string& serviceDate, const string& seats, ShardBatch* batch) {
+	if (shardCount > 0) {
+		auto save = [trainNumber, serviceDate, seats](QSqlDatabase& shardDb) {
+			return saveDatedSeatsInto(shardDb, trainNumber, serviceDate, seats);
+		};
+		if (batch) {
+			batch->add(trainNumber, save);
+		} else {
+			trainShard(trainNumber).submit(save);
+		}
+		return true;
+	}
+	return saveDatedSeatsInto(db, trainNumber, serviceDate, seats);
+}
+
+// 保存某车次某运行日的余票。共享余票时由协调进程定时落盘，这里不写
+bool saveDatedSeatsToDB(size_t trainIdx, int day, ShardBatch* batch) {
+	if (sharedInventory) {
+		return true;
+	}
+	return writeDatedSeatsToDB(trainIdx, day, batch);
+}
+
+// 删除数据库中已过去运行日的余票记录
+bool deleteRetiredDatedSeatsFromDB() {
+	QString today = QString::fromStdString(serviceDayToString(currentServiceDay));
+	for (auto& writer : shardWriters) {
+		writer->submit([today](QSqlDatabase& shardDb) {
+			QSqlQuery query(shardDb);
+			query.prepare("DELETE FROM dated_seats WHERE service_date < ?");
+			query.addBindValue(today);
+			return query.exec();
+		});
+	}
+	
+	QSqlQuery query;
+	query.prepare("DELETE FROM dated_seats WHERE service_date < ?");
+	query.addBindValue(today);
+	
+	if (!query.exec()) {
+		cout << "删除过期余票数据失败: " << query.lastError().text().toStdString() << endl;
+		return false;
+	}
+	return true;
+}
+
+// 从数据库加载预售期内各运行日的余票（需在加载列车数据之后调用）
+bool loadDatedSeatsFromDB() {
+	deleteRetiredDatedSeatsFromDB();
+	
+	// 读出全部 (车次, 运行日, 余票)：不分片时读主库，分片时逐个分片读取
+	vector<array<string, 3>> rows;
+	auto readRows = [&rows](QSqlQuery& query) {
+		if (!query.exec("SELECT train_number, service_date, seats FROM dated_seats")) {
+			cout << "查询运行日余票数据失败: " << query.lastError().text().toStdString() << endl;
+			return false;
+		}
+		while (query.next()) {
+			rows.push_back({query.value(0).toString().toStdString(), query.value(1).toString().toStdString(),
+							query.value(2).toString().toStdString()});
+		}
+		return true;
+	};
+	if (shardCount == 0) {
+		QSqlQuery query;
+		if (!readRows(query)) {
+			return false;
+		}
+	}
+	for (auto& writer : shardWriters) {
+		writer->runSync([&readRows](QSqlDatabase& shardDb) {
+			QSqlQuery query(shardDb);
+			return readRows(query);
+		});
+	}
+	
+	int loaded = 0;
+	for (const auto& row : rows) {
+		int trainIdx = findTrainIndex(row[0]);
+		int day = parseServiceDay(row[1]);
+		if (trainIdx < 0 || !isInSalesWindow(day)) {
+			continue;
+		}
+		
+		vector<vector<int>> matrix = parseMatrix(row[2]);
+		ServiceDaySeats& slot = serviceDaySeats(trainIdx, day);
+		size_t n = trains[trainIdx].stations.size();
+		for (size_t i = 0; i < n && i < matrix.size(); ++i) {
+			for (size_t j = i + 1; j < n && j < matrix[i].size(); ++j) {
+				slot.seats[triangleCell(n, i, j)] = clampCell<uint16_t>(matrix[i][j]);
+			}
+		}
+		refreshLoadPercents(trains[trainIdx], slot);
+		loaded++;
+	}
+	
+	cout << "从数据库加载了 " << loaded << " 个运行日的余票" << endl;
+	return true;
+}
+
+// 跨天时滚动预售窗口：回收已过去运行日的槽位内存和预留数，并删除数据库中的过期记录。
+// 预售窗口变化时返回 true（界面需要刷新日期列表）
+bool rollSalesWindow() {
+	int today = todayServiceDay();
+	if (today == currentServiceDay) {
+		return false;
+	}
+	
+	currentServiceDay = today;
+	for (auto& slots : datedInventory) {
+		for (auto& slot : slots) {
+			if (slot.day >= 0 && slot.day < today) {
+				slot.day = -1;
+				vector<uint16_t>().swap(slot.seats);
+				vector<unsigned char>().swap(slot.loadPercent);
+				vector<uint64_t>().swap(slot.seatBits);
+			}
+		}
+	}
+	for (auto it = heldSeats.begin(); it != heldSeats.end();) {
+		it = it->first.second < today ? heldSeats.erase(it) : next(it);
+	}
+	deleteRetiredDatedSeatsFromDB();
+	fleetEpoch++;
+	return true;
+}
+
+// ==================== 座位分配 ====================
+// 每个运行日每节车厢每个相邻两站区段一组位图（每个座位一位）。为区间 [fromIdx, toIdx) 分配座位时，
+// 逐节车厢把区间内各区段的占用字按位或（等价于空闲位按位与），再用 find-first-set 找第一个空座，
+// 每节车厢只需 区段数 × ceil(座位数/64) 次字操作，与已售票数无关。
+// 位图只存在于内存，启动时由已售车票重建；预留的座位同样占位，释放或超时后清除。
+
+// 某节车厢（从0开始）某区段的第一个位图字
+inline uint64_t* seatWords(const Train& train, ServiceDaySeats& slot, size_t car, size_t leg) {
+	size_t wordsPerLeg = (train.carSeats[car] + 63) / 64;
+	return slot.seatBits.data() + train.carWordOffsets[car] + leg * wordsPerLeg;
+}
+
+// 设置或清除某座位在区间 [fromIdx, toIdx) 内各区段的占用位（车厢号、座位号从1开始）
+void markSeat(size_t trainIdx, int day, int carNumber, int seatNumber, size_t fromIdx, size_t toIdx, bool occupied) {
+	const Train& train = trains[trainIdx];
+	if (!isInSalesWindow(day) || carNumber < 1 || carNumber > static_cast<int>(train.carSeats.size()) ||
+		seatNumber < 1 || seatNumber > train.carSeats[carNumber - 1]) {
+		return;
+	}
+	ServiceDaySeats& slot = serviceDaySeats(trainIdx, day);
+	size_t car = carNumber - 1;
+	uint64_t bit = 1ULL << ((seatNumber - 1) % 64);
+	for (size_t leg = fromIdx; leg < toIdx; ++leg) {
+		uint64_t& word = seatWords(train, slot, car, leg)[(seatNumber - 1) / 64];
+		word = occupied ? (word | bit) : (word & ~bit);
+	}
+	if (sharedInventory) {
+		sharedInventory->push(trainIdx, day);
+	}
+}
+
+// 在某运行日为区间 [fromIdx, toIdx) 分配一个指定席别的空座并占用，成功时填写车厢号和座位号
+bool assignSeat(size_t trainIdx, int day, int seatClass, size_t fromIdx, size_t toIdx, int& carNumber, int& seatNumber) {
+	const Train& train = trains[trainIdx];
+	if (!isInSalesWindow(day) || fromIdx >= toIdx) {
+		return false;
+	}
+	ServiceDaySeats& slot = serviceDaySeats(trainIdx, day);
+	for (size_t car = 0; car < train.carClasses.size(); ++car) {
+		if (train.carClasses[car] != seatClass) {
+			continue;
+		}
+		size_t seatsInCar = train.carSeats[car];
+		size_t words = (seatsInCar + 63) / 64;
+		for (size_t w = 0; w < words; ++w) {
+			uint64_t occupied = 0;
+			for (size_t leg = fromIdx; leg < toIdx; ++leg) {
+				occupied |= seatWords(train, slot, car, leg)[w];
+			}
+			size_t bitsInWord = min<size_t>(64, seatsInCar - w * 64);
+			uint64_t valid = bitsInWord == 64 ? ~0ULL : ((1ULL << bitsInWord) - 1);
+			uint64_t free = ~occupied & valid;
+			if (free != 0) {
+				carNumber = static_cast<int>(car + 1);
+				seatNumber = static_cast<int>(w * 64 + __builtin_ctzll(free) + 1);
+				markSeat(trainIdx, day, carNumber, seatNumber, fromIdx, toIdx, true);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// 由全部用户的已售车票重建预售期内的座位占用（加载用户数据后调用）
+void rebuildSeatOccupancy() {
+	for (auto& slots : datedInventory) {
+		for (auto& slot : slots) {
+			fill(slot.seatBits.begin(), slot.seatBits.end(), 0);
+		}
+	}
+	for (const auto& user : users) {
+		for (const auto& trip : user.trips) {
+			int day = parseServiceDay(trip.travelDate);
+			int trainIdx = findTrainIndex(trip.trainNumber);
+			if (trip.carNumber == 0 || trainIdx < 0 || !isInSalesWindow(day)) {
+				continue;
+			}
+			int startIdx = findStationIndex(trains[trainIdx], trip.startStation);
+			int endIdx = findStationIndex(trains[trainIdx], trip.endStation);
+			if (startIdx >= 0 && endIdx >= 0) {
+				markSeat(trainIdx, day, trip.carNumber, trip.seatNumber, min(startIdx, endIdx), max(startIdx, endIdx), true);
+			}
+		}
+	}
+}
+
+// 车票的座位描述，例如 "二等座 05车012号"
+string seatLabel(int seatClass, int carNumber, int seatNumber) {
+	string name = seatClass >= 0 && seatClass < SEAT_CLASS_COUNT ? SEAT_CLASSES[seatClass].name : "";
+	if (carNumber == 0) {
+		return name.empty() ? "-" : name;
+	}
+	char text[32];
+	snprintf(text, sizeof(text), " %02d车%03d号", carNumber, seatNumber);
+	return name + text;
+}
+
+// 购票请求中的一段行程
+struct BookingLeg {
+	string trainNumber;
+	string startStation;
+	string endStation;
+	int serviceDay = 0; // 乘车日期（儒略日）
+	int passengers = 1; // 本段购票张数
+	int seatClass = SecondClass;
+};
+
+// 购票失败的原因，调用方按它决定后续处理，message 只用于显示
+enum class BookingError {
+	None,
+	InvalidRequest,      // 请求参数错误：张数、席别、日期、车次或站点不存在等
+	TrainSuspended,      // 车次已停开
+	SoldOut,             // 余票或该席别空座不足
+	TooManyHolds,        // 共享余票的预留记录已用完
+	HoldNotFound,        // 预留不存在、已超时或已被回收
+	HoldNotOwned,        // 预留属于其他用户
+	InsufficientBalance, // 余额不足，预留保持不变
+	StorageFailed        // 持久化失败
+};
+
+// 购票结果
+struct BookingResult {
+	bool success = false;
+	BookingError error = BookingError::None;
+	string message;     // 失败原因，供界面显示
+	int totalPrice = 0; // 本次应付总额
+	vector<string> seats; // 购票成功时分配的座位（车次 + 座位描述）
+	vector<long long> ticketIds; // 与 seats 一一对应的车票编号
+};
+
+// 解析并校验后的一段行程
+struct ResolvedBookingLeg {
+	size_t trainIdx;
+	int serviceDay;
+	size_t startIdx;
+	size_t endIdx;
+	size_t fromIdx;
+	size_t toIdx;
+	int passengers;
+	int unitPrice; // 预留时的实际票价，确认时按此成交
+	int seatClass;
+	vector<pair<int, int>> seats; // 预留时为每位乘客分配的 (车厢号, 座位号)
+};
+
+// ==================== 负载录制 ====================
+// 录制文件格式：文件头 "RWTRACE3" + 录制当天的运行日编号 + 录制开始时下一个车票编号，之后每条记录依次为
+//   操作类型(1字节)、距上一条记录的微秒数、用户ID+1、该类型的字段
+// 整数按 varint 编码（有符号数先做 zigzag），字符串为 长度 + UTF-8 字节。
+// 回放时把“今天”设为录制当天，乘车日期和预售期与录制时完全一致。
+// 退票按车票编号录制：录制开始前已有的车票编号在数据库副本中不变，录制期间售出的车票
+// 在回放时按相同顺序重新售出，编号按两次开始时的差值换算。
+
+const char WORKLOAD_TRACE_MAGIC[] = "RWTRACE3";
+
+enum class WorkloadOp : unsigned char {
+	Search = 1,
+	Book = 2,
+	Refund = 3,
+	Recharge = 4,
+	Suspend = 5,
+	Resume = 6
+};
+
+// 一条负载事件，只有与操作类型相关的字段有意义
+struct WorkloadEvent {
+	WorkloadOp op = WorkloadOp::Search;
+	long long timestampMicros = 0; // 距录制开始的微秒数
+	int userId = -1;
+	string trainNumber;            // Suspend / Resume
+	string startStation;           // Search
+	string endStation;             // Search
+	string departureTimeFilter;    // Search
+	int serviceDay = 0;            // Search：乘车日期（儒略日）
+	int sortKey = 0;               // Search
+	int page = 0;                  // Search
+	int pageSize = 0;              // Search
+	vector<BookingLeg> legs;       // Book
+	long long ticketId = 0;        // Refund：车票编号，0 表示未找到车票
+	long long amountCents = 0;     // Recharge
+};
+
+ofstream workloadTrace;
+mutex workloadTraceMutex; // 无界面服务中查票在工作线程执行，写录制文件需要加锁
+bool workloadRecording = false;
+chrono::steady_clock::time_point workloadTraceStart;
+long long workloadTraceLastMicros = 0;
+long long replayFirstTicketId = 0; // 回放：录制开始时下一个车票编号
+long long replayTicketOffset = 0;  // 回放：录制期间售出的车票在回放中的编号差值
+
+void writeVarint(string& out, unsigned long long value) {
+	while (value >= 0x80) {
+		out += static_cast<char>((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	out += static_cast<char>(value);
+}
+
+void writeSignedVarint(string& out, long long value) {
+	writeVarint(out, (static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63));
+}
+
+void writeTraceString(string& out, const string& value) {
+	writeVarint(out, value.size());
+	out += value;
+}
+
+bool readVarint(const string& data, size_t& pos, unsigned long long& value) {
+	value = 0;
+	for (int shift = 0; shift < 64 && pos < data.size(); shift += 7) {
+		unsigned char byte = static_cast<unsigned char>(data[pos++]);
+		value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool readSignedVarint(const string& data, size_t& pos, long long& value) {
+	unsigned long long raw;
+	if (!readVarint(data, pos, raw)) {
+		return false;
+	}
+	value = static_cast<long long>(raw >> 1) ^ -static_cast<long long>(raw & 1);
+	return true;
+}
+
+bool readTraceString(const string& data, size_t& pos, string& value) {
+	unsigned long long length;
+	if (!readVarint(data, pos, length) || length > data.size() - pos) {
+		return false;
+	}
+	value = data.substr(pos, length);
+	pos += length;
+	return true;
+}
+
+// 开始录制到指定文件（覆盖已有文件）。文件头记录当前运行日和下一个车票编号，
+// 需在设置 currentServiceDay、加载数据并挂接共享余票之后调用
+bool startWorkloadRecording(const string& path) {
+	workloadTrace.open(path, ios::binary | ios::trunc);
+	if (!workloadTrace) {
+		cout << "无法创建录制文件: " << path << endl;
+		return false;
+	}
+	string header(WORKLOAD_TRACE_MAGIC);
+	writeSignedVarint(header, currentServiceDay);
+	writeSignedVarint(header, peekTicketId());
+	workloadTrace.write(header.data(), header.size());
+	workloadTraceStart = chrono::steady_clock::now();
+	workloadTraceLastMicros = 0;
+	workloadRecording = true;
+	cout << "开始录制负载: " << path << endl;
+	return true;
+}
+
+// 编码并写入一条事件
+void recordWorkloadEvent(const WorkloadEvent& event) {
+	lock_guard<mutex> lock(workloadTraceMutex);
+	long long now = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - workloadTraceStart).count();
+	
+	string out;
+	out += static_cast<char>(event.op);
+	writeVarint(out, static_cast<unsigned long long>(max(0LL, now - workloadTraceLastMicros)));
+	writeVarint(out, static_cast<unsigned long long>(event.userId + 1));
+	switch (event.op) {
+		case WorkloadOp::Search:
+			writeTraceString(out, event.startStation);
+			writeTraceString(out, event.endStation);
+			writeTraceString(out, event.departureTimeFilter);
+			writeSignedVarint(out, event.serviceDay);
+			writeVarint(out, event.sortKey);
+			writeVarint(out, event.page);
+			writeVarint(out, event.pageSize);
+			break;
+		case WorkloadOp::Book:
+			writeVarint(out, event.legs.size());
+			for (const auto& leg : event.legs) {
+				writeTraceString(out, leg.trainNumber);
+				writeTraceString(out, leg.startStation);
+				writeTraceString(out, leg.endStation);
+				writeSignedVarint(out, leg.serviceDay);
+				writeSignedVarint(out, leg.passengers);
+				writeVarint(out, static_cast<unsigned long long>(leg.seatClass));
+			}
+			break;
+		case WorkloadOp::Refund:
+			writeSignedVarint(out, event.ticketId);
+			break;
+		case WorkloadOp::Recharge:
+			writeSignedVarint(out, event.amountCents);
+			break;
+		case WorkloadOp::Suspend:
+		case WorkloadOp::Resume:
+			writeTraceString(out, event.trainNumber);
+			break;
+	}
+	
+	workloadTrace.write(out.data(), out.size());
+	workloadTraceLastMicros = max(workloadTraceLastMicros, now);
+}
+
+// 读取整个录制文件、录制当天的运行日编号和录制开始时下一个车票编号，格式错误时返回 false
+bool readWorkloadTrace(const string& path, vector<WorkloadEvent>& events, int& recordingDay, long long& firstTicketId) {
+	ifstream file(path, ios::binary);
+	if (!file) {
+		cout << "无法打开录制文件: " << path << endl;
+		return false;
+	}
+	string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	size_t magicLength = sizeof(WORKLOAD_TRACE_MAGIC) - 1;
+	if (data.compare(0, magicLength, WORKLOAD_TRACE_MAGIC) != 0) {
+		cout << "不是负载录制文件或录制文件版本过旧，请重新录制: " << path << endl;
+		return false;
+	}
+	
+	size_t pos = magicLength;
+	long long headerDay;
+	if (!readSignedVarint(data, pos, headerDay) || !readSignedVarint(data, pos, firstTicketId)) {
+		cout << "录制文件头损坏: " << path << endl;
+		return false;
+	}
+	recordingDay = static_cast<int>(headerDay);
+	
+	long long timestamp = 0;
+	while (pos < data.size()) {
+		WorkloadEvent event;
+		event.op = static_cast<WorkloadOp>(data[pos++]);
+		unsigned long long delta, userId, count, sortKey, page, pageSize;
+		long long serviceDay;
+		bool ok = readVarint(data, pos, delta) && readVarint(data, pos, userId);
+		timestamp += static_cast<long long>(delta);
+		event.timestampMicros = timestamp;
+		event.userId = static_cast<int>(userId) - 1;
+		
+		switch (event.op) {
+			case WorkloadOp::Search:
+				ok = ok && readTraceString(data, pos, event.startStation) && readTraceString(data, pos, event.endStation) &&
+					 readTraceString(data, pos, event.departureTimeFilter) && readSignedVarint(data, pos, serviceDay) &&
+					 readVarint(data, pos, sortKey) && readVarint(data, pos, page) && readVarint(data, pos, pageSize);
+				event.serviceDay = static_cast<int>(serviceDay);
+				event.sortKey = static_cast<int>(sortKey);
+				event.page = static_cast<int>(page);
+				event.pageSize = static_cast<int>(pageSize);
+				break;
+			case WorkloadOp::Book:
+				ok = ok && readVarint(data, pos, count);
+				for (unsigned long long i = 0; ok && i < count; ++i) {
+					BookingLeg leg;
+					long long passengers;
+					unsigned long long seatClass;
+					ok = readTraceString(data, pos, leg.trainNumber) && readTraceString(data, pos, leg.startStation) &&
+						 readTraceString(data, pos, leg.endStation) && readSignedVarint(data, pos, serviceDay) &&
+						 readSignedVarint(data, pos, passengers) && readVarint(data, pos, seatClass);
+					leg.serviceDay = static_cast<int>(serviceDay);
+					leg.passengers = static_cast<int>(passengers);
+					leg.seatClass = static_cast<int>(seatClass);
+					event.legs.push_back(leg);
+				}
+				break;
+			case WorkloadOp::Refund:
+				ok = ok && readSignedVarint(data, pos, event.ticketId);
+				break;
+			case WorkloadOp::Recharge:
+				ok = ok && readSignedVarint(data, pos, event.amountCents);
+				break;
+			case WorkloadOp::Suspend:
+			case WorkloadOp::Resume:
+				ok = ok && readTraceString(data, pos, event.trainNumber);
+				break;
+			default:
+				ok = false;
+		}
+		
+		if (!ok) {
+			cout << "录制文件在第 " << events.size() + 1 << " 条记录处损坏" << endl;
+			return false;
+		}
+		events.push_back(std::move(event));
+	}
+	return true;
+}
+
+// 以下录制函数在未开启录制时直接返回
+
+void recordSearchEvent(string_view start, string_view end, string_view departureTimeFilter, int day,
+					   int sortKey, size_t page, size_t pageSize) {
+	if (!workloadRecording) return;
+	WorkloadEvent event;
+	event.op = WorkloadOp::Search;
+	event.startStation = string(start);
+	event.endStation = string(end);
+	event.departureTimeFilter = string(departureTimeFilter);
+	event.serviceDay = day;
+	event.sortKey = sortKey;
+	event.page = static_cast<int>(page);
+	event.pageSize = static_cast<int>(pageSize);
+	recordWorkloadEvent(event);
+}
+
+void recordBookEvent(int userId, const vector<BookingLeg>& legs) {
+	if (!workloadRecording) return;
+	WorkloadEvent event;
+	event.op = WorkloadOp::Book;
+	event.userId = userId;
+	event.legs = legs;
+	recordWorkloadEvent(event);
+}
+
+void recordRefundEvent(int userId, long long ticketId) {
+	if (!workloadRecording) return;
+	WorkloadEvent event;
+	event.op = WorkloadOp::Refund;
+	event.userId = userId;
+	event.ticketId = ticketId;
+	recordWorkloadEvent(event);
+}
+
+void recordRechargeEvent(int userId, double amount) {
+	if (!workloadRecording) return;
+	WorkloadEvent event;
+	event.op = WorkloadOp::Recharge;
+	event.userId = userId;
+	event.amountCents = llround(amount * 100);
+	recordWorkloadEvent(event);
+}
+
+void recordSuspendEvent(const string& trainNumber, bool suspended) {
+	if (!workloadRecording) return;
+	WorkloadEvent event;
+	event.op = suspended ? WorkloadOp::Suspend : WorkloadOp::Resume;
+	event.trainNumber = trainNumber;
+	recordWorkloadEvent(event);
+}
+
+// 根据车次、起终点下标、乘车日期和成交票价生成行程记录
+Trip makeTripRecord(const Train& train, size_t startIdx, size_t endIdx, int serviceDay, int price) {
+	Trip trip;
+	trip.trainNumber = train.trainNumber;
+	trip.startStation = train.stations[startIdx];
+	trip.endStation = train.stations[endIdx];
+	trip.departureTime = getDirectionalTime(train.arrivalTimes, startIdx, endIdx, startIdx);
+	trip.arrivalTime = getDirectionalTime(train.arrivalTimes, startIdx, endIdx, endIdx);
+	trip.price = price;
+	trip.travelDate = serviceDayToString(serviceDay);
+	return trip;
+}
+
+// 解析并校验所有行程段：车次、站点、乘车日期、停开状态和余票（同一运行日同一区间的需求汇总后比较）。
+// 成功时填充 resolved 并返回 true，失败时在 result.error 和 result.message 中给出原因。
+bool resolveBookingLegs(const vector<BookingLeg>& legs, vector<ResolvedBookingLeg>& resolved, BookingResult& result) {
+	if (legs.empty()) {
+		result.error = BookingError::InvalidRequest;
+		result.message = "购票请求为空!";
+		return false;
+	}
+	
+	resolved.clear();
+	resolved.reserve(legs.size());
+	map<tuple<size_t, int, size_t, size_t>, int> demand;
+	result.totalPrice = 0;
+	
+	for (const auto& leg : legs) {
+		if (leg.passengers <= 0) {
+			result.error = BookingError::InvalidRequest;
+			result.message = "购票张数必须大于0!";
+			return false;
+		}
+		if (leg.seatClass < 0 || leg.seatClass >= SEAT_CLASS_COUNT) {
+			result.error = BookingError::InvalidRequest;
+			result.message = "席别错误!";
+			return false;
+		}
+		if (!isInSalesWindow(leg.serviceDay)) {
+			result.error = BookingError::InvalidRequest;
+			result.message = "乘车日期不在预售期内!";
+			return false;
+		}
+		
+		int trainIdx = findTrainIndex(leg.trainNumber);
+		if (trainIdx < 0) {
+			result.error = BookingError::InvalidRequest;
+			result.message = "未找到车次 " + leg.trainNumber + "!";
+			return false;
+		}
+		if (suspendedBitmap[trainIdx]) {
+			result.error = BookingError::TrainSuspended;
+			result.message = "车次 " + leg.trainNumber + " 已停开!";
+			return false;
+		}
+		
+		const Train& train = trains[trainIdx];
+		int startIdx = findStationIndex(train, leg.startStation);
+		int endIdx = findStationIndex(train, leg.endStation);
+		if (startIdx < 0 || endIdx < 0 || startIdx == endIdx) {
+			result.error = BookingError::InvalidRequest;
+			result.message = "站点信息错误!";
+			return false;
+		}
+		
+		// 确保索引顺序正确（小的在前，大的在后）
+		size_t fromIdx = min(startIdx, endIdx);
+		size_t toIdx = max(startIdx, endIdx);
+		if (seatClassCapacity(train, leg.seatClass) == 0) {
+			result.error = BookingError::InvalidRequest;
+			result.message = "车次 " + leg.trainNumber + " 没有" + SEAT_CLASSES[leg.seatClass].name + "!";
+			return false;
+		}
+		
+		int unitPrice = dynamicFare(trainIdx, leg.serviceDay, fromIdx, toIdx);
+		if (unitPrice < 0) {
+			result.error = BookingError::InvalidRequest;
+			result.message = "车次 " + leg.trainNumber + " 数据错误!";
+			return false;
+		}
+		
+		int& needed = demand[make_tuple(static_cast<size_t>(trainIdx), leg.serviceDay, fromIdx, toIdx)];
+		needed += leg.passengers;
+		if (getAvailableSeats(trainIdx, leg.serviceDay, fromIdx, toIdx) < needed) {
+			result.error = BookingError::SoldOut;
+			result.message = "车次 " + leg.trainNumber + " 该区间已无余票或余票不足!";
+			return false;
+		}
+		
+		unitPrice = static_cast<int>(static_cast<long long>(unitPrice) * SEAT_CLASSES[leg.seatClass].fareFactor / 1000);
+		result.totalPrice += unitPrice * leg.passengers;
+		resolved.push_back({static_cast<size_t>(trainIdx), leg.serviceDay, static_cast<size_t>(startIdx), static_cast<size_t>(endIdx),
+							fromIdx, toIdx, leg.passengers, unitPrice, leg.seatClass, {}});
+	}
+	return true;
+}
+
+// ==================== 座位预留（带超时） ====================
+// 预留成功后立即从内存余票中扣除，其他用户查不到也买不到这些座位；
+// 预留在确认（支付）后转为正式车票，在释放或超时后把座位还回去。
+// 预留只存在于内存：持久化余票时会把未确认的预留加回去，进程退出时预留自然作废。
+
+const int DEFAULT_HOLD_TTL_SECONDS = 10 * 60; // 默认保留10分钟
+
+// 单层时间轮：每格1秒，超过一圈的定时用 rounds 记录剩余圈数。
+// 加入、取消、到期处理都是 O(1)。
+class HoldTimerWheel {
+public:
+	explicit HoldTimerWheel(size_t slotCount = 64) : slots(slotCount), cursor(0) {}
+	
+	struct Entry {
+		unsigned holdId;
+		unsigned rounds;
+	};
+	using Handle = pair<size_t, list<Entry>::iterator>;
+	
+	// 在 delaySeconds 秒后到期
+	Handle schedule(unsigned holdId, unsigned delaySeconds) {
+		if (delaySeconds == 0) delaySeconds = 1;
+		size_t slot = (cursor + delaySeconds) % slots.size();
+		unsigned rounds = static_cast<unsigned>((delaySeconds - 1) / slots.size());
+		slots[slot].push_front({holdId, rounds});
+		return {slot, slots[slot].begin()};
+	}
+	
+	void cancel(const Handle& handle) {
+		slots[handle.first].erase(handle.second);
+	}
+	
+	// 前进一格，返回本格中到期的预留
+	vector<unsigned> tick() {
+		vector<unsigned> expired;
+		cursor = (cursor + 1) % slots.size();
+		auto& slot = slots[cursor];
+		for (auto it = slot.begin(); it != slot.end();) {
+			if (it->rounds == 0) {
+				expired.push_back(it->holdId);
+				it = slot.erase(it);
+			} else {
+				it->rounds--;
+				++it;
+			}
+		}
+		return expired;
+	}
+	
+private:
+	vector<list<Entry>> slots;
+	size_t cursor;
+};
+
+// 一次座位预留
+struct SeatHold {
+	unsigned holdId;
+	int userId;
+	vector<ResolvedBookingLeg> legs;
+	vector<BookingLeg> request; // 原始购票请求，确认时用于负载录制
+	int totalPrice;
+	HoldTimerWheel::Handle timer;
+	vector<uint32_t> sharedRecords; // 共享余票时每个预留座位在共享内存中的记录编号
+};
+
+HoldTimerWheel holdWheel;
+unordered_map<unsigned, SeatHold> seatHolds;
+unsigned nextHoldId = 1;
+chrono::steady_clock::time_point lastHoldTick = chrono::steady_clock::now();
+
+// 共享余票：为预留的每个座位登记一条记录，进程崩溃后协调进程按记录归还座位（需持有写锁）
+void recordSharedHold(SeatHold& hold) {
+	for (const auto& leg : hold.legs) {
+		for (const auto& seat : leg.seats) {
+			hold.sharedRecords.push_back(sharedInventory->addHoldRecord(leg.trainIdx, leg.serviceDay, leg.fromIdx, leg.toIdx,
+																		seat.first, seat.second));
+		}
+	}
+}
+
+// 共享余票：释放预留的记录（需持有写锁）
+void releaseSharedHold(SeatHold& hold) {
+	for (uint32_t record : hold.sharedRecords) {
+		sharedInventory->removeHoldRecord(record);
+	}
+	hold.sharedRecords.clear();
+}
+
+// 共享余票：本进程停顿过久被视为崩溃时，协调进程已把预留的座位还回余票（需持有写锁）
+bool sharedHoldReclaimed(const SeatHold& hold) {
+	return sharedInventory && any_of(hold.sharedRecords.begin(), hold.sharedRecords.end(),
+									 [](uint32_t record) { return !sharedInventory->ownsHoldRecord(record); });
+}
+
+// 把预留的座位还回余票（已被协调进程回收的预留只更新本进程的预留数）
+void returnHeldSeats(SeatHold& hold) {
+	SharedInventoryLock sharedLock;
+	bool reclaimed = sharedHoldReclaimed(hold);
+	for (const auto& leg : hold.legs) {
+		adjustHeldSeats(leg.trainIdx, leg.serviceDay, leg.fromIdx, leg.toIdx, -leg.passengers);
+		if (reclaimed) {
+			continue;
+		}
+		adjustSeats(leg.trainIdx, leg.serviceDay, leg.fromIdx, leg.toIdx, leg.passengers);
+		for (const auto& seat : leg.seats) {
+			markSeat(leg.trainIdx, leg.serviceDay, seat.first, seat.second, leg.fromIdx, leg.toIdx, false);
+		}
+	}
+	if (sharedInventory) {
+		releaseSharedHold(hold);
+	}
+}
+
+// 预留座位：校验通过后从余票中扣除，ttlSeconds 秒内未确认则自动释放。
+// 成功返回预留编号，失败返回0并在 result.error 和 result.message 中给出原因。
+unsigned placeSeatHold(const User& user, const vector<BookingLeg>& legs, BookingResult& result, int ttlSeconds = DEFAULT_HOLD_TTL_SECONDS) {
+	SharedInventoryLock sharedLock; // 先拉取其他进程售出的座位，再校验余票
+	SeatHold hold;
+	if (!resolveBookingLegs(legs, hold.legs, result)) {
+		recordBookEvent(user.id, legs);
+		return 0;
+	}
+	hold.request = legs;
+	size_t seatCount = 0;
+	for (const auto& leg : hold.legs) {
+		seatCount += leg.passengers;
+	}
+	if (sharedInventory && !sharedInventory->hasHoldRecords(seatCount)) {
+		result.error = BookingError::TooManyHolds;
+		result.message = "同时预留的座位过多，请稍后再试!";
+		recordBookEvent(user.id, legs);
+		return 0;
+	}
+	
+	// 为每位乘客分配具体座位，该席别空座不足时撤销已分配的座位
+	for (auto& leg : hold.legs) {
+		for (int p = 0; p < leg.passengers; ++p) {
+			int carNumber, seatNumber;
+			if (!assignSeat(leg.trainIdx, leg.serviceDay, leg.seatClass, leg.fromIdx, leg.toIdx, carNumber, seatNumber)) {
+				for (const auto& assigned : hold.legs) {
+					for (const auto& seat : assigned.seats) {
+						markSeat(assigned.trainIdx, assigned.serviceDay, seat.first, seat.second, assigned.fromIdx, assigned.toIdx, false);
+					}
+				}
+				result.error = BookingError::SoldOut;
+				result.message = "车次 " + trains[leg.trainIdx].trainNumber + " " + SEAT_CLASSES[leg.seatClass].name + "已无空座!";
+				recordBookEvent(user.id, legs);
+				return 0;
+			}
+			leg.seats.push_back({carNumber, seatNumber});
+		}
+	}
+	
+	hold.holdId = nextHoldId++;
+	hold.userId = user.id;
+	hold.totalPrice = result.totalPrice;
+	for (const auto& leg : hold.legs) {
+		adjustSeats(leg.trainIdx, leg.serviceDay, leg.fromIdx, leg.toIdx, -leg.passengers);
+		adjustHeldSeats(leg.trainIdx, leg.serviceDay, leg.fromIdx, leg.toIdx, leg.passengers);
+	}
+	if (sharedInventory) {
+		recordSharedHold(hold);
+	}
+	hold.timer = holdWheel.schedule(hold.holdId, static_cast<unsigned>(max(ttlSeconds, 1)));
+	
+	unsigned holdId = hold.holdId;
+	seatHolds.emplace(holdId, std::move(hold));
+	return holdId;
+}
+
+// 释放预留（用户取消支付），座位立即还回余票
+bool releaseSeatHold(unsigned holdId) {
+	auto it = seatHolds.find(holdId);
+	if (it == seatHolds.end()) {
+		return false;
+	}
+	holdWheel.cancel(it->second.timer);
+	returnHeldSeats(it->second);
+	seatHolds.erase(it);
+	return true;
+}
+
+// 推进预留时间轮（由定时器每秒调用），按实际流逝的秒数逐格处理到期预留
+void advanceSeatHolds() {
+	auto now = chrono::steady_clock::now();
+	long long elapsed = chrono::duration_cast<chrono::seconds>(now - lastHoldTick).count();
+	for (long long i = 0; i < elapsed; ++i) {
+		for (unsigned holdId : holdWheel.tick()) {
+			auto it = seatHolds.find(holdId);
+			if (it != seatHolds.end()) {
+				cout << "座位预留 " << holdId << " 已超时释放" << endl;
+				returnHeldSeats(it->second);
+				seatHolds.erase(it);
+			}
+		}
+	}
+	lastHoldTick += chrono::seconds(elapsed);
+}
+
+// 确认预留（支付）：一次扣款，并在一个数据库事务中写入余额、行程和余票。
+// 余额不足时预留保持不变，用户充值后可再次确认。
+BookingResult confirmSeatHold(User& user, unsigned holdId) {
+	BookingResult result;
+	SharedInventoryLock sharedLock;
+	auto it = seatHolds.find(holdId);
+	if (it == seatHolds.end()) {
+		result.error = BookingError::HoldNotFound;
+		result.message = "座位预留不存在或已超时，请重新购票!";
+		return result;
+	}
+	SeatHold& hold = it->second;
+	if (hold.userId != user.id) {
+		result.error = BookingError::HoldNotOwned;
+		result.message = "座位预留不属于当前用户!";
+		return result;
+	}
+	if (sharedHoldReclaimed(hold)) {
+		// 座位已被协调进程还回余票，可能已售给其他进程的用户
+		holdWheel.cancel(hold.timer);
+		returnHeldSeats(hold);
+		seatHolds.erase(it);
+		result.error = BookingError::HoldNotFound;
+		result.message = "座位预留不存在或已超时，请重新购票!";
+		return result;
+	}
+	// 用户放弃支付的预留不录制；录制的购票在回放时按“预留 + 确认”一次执行
+	recordBookEvent(user.id, hold.request);
+	
+	result.totalPrice = hold.totalPrice;
+	if (user.balance < hold.totalPrice) {
+		result.error = BookingError::InsufficientBalance;
+		result.message = "余额不足";
+		return result;
+	}
+	
+	// 座位已在预留时扣除，这里转为正式占用：不再计入预留。
+	// 共享余票的预留记录在落盘前释放：之后即使进程崩溃，座位也只会空置而不会被重复售出
+	double oldBalance = user.balance;
+	size_t oldTripCount = user.trips.size();
+	set<pair<size_t, int>> touchedInventory; // 涉及的 (车次下标, 运行日)
+	user.balance -= hold.totalPrice;
+	for (const auto& leg : hold.legs) {
+		for (const auto& seat : leg.seats) {
+			Trip trip = makeTripRecord(trains[leg.trainIdx], leg.startIdx, leg.endIdx, leg.serviceDay, leg.unitPrice);
+			trip.seatClass = leg.seatClass;
+			trip.carNumber = seat.first;
+			trip.seatNumber = seat.second;
+			trip.ticketId = allocateTicketId();
+			addTrip(user, trip);
+		}
+		adjustHeldSeats(leg.trainIdx, leg.serviceDay, leg.fromIdx, leg.toIdx, -leg.passengers);
+		touchedInventory.insert({leg.trainIdx, leg.serviceDay});
+	}
+	if (sharedInventory) {
+		releaseSharedHold(hold);
+	}
+	// 共享内存已更新完毕，写数据库期间不占用共享余票锁，其他进程可以继续售票
+	sharedLock.release();
+	
+	// 在一个事务中持久化：余额更新一次，行程逐条插入，每个涉及的车次运行日更新一次。
+	// 分片模式下行程和余票先在各分片并行提交，全部成功后才开启主库事务写余额，等待分片时不占用主库
+	ShardBatch shardBatch;
+	auto writeTripsAndSeats = [&]() {
+		for (size_t i = oldTripCount; i < user.trips.size(); ++i) {
+			if (!insertTripToDB(user.id, user.trips[i], &shardBatch)) {
+				return false;
+			}
+		}
+		for (const auto& inventory : touchedInventory) {
+			if (!saveDatedSeatsToDB(inventory.first, inventory.second, &shardBatch)) {
+				return false;
+			}
+		}
+		return true;
+	};
+	bool ok = shardCount == 0 || (writeTripsAndSeats() && shardBatch.commit());
+	ok = ok && db.transaction();
+	ok = ok && updateUserBalanceInDB(user);
+	ok = ok && (shardCount > 0 || writeTripsAndSeats());
+	ok = ok && db.commit();
+	
+	if (!ok) {
+		// 持久化失败：撤销分片上的写入，回滚数据库和内存中的修改，座位仍保持预留状态
+		cout << "购票事务失败: " << db.lastError().text().toStdString() << endl;
+		db.rollback();
+		shardBatch.revert();
+		user.balance = oldBalance;
+		while (user.trips.size() > oldTripCount) {
+			removeTripAt(user, user.trips.size() - 1);
+		}
+		SharedInventoryLock rollbackLock;
+		for (const auto& leg : hold.legs) {
+			adjustHeldSeats(leg.trainIdx, leg.serviceDay, leg.fromIdx, leg.toIdx, leg.passengers);
+		}
+		if (sharedInventory) {
+			recordSharedHold(hold);
+		}
+		// 分片上的余票行可能已经提交，按回滚后的内存重新保存
+		if (shardCount > 0) {
+			for (const auto& inventory : touchedInventory) {
+				saveDatedSeatsToDB(inventory.first, inventory.second);
+			}
+		}
+		result.error = BookingError::StorageFailed;
+		result.message = "保存购票数据失败!";
+		return result;
+	}
+	
+	for (size_t i = oldTripCount; i < user.trips.size(); ++i) {
+		const Trip& trip = user.trips[i];
+		result.seats.push_back(trip.trainNumber + " " + seatLabel(trip.seatClass, trip.carNumber, trip.seatNumber));
+		result.ticketIds.push_back(trip.ticketId);
+		emitTripChanged(ChangeKind::TripAdded, user.id, i);
+	}
+	holdWheel.cancel(hold.timer);
+	seatHolds.erase(it);
+	result.success = true;
+	return result;
+}
+
+// 批量购票：多名乘客或多段行程一次完成，全部成功或全部失败。
+// 相当于预留后立即确认；确认失败时释放预留。
+BookingResult bookTickets(User& user, const vector<BookingLeg>& legs) {
+	BookingResult result;
+	unsigned holdId = placeSeatHold(user, legs, result);
+	if (holdId == 0) {
+		return result;
+	}
+	
+	result = confirmSeatHold(user, holdId);
+	if (!result.success) {
+		releaseSeatHold(holdId);
+	}
+	return result;
+}
+
+// 查票结果（单行）：只保存车次下标和站点下标，显示时再从 trains 中取字符串
+struct TicketResult {
+	unsigned trainIdx;
+	unsigned short startIdx;
+	unsigned short endIdx;
+	int departureMinutes;
+	int arrivalMinutes;
+	int travelMinutes;
+	int availableSeats;
+	int price;
+};
+
+// 查票结果排序方式
+enum class TicketSortKey {
+	Price,         // 票价从低到高
+	DepartureTime, // 出发时间从早到晚
+	ArrivalTime,   // 到达时间从早到晚
+	TravelTime,    // 历时从短到长
+	Seats          // 余票从多到少
+};
+
+// 一页查票结果：rows 从调用者给的内存池分配（默认为堆）
+struct TicketPage {
+	explicit TicketPage(pmr::memory_resource* resource = pmr::get_default_resource()) : rows(resource) {}
+	
+	pmr::vector<TicketResult> rows;
+	size_t totalCount = 0; // 符合条件的结果总数
+};
+
+const size_t TICKET_PAGE_SIZE = 20;
+
+// 查票缓存条目：结果 + 计算时所有候选车次（同时经过起终点的车次）的版本号
+struct SearchCacheEntry {
+	string key;
+	vector<TicketResult> results; // 未排序的全部结果，排序与分页在取页时进行
+	vector<pair<size_t, unsigned>> candidateVersions; // (车次下标, 当时的版本号)
+	unsigned epoch;
+};
+
+// 查票结果 LRU 缓存：链表头部为最近使用，哈希表按键定位链表节点。
+// 哈希表的键是指向链表节点中 key 的 string_view（节点不会移动），查找时不需要构造 std::string
+const size_t SEARCH_CACHE_CAPACITY = 256;
+list<SearchCacheEntry> searchCacheList;
+unordered_map<string_view, list<SearchCacheEntry>::iterator> searchCacheIndex;
+
+// ==================== 查票内存池 ====================
+// 一次查票的临时数据（缓存键、结果、候选车次版本、排序缓冲区）都从该次查票的内存池分配：
+// 每个线程一块固定大小的缓冲区，查票时在上面建一个只向前分配的 monotonic_buffer_resource，
+// 查完整体丢弃。缓冲区用完才向堆申请，因此稳态下查票不申请堆内存，多个线程同时查票也不会争用堆分配器。
+// 只有缓存未命中时，放入缓存的结果副本需要申请一次内存。
+const size_t SEARCH_ARENA_BYTES = 512 * 1024;
+
+class SearchArena {
+public:
+	SearchArena() {
+		thread_local vector<char> buffer(SEARCH_ARENA_BYTES);
+		thread_local bool bufferInUse = false;
+		// 同一线程上嵌套使用时，内层不复用缓冲区，直接向堆申请
+		if (!bufferInUse) {
+			bufferInUse = true;
+			inUse = &bufferInUse;
+			resource.emplace(buffer.data(), buffer.size());
+		} else {
+			resource.emplace();
+		}
+	}
+	~SearchArena() {
+		resource.reset();
+		if (inUse) {
+			*inUse = false;
+		}
+	}
+	SearchArena(const SearchArena&) = delete;
+	SearchArena& operator=(const SearchArena&) = delete;
+	
+	pmr::memory_resource* get() { return &*resource; }
+	
+private:
+	optional<pmr::monotonic_buffer_resource> resource;
+	bool* inUse = nullptr;
+};
+
+// 生成缓存键：起点、终点、出发时间过滤条件、乘车日期（写在内存池中）
+pmr::string makeSearchCacheKey(string_view start, string_view end, string_view departureTimeFilter, int day,
+							   pmr::memory_resource* resource) {
+	char dayDigits[16];
+	char* dayEnd = to_chars(dayDigits, dayDigits + sizeof(dayDigits), day).ptr;
+	
+	pmr::string key(resource);
+	key.reserve(start.size() + end.size() + departureTimeFilter.size() + 3 + (dayEnd - dayDigits));
+	key.append(start).append(1, '\x1f').append(end).append(1, '\x1f').append(departureTimeFilter).append(1, '\x1f');
+	key.append(dayDigits, dayEnd);
+	return key;
+}
+
+// 计算结果放入缓存时的副本（缓存条目比单次查票活得久，从堆上按实际大小分配）
+SearchCacheEntry makeSearchCacheEntry(string_view key, unsigned epoch, const pmr::vector<TicketResult>& results,
+									  const pmr::vector<pair<size_t, unsigned>>& candidateVersions) {
+	SearchCacheEntry entry;
+	entry.key.assign(key.data(), key.size());
+	entry.results.assign(results.begin(), results.end());
+	entry.candidateVersions.assign(candidateVersions.begin(), candidateVersions.end());
+	entry.epoch = epoch;
+	return entry;
+}
+
+// 查票读取的库存视图：实时数据。无界面服务的工作线程改用同样接口的库存快照（见 InventorySnapshot），
+// 查票和缓存校验按视图模板化，两者共用同一套代码
+struct LiveInventory {
+	unsigned epoch() const { return fleetEpoch; }
+	int serviceDay() const { return currentServiceDay; }
+	size_t trainCount() const { return trainVersions.size(); }
+	unsigned version(size_t trainIdx) const { return trainVersions[trainIdx]; }
+	bool suspended(size_t trainIdx) const { return suspendedBitmap[trainIdx]; }
+	const vector<ServiceDaySeats>& slots(size_t trainIdx) const { return datedInventory[trainIdx]; }
+	const TrainColumns& columns() const { return *trainColumns; }
+};
+
+// 检查缓存条目是否仍然有效：任一候选车次版本变化或列车数据重新加载都视为失效
+template <typename Inventory>
+bool isSearchCacheEntryValid(const SearchCacheEntry& entry, const Inventory& inventory) {
+	if (entry.epoch != inventory.epoch()) {
+		return false;
+	}
+	for (const auto& cv : entry.candidateVersions) {
+		if (cv.first >= inventory.trainCount() || inventory.version(cv.first) != cv.second) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// 实际执行查票：在列存表上找出同时经过起终点的车次，记录候选车次的版本号，未排序的结果追加到 results。
+// 两个输出数组由调用者从查票内存池分配，整个过程不复制字符串，也不访问 trains 中的嵌套数组
+template <typename Inventory>
+void computeTicketResults(const Inventory& inventory, string_view start, string_view end,
+						  string_view departureTimeFilter, int day,
+						  pmr::vector<TicketResult>& results, pmr::vector<pair<size_t, unsigned>>& candidateVersions) {
+	int filterTime = departureTimeFilter.empty() ? -1 : timeToMinutes(departureTimeFilter);
+	const TrainColumns& columns = inventory.columns();
+	int today = inventory.serviceDay();
+	
+	forEachTrainServing(columns, columns.stationId(start), columns.stationId(end),
+						[&](size_t trainIdx, size_t startIdx, size_t endIdx, auto stopCount) {
+		// 同时经过起终点的车次都是候选：即使当前停开或无票，其状态变化也会影响结果
+		candidateVersions.push_back({trainIdx, inventory.version(trainIdx)});
+		
+		// 检查列车是否被停开（按下标查位图）
+		if (inventory.suspended(trainIdx)) {
+			return;
+		}
+		
+		// 确保索引顺序正确（小的在前，大的在后）
+		size_t fromIdx = min(startIdx, endIdx);
+		size_t toIdx = max(startIdx, endIdx);
+		size_t triangle = triangleCell(stopCount.value(), fromIdx, toIdx);
+		size_t cell = columns.matrixOffsets[trainIdx] + triangle;
+		
+		int baseFare = columns.baseFares[cell];
+		if (baseFare < 0) {
+			return;
+		}
+		
+		const ServiceDaySeats& slot = inventory.slots(trainIdx)[day % SALES_WINDOW_DAYS];
+		bool sold = slot.day == day;
+		int fare = applyPriceFactors(baseFare, sold ? slot.loadPercent[triangle] : 0, day - today);
+		
+		// 正向行程用正向时刻表，反向行程用反向时刻表
+		const vector<short>& minutes = startIdx < endIdx ? columns.forwardMinutes : columns.backwardMinutes;
+		size_t stopBase = columns.stopOffsets[trainIdx];
+		int departureMinutes = minutes[stopBase + startIdx];
+		int arrivalMinutes = minutes[stopBase + endIdx];
+		
+		// 如果列车出发时间早于用户指定的时间，跳过此车次
+		if (filterTime >= 0 && departureMinutes < filterTime) {
+			return;
+		}
+		
+		// 到达时间早于出发时间说明跨天
+		int travelMinutes = arrivalMinutes - departureMinutes;
+		if (travelMinutes < 0) {
+			travelMinutes += 24 * 60;
+		}
+		
+		results.push_back({
+			static_cast<unsigned>(trainIdx),
+			static_cast<unsigned short>(startIdx),
+			static_cast<unsigned short>(endIdx),
+			departureMinutes,
+			arrivalMinutes,
+			travelMinutes,
+			sold ? slot.seats[triangle] : columns.templateSeats[cell],
+			fare
+		});
+	});
+}
+
+// 在缓存中查找：命中且有效时移到链表头部并返回条目，已失效的条目直接移除
+template <typename Inventory>
+SearchCacheEntry* findSearchCacheEntry(string_view key, const Inventory& inventory) {
+	auto indexIt = searchCacheIndex.find(key);
+	if (indexIt == searchCacheIndex.end()) {
+		return nullptr;
+	}
+	auto entryIt = indexIt->second;
+	if (!isSearchCacheEntryValid(*entryIt, inventory)) {
+		searchCacheList.erase(entryIt);
+		searchCacheIndex.erase(indexIt);
+		return nullptr;
+	}
+	searchCacheList.splice(searchCacheList.begin(), searchCacheList, entryIt);
+	return &*entryIt;
+}
+
+// 放入缓存（同键旧条目被替换），超出容量时淘汰最久未使用的条目
+SearchCacheEntry& storeSearchCacheEntry(SearchCacheEntry&& entry) {
+	auto indexIt = searchCacheIndex.find(entry.key);
+	if (indexIt != searchCacheIndex.end()) {
+		searchCacheList.erase(indexIt->second);
+		searchCacheIndex.erase(indexIt);
+	}
+	
+	searchCacheList.push_front(std::move(entry));
+	searchCacheIndex[searchCacheList.front().key] = searchCacheList.begin();
+	
+	if (searchCacheList.size() > SEARCH_CACHE_CAPACITY) {
+		searchCacheIndex.erase(searchCacheList.back().key);
+		searchCacheList.pop_back();
+	}
+	
+	return searchCacheList.front();
+}
+
+// 查票（带缓存）：命中且未失效时直接返回缓存结果，否则重新计算并放入缓存
+const vector<TicketResult>& searchTickets(const string& start, const string& end, const string& departureTimeFilter, int day) {
+	SearchArena arena;
+	pmr::string key = makeSearchCacheKey(start, end, departureTimeFilter, day, arena.get());
+	LiveInventory inventory;
+	
+	if (SearchCacheEntry* cached = findSearchCacheEntry(key, inventory)) {
+		return cached->results;
+	}
+	
+	pmr::vector<TicketResult> results(arena.get());
+	pmr::vector<pair<size_t, unsigned>> candidateVersions(arena.get());
+	computeTicketResults(inventory, start, end, departureTimeFilter, day, results, candidateVersions);
+	return storeSearchCacheEntry(makeSearchCacheEntry(key, fleetEpoch, results, candidateVersions)).results;
+}
+
+// 多关键字比较：先按选定的主关键字，相同时依次按票价、出发时间、车次下标，保证顺序稳定
+bool ticketResultLess(const TicketResult& a, const TicketResult& b, TicketSortKey key) {
+	switch (key) {
+		case TicketSortKey::Price:
+			if (a.price != b.price) return a.price < b.price;
+			break;
+		case TicketSortKey::DepartureTime:
+			if (a.departureMinutes != b.departureMinutes) return a.departureMinutes < b.departureMinutes;
+			break;
+		case TicketSortKey::ArrivalTime:
+			if (a.arrivalMinutes != b.arrivalMinutes) return a.arrivalMinutes < b.arrivalMinutes;
+			break;
+		case TicketSortKey::TravelTime:
+			if (a.travelMinutes != b.travelMinutes) return a.travelMinutes < b.travelMinutes;
+			break;
+		case TicketSortKey::Seats:
+			if (a.availableSeats != b.availableSeats) return a.availableSeats > b.availableSeats;
+			break;
+	}
+	if (a.price != b.price) return a.price < b.price;
+	if (a.departureMinutes != b.departureMinutes) return a.departureMinutes < b.departureMinutes;
+	return a.trainIdx < b.trainIdx;
+}
+
+// 从未排序的结果中取一页：用 partial_sort_copy 只把排在前面的 (page + 1) * pageSize 条排序复制到缓冲区，
+// 不复制、不排序全部结果。排序缓冲区和返回的行都从 resource 分配
+TicketPage pageTicketResults(const TicketResult* all, size_t count, TicketSortKey sortKey, size_t page, size_t pageSize,
+							 pmr::memory_resource* resource = pmr::get_default_resource()) {
+	TicketPage result(resource);
+	result.totalCount = count;
+	
+	size_t first = page * pageSize;
+	if (pageSize == 0 || first >= count) {
+		return result;
+	}
+	size_t last = min(count, first + pageSize);
+	
+	pmr::vector<TicketResult> ordered(last, resource);
+	auto cmp = [sortKey](const TicketResult& a, const TicketResult& b) { return ticketResultLess(a, b, sortKey); };
+	partial_sort_copy(all, all + count, ordered.begin(), ordered.end(), cmp);
+	
+	result.rows.assign(ordered.begin() + first, ordered.begin() + last);
+	return result;
+}
+
+// 取一页查票结果（带缓存）
+TicketPage searchTicketPage(const string& start, const string& end, const string& departureTimeFilter, int day,
+							TicketSortKey sortKey, size_t page, size_t pageSize) {
+	recordSearchEvent(start, end, departureTimeFilter, day, static_cast<int>(sortKey), page, pageSize);
+	const vector<TicketResult>& all = searchTickets(start, end, departureTimeFilter, day);
+	return pageTicketResults(all.data(), all.size(), sortKey, page, pageSize);
+}
+
+// 退票结果
+struct RefundResult {
+	bool success = false;
+	string message;
+	int originalPrice = 0;
+	int refundAmount = 0;
+};
+
+// 退票：按车票编号找到车票，退还80%票价，预售期内的运行日恢复余票，数据库中只删除这一行
+RefundResult refundTicket(User& user, long long ticketId) {
+	RefundResult result;
+	recordRefundEvent(user.id, ticketId);
+	auto indexIt = user.tripIndex.find(ticketId);
+	if (indexIt == user.tripIndex.end()) {
+		result.message = "未找到该车票!";
+		return result;
+	}
+	size_t tripIndex = indexIt->second;
+	const Trip& trip = user.trips[tripIndex];
+	
+	result.originalPrice = trip.price;
+	result.refundAmount = static_cast<int>(result.originalPrice * 0.8); // 80%退款
+	
+	// 恢复对应运行日的余票（已发车或超出预售期的运行日不再恢复）。
+	// 共享余票时先落盘再归还座位：归还的座位可能立即被其他进程售出，落盘失败后无法收回；
+	// 落盘期间也就不必占用共享余票锁
+	int day = parseServiceDay(trip.travelDate);
+	int trainIdx = findTrainIndex(trip.trainNumber);
+	bool restoreSeats = false;
+	size_t fromIdx = 0, toIdx = 0;
+	if (trainIdx >= 0 && isInSalesWindow(day)) {
+		const Train& train = trains[trainIdx];
+		int startIdx = findStationIndex(train, trip.startStation);
+		int endIdx = findStationIndex(train, trip.endStation);
+		if (startIdx >= 0 && endIdx >= 0) {
+			restoreSeats = true;
+			fromIdx = min(startIdx, endIdx);
+			toIdx = max(startIdx, endIdx);
+		}
+	}
+	auto restoreSeat = [&](int delta) {
+		adjustSeats(trainIdx, day, fromIdx, toIdx, delta);
+		markSeat(trainIdx, day, trip.carNumber, trip.seatNumber, fromIdx, toIdx, delta < 0);
+	};
+	if (restoreSeats && !sharedInventory) {
+		restoreSeat(1);
+	}
+	
+	// 在一个事务中持久化：余额更新一次，车票按编号删除一行，余票更新一次。
+	// 分片模式下车票和余票先在各分片并行提交，全部成功后才开启主库事务写余额
+	ShardBatch shardBatch;
+	double oldBalance = user.balance;
+	user.balance += result.refundAmount;
+	auto writeTripAndSeats = [&]() {
+		return deleteTripFromDB(user.id, trip, &shardBatch) && (!restoreSeats || saveDatedSeatsToDB(trainIdx, day, &shardBatch));
+	};
+	bool ok = shardCount == 0 || (writeTripAndSeats() && shardBatch.commit());
+	ok = ok && db.transaction();
+	ok = ok && updateUserBalanceInDB(user);
+	ok = ok && (shardCount > 0 || writeTripAndSeats());
+	ok = ok && db.commit();
+	
+	if (!ok) {
+		// 持久化失败：撤销分片上的写入，回滚数据库和内存中的修改，车票仍然有效
+		cout << "退票事务失败: " << db.lastError().text().toStdString() << endl;
+		db.rollback();
+		shardBatch.revert();
+		user.balance = oldBalance;
+		if (restoreSeats && !sharedInventory) {
+			restoreSeat(-1);
+			if (shardCount > 0) {
+				saveDatedSeatsToDB(trainIdx, day);
+			}
+		}
+		result.message = "保存退票数据失败!";
+		return result;
+	}
+	
+	if (restoreSeats && sharedInventory) {
+		SharedInventoryLock sharedLock;
+		restoreSeat(1);
+	}
+	removeTripAt(user, tripIndex);
+	emitTripChanged(ChangeKind::TripRemoved, user.id, tripIndex);
+	
+	result.success = true;
+	result.message = "退票成功";
+	return result;
+}
+
+// 退票：按车次和乘车日期退第一张匹配的车票（旧版接口使用）
+RefundResult refundTicket(User& user, const string& trainNumber, const string& travelDate) {
+	auto tripIt = find_if(user.trips.begin(), user.trips.end(),
+		[&](const Trip& t) { return t.trainNumber == trainNumber && t.travelDate == travelDate; });
+	if (tripIt == user.trips.end()) {
+		recordRefundEvent(user.id, 0);
+		RefundResult result;
+		result.message = "未找到该车票!";
+		return result;
+	}
+	return refundTicket(user, tripIt->ticketId);
+}
+
+// 充值：单次金额需大于0且不超过10000元，成功后只更新该用户的余额
+bool rechargeBalance(User& user, double amount, string& message) {
+	recordRechargeEvent(user.id, amount);
+	if (amount <= 0) {
+		message = "请输入有效的充值金额!";
+		return false;
+	}
+	if (amount > 10000) {
+		message = "单次充值金额不能超过¥10000!";
+		return false;
+	}
+	
+	user.balance += amount;
+	if (!updateUserBalanceInDB(user)) {
+		user.balance -= amount;
+		message = "保存余额失败!";
+		return false;
+	}
+	emitBalanceChanged(user.id);
+	message = "充值成功";
+	return true;
+}
+
+#ifndef RAILWAY_HEADLESS
+// ==================== 窗口会话 ====================
+// 每个售票窗口是一个会话：登录的用户或管理员、查询条件和界面控件都属于会话；
+// 列车、余票、用户等数据和购票逻辑在进程内只有一份，由所有窗口共享
+struct Session {
+	int id = 0;
+	User* user = nullptr;
+	Admin* admin = nullptr;
+	
+	// 当前查询条件
+	string startStation;
+	string endStation;
+	string departureTimeFilter;
+	int travelDay = 0; // 查询的乘车日期（儒略日）
+	TicketSortKey sortKey = TicketSortKey::Price;
+	size_t page = 0;
+	vector<TicketResult> ticketTableRows; // 查票表当前显示的行（与表格行一一对应），变更事件按它定位需要更新的单元格
+	
+	// 界面控件（由窗口拥有，窗口关闭时一起销毁）
+	QMainWindow* window = nullptr;
+	QStackedWidget* stackedWidget = nullptr;
+	QWidget* startMenuWidget = nullptr;
+	QWidget* loginWidget = nullptr;
+	QWidget* registerWidget = nullptr;
+	QWidget* adminLoginWidget = nullptr;
+	QWidget* adminRegisterWidget = nullptr;
+	QWidget* mainMenuWidget = nullptr;
+	QWidget* adminMenuWidget = nullptr;
+	QTableWidget* ticketTable = nullptr;
+	QTableWidget* myTripsTable = nullptr;
+	QTableWidget* adminTrainTable = nullptr;
+	QLabel* ticketPageLabel = nullptr;
+	QLabel* balanceLabel = nullptr;
+	QLabel* passengerInfoLabel = nullptr;
+	QLabel* tripsPassengerNameLabel = nullptr;
+	QLabel* tripsPassengerPhoneLabel = nullptr;
+	QLineEdit* rechargeAmountEdit = nullptr;
+	QComboBox* dateCombo = nullptr;
+};
+
+// 会话管理：按编号保存所有打开的窗口会话，会话对象的地址在关闭前保持不变（界面回调按引用捕获）
+class SessionManager {
+public:
+	Session& open() {
+		auto session = make_unique<Session>();
+		session->id = nextId++;
+		Session& opened = *session;
+		sessions[opened.id] = std::move(session);
+		return opened;
+	}
+	
+	void close(int id) {
+		sessions.erase(id);
+	}
+	
+	template <typename Visit>
+	void forEach(Visit visit) {
+		for (auto& entry : sessions) {
+			visit(*entry.second);
+		}
+	}
+	
+private:
+	map<int, unique_ptr<Session>> sessions;
+	int nextId = 1;
+};
+
+SessionManager sessionManager;
+
+Session& openSessionWindow();
+
+// 更新余额显示
+void updateBalanceDisplay(Session& session) {
+	if (session.user && session.balanceLabel) {
+		session.balanceLabel->setText(QString("当前余额: ¥%1").arg(QString::number(session.user->balance, 'f', 2)));
+	}
+	
+	// 更新乘车人信息显示
+	if (session.user) {
+		QString passengerInfo = QString("乘车人：%1 (手机号：%2)")
+			.arg(QString::fromStdString(session.user->name))
+			.arg(QString::fromStdString(session.user->phoneNumber));
+		
+		if (session.passengerInfoLabel) {
+			session.passengerInfoLabel->setText(passengerInfo);
+		}
+		
+		// 更新我的行程页面的乘车人信息
+		if (session.tripsPassengerNameLabel) {
+			session.tripsPassengerNameLabel->setText(QString("乘车人：%1").arg(QString::fromStdString(session.user->name)));
+		}
+		
+		if (session.tripsPassengerPhoneLabel) {
+			session.tripsPassengerPhoneLabel->setText(QString("手机号：%1").arg(QString::fromStdString(session.user->phoneNumber)));
+		}
+	}
+}
+
+// 填写行程表的一行
+void setTripRow(Session& session, int row, const Trip& trip) {
+	QStringList values = {
+		QString::fromStdString(trip.trainNumber),
+		QString::fromStdString(trip.travelDate),
+		QString::fromStdString(trip.startStation),
+		QString::fromStdString(trip.endStation),
+		QString::fromStdString(trip.departureTime),
+		QString::fromStdString(trip.arrivalTime),
+		QString::number(trip.price),
+		QString::fromStdString(seatLabel(trip.seatClass, trip.carNumber, trip.seatNumber))
+	};
+	for (int col = 0; col < values.size(); ++col) {
+		QTableWidgetItem* cell = new QTableWidgetItem(values[col]);
+		cell->setTextAlignment(Qt::AlignCenter);
+		session.myTripsTable->setItem(row, col, cell);
+	}
+}
+
+// 更新个人行程表（切换用户时整表重建；购票、退票通过变更事件逐行更新）
+void updateMyTripsTable(Session& session) {
+	session.myTripsTable->setRowCount(0);
+	
+	if (!session.user) return;
+	
+	int row = 0;
+	for (const auto& trip : session.user->trips) {
+		session.myTripsTable->insertRow(row);
+		setTripRow(session, row, trip);
+		row++;
 	}
 }
 
 // 创建开始菜单界面
-QWidget* createStartMenuWidget(QMainWindow* mainWindow) {
+QWidget* createStartMenuWidget(Session& session) {
 	QWidget* widget = new QWidget();
 	QVBoxLayout* layout = new QVBoxLayout(widget);
 	layout->setSpacing(30);
@@ -915,20 +4753,31 @@ QWidget* createStartMenuWidget(QMainWindow* mainWindow) {
 						   "QPushButton:hover { background-color: #c0392b; }");
 	layout->addWidget(adminBtn);
 	
+	// 新窗口按钮：同一进程中再开一个独立登录的售票窗口
+	QPushButton* newWindowBtn = new QPushButton("新建窗口");
+	newWindowBtn->setStyleSheet("QPushButton { background-color: #95a5a6; color: white; border: none; padding: 15px; font-size: 16px; border-radius: 5px; }"
+							   "QPushButton:hover { background-color: #7f8c8d; }");
+	layout->addWidget(newWindowBtn);
+	
 	// 按钮事件
-	QObject::connect(userBtn, &QPushButton::clicked, [mainWindow]() {
-		stackedWidget->setCurrentWidget(loginWidget);
+	QObject::connect(userBtn, &QPushButton::clicked, [&session]() {
+		session.stackedWidget->setCurrentWidget(session.loginWidget);
+	});
+	
+	QObject::connect(adminBtn, &QPushButton::clicked, [&session]() {
+		session.stackedWidget->setCurrentWidget(session.adminLoginWidget);
 	});
 	
-	QObject::connect(adminBtn, &QPushButton::clicked, [mainWindow]() {
-		stackedWidget->setCurrentWidget(adminLoginWidget);
+	QObject::connect(newWindowBtn, &QPushButton::clicked, []() {
+		openSessionWindow();
 	});
 	
 	return widget;
 }
 
 // 创建登录界面
-QWidget* createLoginWidget(QMainWindow* mainWindow) {
+QWidget* createLoginWidget(Session& session) {
+	QMainWindow* mainWindow = session.window;
 	QWidget* widget = new QWidget();
 	QVBoxLayout* layout = new QVBoxLayout(widget);
 	layout->setSpacing(20);
@@ -1009,7 +4858,7 @@ QWidget* createLoginWidget(QMainWindow* mainWindow) {
 	layout->addLayout(buttonLayout);
 	
 	// 登录按钮事件
-	QObject::connect(loginBtn, &QPushButton::clicked, [mainWindow, phoneEdit, passwordEdit]() {
+	QObject::connect(loginBtn, &QPushButton::clicked, [&session, mainWindow, phoneEdit, passwordEdit]() {
 		QString phone = phoneEdit->text().trimmed();
 		QString password = passwordEdit->text().trimmed();
 		
@@ -1033,11 +4882,11 @@ QWidget* createLoginWidget(QMainWindow* mainWindow) {
 		}
 		
 		if (QString::fromStdString(it->password) == password) {
-			currentUser = &*it;
-			stackedWidget->setCurrentWidget(mainMenuWidget);
+			session.user = &*it;
+			session.stackedWidget->setCurrentWidget(session.mainMenuWidget);
 			// 登录成功后立即更新余额显示和行程表
-			updateBalanceDisplay();
-			updateMyTripsTable();
+			updateBalanceDisplay(session);
+			updateMyTripsTable(session);
 		} else {
 			QMessageBox::warning(mainWindow, "错误", "密码错误!");
 		}
@@ -1047,20 +4896,21 @@ QWidget* createLoginWidget(QMainWindow* mainWindow) {
 	QObject::connect(passwordEdit, &QLineEdit::returnPressed, loginBtn, &QPushButton::click);
 	
 	// 跳转到注册界面
-	QObject::connect(goToRegisterBtn, &QPushButton::clicked, [mainWindow]() {
-		stackedWidget->setCurrentWidget(registerWidget);
+	QObject::connect(goToRegisterBtn, &QPushButton::clicked, [&session]() {
+		session.stackedWidget->setCurrentWidget(session.registerWidget);
 	});
 	
 	// 退出按钮事件
-	QObject::connect(exitBtn, &QPushButton::clicked, []() {
-		stackedWidget->setCurrentWidget(startMenuWidget);
+	QObject::connect(exitBtn, &QPushButton::clicked, [&session]() {
+		session.stackedWidget->setCurrentWidget(session.startMenuWidget);
 	});
 	
 	return widget;
 }
 
 // 创建注册界面
-QWidget* createRegisterWidget(QMainWindow* mainWindow) {
+QWidget* createRegisterWidget(Session& session) {
+	QMainWindow* mainWindow = session.window;
 	QWidget* widget = new QWidget();
 	QVBoxLayout* layout = new QVBoxLayout(widget);
 	layout->setSpacing(20);
@@ -1162,7 +5012,7 @@ QWidget* createRegisterWidget(QMainWindow* mainWindow) {
 	layout->addLayout(buttonLayout);
 	
 	// 注册按钮事件
-	QObject::connect(registerBtn, &QPushButton::clicked, [mainWindow, phoneEdit, passwordEdit, confirmPasswordEdit, nameEdit, idNumberEdit]() {
+	QObject::connect(registerBtn, &QPushButton::clicked, [&session, mainWindow, phoneEdit, passwordEdit, confirmPasswordEdit, nameEdit, idNumberEdit]() {
 		QString phone = phoneEdit->text().trimmed();
 		QString password = passwordEdit->text().trimmed();
 		QString confirmPassword = confirmPasswordEdit->text().trimmed();
@@ -1206,7 +5056,7 @@ QWidget* createRegisterWidget(QMainWindow* mainWindow) {
 		}
 		
 		users.emplace_back(phone.toStdString(), password.toStdString(), name.toStdString(), idNumber.toStdString(), 3000.0);
-		saveUsersToDB();
+		insertUserToDB(users.back());
 		QMessageBox::information(mainWindow, "成功", "注册成功!请返回登录页面登录。");
 		
 		// 清空表单
@@ -1217,19 +5067,20 @@ QWidget* createRegisterWidget(QMainWindow* mainWindow) {
 		idNumberEdit->clear();
 		
 		// 跳转到登录界面
-		stackedWidget->setCurrentWidget(loginWidget);
+		session.stackedWidget->setCurrentWidget(session.loginWidget);
 	});
 	
 	// 返回登录按钮事件
-	QObject::connect(backToLoginBtn, &QPushButton::clicked, [mainWindow]() {
-		stackedWidget->setCurrentWidget(loginWidget);
+	QObject::connect(backToLoginBtn, &QPushButton::clicked, [&session]() {
+		session.stackedWidget->setCurrentWidget(session.loginWidget);
 	});
 	
 	return widget;
 }
 
 // 创建管理员登录界面
-QWidget* createAdminLoginWidget(QMainWindow* mainWindow) {
+QWidget* createAdminLoginWidget(Session& session) {
+	QMainWindow* mainWindow = session.window;
 	QWidget* widget = new QWidget();
 	QVBoxLayout* layout = new QVBoxLayout(widget);
 	layout->setSpacing(20);
@@ -1288,7 +5139,7 @@ QWidget* createAdminLoginWidget(QMainWindow* mainWindow) {
 	layout->addLayout(buttonLayout);
 	
 	// 登录按钮事件
-	QObject::connect(loginBtn, &QPushButton::clicked, [mainWindow, usernameEdit, passwordEdit]() {
+	QObject::connect(loginBtn, &QPushButton::clicked, [&session, mainWindow, usernameEdit, passwordEdit]() {
 		QString username = usernameEdit->text();
 		QString password = passwordEdit->text();
 		
@@ -1300,8 +5151,8 @@ QWidget* createAdminLoginWidget(QMainWindow* mainWindow) {
 		// 验证管理员身份
 		for (auto& admin : admins) {
 			if (QString::fromStdString(admin.username) == username && QString::fromStdString(admin.password) == password) {
-				currentAdmin = &admin;
-				stackedWidget->setCurrentWidget(adminMenuWidget);
+				session.admin = &admin;
+				session.stackedWidget->setCurrentWidget(session.adminMenuWidget);
 				usernameEdit->clear();
 				passwordEdit->clear();
 				return;
@@ -1312,20 +5163,21 @@ QWidget* createAdminLoginWidget(QMainWindow* mainWindow) {
 	});
 	
 	// 注册按钮事件
-	QObject::connect(registerBtn, &QPushButton::clicked, [mainWindow]() {
-		stackedWidget->setCurrentWidget(adminRegisterWidget);
+	QObject::connect(registerBtn, &QPushButton::clicked, [&session]() {
+		session.stackedWidget->setCurrentWidget(session.adminRegisterWidget);
 	});
 	
 	// 返回按钮事件
-	QObject::connect(backBtn, &QPushButton::clicked, [mainWindow]() {
-		stackedWidget->setCurrentWidget(startMenuWidget);
+	QObject::connect(backBtn, &QPushButton::clicked, [&session]() {
+		session.stackedWidget->setCurrentWidget(session.startMenuWidget);
 	});
 	
 	return widget;
 }
 
 // 创建管理员注册界面
-QWidget* createAdminRegisterWidget(QMainWindow* mainWindow) {
+QWidget* createAdminRegisterWidget(Session& session) {
+	QMainWindow* mainWindow = session.window;
 	QWidget* widget = new QWidget();
 	QVBoxLayout* layout = new QVBoxLayout(widget);
 	layout->setSpacing(20);
@@ -1396,7 +5248,7 @@ QWidget* createAdminRegisterWidget(QMainWindow* mainWindow) {
 	layout->addLayout(buttonLayout);
 	
 	// 注册按钮事件
-	QObject::connect(registerBtn, &QPushButton::clicked, [mainWindow, usernameEdit, passwordEdit, confirmPasswordEdit, nameEdit]() {
+	QObject::connect(registerBtn, &QPushButton::clicked, [&session, mainWindow, usernameEdit, passwordEdit, confirmPasswordEdit, nameEdit]() {
 		QString username = usernameEdit->text();
 		QString password = passwordEdit->text();
 		QString confirmPassword = confirmPasswordEdit->text();
@@ -1422,7 +5274,7 @@ QWidget* createAdminRegisterWidget(QMainWindow* mainWindow) {
 		
 		// 创建新管理员
 		admins.emplace_back(username.toStdString(), password.toStdString(), name.toStdString());
-		saveAdminsToDB();
+		insertAdminToDB(admins.back());
 		
 		QMessageBox::information(mainWindow, "成功", "管理员注册成功!");
 		
@@ -1433,170 +5285,179 @@ QWidget* createAdminRegisterWidget(QMainWindow* mainWindow) {
 		nameEdit->clear();
 		
 		// 跳转到登录界面
-		stackedWidget->setCurrentWidget(adminLoginWidget);
+		session.stackedWidget->setCurrentWidget(session.adminLoginWidget);
 	});
 	
 	// 返回登录按钮事件
-	QObject::connect(backToLoginBtn, &QPushButton::clicked, [mainWindow]() {
-		stackedWidget->setCurrentWidget(adminLoginWidget);
+	QObject::connect(backToLoginBtn, &QPushButton::clicked, [&session]() {
+		session.stackedWidget->setCurrentWidget(session.adminLoginWidget);
 	});
 	
 	return widget;
 }
 
 // 更新车票搜索结果
-void updateTicketTable(const QString& startStation, const QString& endStation, const QString& departureTimeFilter = "") {
+void updateTicketTable(Session& session, const QString& startStation, const QString& endStation, const QString& departureTimeFilter = "") {
 	cout << "开始查票：从 " << startStation.toStdString() << " 到 " << endStation.toStdString() << endl;
-	cout << "当前加载的车次数量: " << trains.size() << endl;
 	
-	if (!ticketTable) return;
+	if (!session.ticketTable) return;
 	
-	ticketTable->setRowCount(0);
+	session.ticketTable->setRowCount(0);
+	session.ticketTableRows.clear();
 	
-	string start = startStation.toStdString();
-	string end = endStation.toStdString();
+	TicketPage page = searchTicketPage(startStation.toStdString(), endStation.toStdString(), departureTimeFilter.toStdString(),
+									   session.travelDay, session.sortKey, session.page, TICKET_PAGE_SIZE);
 	
-	// 用于存储搜索结果和票价的结构体
-	struct TicketResult {
-		string trainNumber;
-		string startStationName;
-		string endStationName;
-		string departureTime;
-		string arrivalTime;
-		int availableSeats;
-		int price;
-	};
-	
-	vector<TicketResult> results;
+	// 当前页超出范围（例如购票后结果变少）时回到最后一页
+	if (page.rows.empty() && page.totalCount > 0) {
+		session.page = (page.totalCount - 1) / TICKET_PAGE_SIZE;
+		page = searchTicketPage(startStation.toStdString(), endStation.toStdString(), departureTimeFilter.toStdString(),
+								session.travelDay, session.sortKey, session.page, TICKET_PAGE_SIZE);
+	}
 	
-	for (const auto& train : trains) {
-		// 检查列车是否被停开
-		if (find(suspendedTrains.begin(), suspendedTrains.end(), train.trainNumber) != suspendedTrains.end()) {
-			cout << "车次 " << train.trainNumber << " 已停开，跳过" << endl;
-			continue;
-		}
-		
-		cout << "检查车次: " << train.trainNumber << endl;
-		cout << "  车次站点: ";
-		for (const string& station : train.stations) {
-			cout << station << " ";
-		}
-		cout << endl;
-		auto startIt = find_if(train.stations.begin(), train.stations.end(),
-			[&start](const string& station) {
-				return station == start;
-			});
-		auto endIt = find_if(train.stations.begin(), train.stations.end(),
-			[&end](const string& station) {
-				return station == end;
-			});
-		
-		bool foundStart = (startIt != train.stations.end());
-		bool foundEnd = (endIt != train.stations.end());
-		cout << "  找到起点站: " << (foundStart ? "是" : "否") << endl;
-		cout << "  找到终点站: " << (foundEnd ? "是" : "否") << endl;
-		
-		if (startIt != train.stations.end() && endIt != train.stations.end() && startIt != endIt) {
-			size_t startIdx = distance(train.stations.begin(), startIt);
-			size_t endIdx = distance(train.stations.begin(), endIt);
-			
-			// 确保索引顺序正确（小的在前，大的在后）
-			size_t fromIdx = min(startIdx, endIdx);
-			size_t toIdx = max(startIdx, endIdx);
-			
-			// 安全检查数组边界 - 现在检查站点索引而不是时间索引
-			size_t numStations = train.stations.size();
-			if (fromIdx < numStations && toIdx < numStations &&
-				fromIdx < train.segmentAvailableSeats.size() && 
-				fromIdx < train.priceMatrix.size() &&
-				toIdx < train.segmentAvailableSeats[fromIdx].size() &&
-				toIdx < train.priceMatrix[fromIdx].size()) {
-				
-				// 根据实际出发和到达站点确定时间和其他信息
-				// 获取对应方向的时刻表
-				vector<string> scheduleTimes = getDirectionalSchedule(train.arrivalTimes, startIdx, endIdx);
-				string departureTime = scheduleTimes[startIdx];
-				string arrivalTime = scheduleTimes[endIdx];
-				
-				// 如果用户指定了出发时间，进行过滤
-				if (!departureTimeFilter.isEmpty()) {
-					int filterTime = timeToMinutes(departureTimeFilter.toStdString());
-					int trainDepartureTime = timeToMinutes(departureTime);
-					
-					// 如果列车出发时间早于用户指定的时间，跳过此车次
-					if (trainDepartureTime < filterTime) {
-						continue;
-					}
-				}
-				
-				int availableSeats = train.segmentAvailableSeats[fromIdx][toIdx];
-				int price = train.priceMatrix[fromIdx][toIdx];
-				
-				results.push_back({
-					train.trainNumber,
-					train.stations[startIdx],
-					train.stations[endIdx],
-					departureTime,
-					arrivalTime,
-					availableSeats,
-					price
-				});
-			}
-		}
+	size_t pageCount = (page.totalCount + TICKET_PAGE_SIZE - 1) / TICKET_PAGE_SIZE;
+	if (session.ticketPageLabel) {
+		session.ticketPageLabel->setText(QString("第 %1 / %2 页，共 %3 个车次")
+			.arg(pageCount == 0 ? 0 : static_cast<int>(session.page) + 1)
+			.arg(static_cast<int>(pageCount))
+			.arg(static_cast<int>(page.totalCount)));
 	}
 	
 	// 如果没有找到结果，显示消息
-	if (results.empty()) {
+	if (page.totalCount == 0) {
 		QMessageBox::information(nullptr, "查询结果", 
 			QString("未找到从 %1 到 %2 的车票\n\n提示：请检查站点名称是否正确\n例如：北京, 上海, 广州")
 			.arg(startStation).arg(endStation));
 		return;
 	}
 	
-	// 按票价从低到高排序
-	sort(results.begin(), results.end(), [](const TicketResult& a, const TicketResult& b) {
-		return a.price < b.price;
-	});
-	
 	// 填充表格
+	session.ticketTableRows.assign(page.rows.begin(), page.rows.end());
 	int row = 0;
-	for (const auto& result : results) {
-		ticketTable->insertRow(row);
+	for (const auto& result : page.rows) {
+		const Train& train = trains[result.trainIdx];
+		session.ticketTable->insertRow(row);
 		
-		QTableWidgetItem* trainItem = new QTableWidgetItem(QString::fromStdString(result.trainNumber));
+		QTableWidgetItem* trainItem = new QTableWidgetItem(QString::fromStdString(train.trainNumber));
 		trainItem->setTextAlignment(Qt::AlignCenter);
-		ticketTable->setItem(row, 0, trainItem);
+		session.ticketTable->setItem(row, 0, trainItem);
 		
-		QTableWidgetItem* startItem = new QTableWidgetItem(QString::fromStdString(result.startStationName));
+		QTableWidgetItem* startItem = new QTableWidgetItem(QString::fromStdString(train.stations[result.startIdx]));
 		startItem->setTextAlignment(Qt::AlignCenter);
-		ticketTable->setItem(row, 1, startItem);
+		session.ticketTable->setItem(row, 1, startItem);
 		
-		QTableWidgetItem* endItem = new QTableWidgetItem(QString::fromStdString(result.endStationName));
+		QTableWidgetItem* endItem = new QTableWidgetItem(QString::fromStdString(train.stations[result.endIdx]));
 		endItem->setTextAlignment(Qt::AlignCenter);
-		ticketTable->setItem(row, 2, endItem);
+		session.ticketTable->setItem(row, 2, endItem);
 		
-		QTableWidgetItem* depTimeItem = new QTableWidgetItem(QString::fromStdString(result.departureTime));
+		QTableWidgetItem* depTimeItem = new QTableWidgetItem(QString::fromStdString(getDirectionalTime(train.arrivalTimes, result.startIdx, result.endIdx, result.startIdx)));
 		depTimeItem->setTextAlignment(Qt::AlignCenter);
-		ticketTable->setItem(row, 3, depTimeItem);
+		session.ticketTable->setItem(row, 3, depTimeItem);
 		
-		QTableWidgetItem* arrTimeItem = new QTableWidgetItem(QString::fromStdString(result.arrivalTime));
+		QTableWidgetItem* arrTimeItem = new QTableWidgetItem(QString::fromStdString(getDirectionalTime(train.arrivalTimes, result.startIdx, result.endIdx, result.endIdx)));
 		arrTimeItem->setTextAlignment(Qt::AlignCenter);
-		ticketTable->setItem(row, 4, arrTimeItem);
+		session.ticketTable->setItem(row, 4, arrTimeItem);
 		
 		QTableWidgetItem* seatsItem = new QTableWidgetItem(QString::number(result.availableSeats));
 		seatsItem->setTextAlignment(Qt::AlignCenter);
-		ticketTable->setItem(row, 5, seatsItem);
+		session.ticketTable->setItem(row, 5, seatsItem);
 		
 		QTableWidgetItem* priceItem = new QTableWidgetItem(QString::number(result.price));
 		priceItem->setTextAlignment(Qt::AlignCenter);
-		ticketTable->setItem(row, 6, priceItem);
+		session.ticketTable->setItem(row, 6, priceItem);
 		
 		row++;
 	}
 }
 
+// 变更事件：只更新受影响的单元格或行。余票变化时重新读取该区间的余票和票价（票价随上座率变化），
+// 行的顺序保持不变，重新查询或翻页时才按新的数据排序
+void applyChangeToSession(Session& session, const ChangeEvent& event) {
+	switch (event.kind) {
+		case ChangeKind::SeatsChanged: {
+			if (!session.ticketTable || event.day != session.travelDay) {
+				return;
+			}
+			for (size_t row = 0; row < session.ticketTableRows.size(); ++row) {
+				TicketResult& result = session.ticketTableRows[row];
+				size_t fromIdx = min(result.startIdx, result.endIdx);
+				size_t toIdx = max(result.startIdx, result.endIdx);
+				if (result.trainIdx != event.trainIdx || fromIdx != event.fromIdx || toIdx != event.toIdx) {
+					continue;
+				}
+				result.availableSeats = getAvailableSeats(event.trainIdx, event.day, fromIdx, toIdx);
+				result.price = dynamicFare(event.trainIdx, event.day, fromIdx, toIdx);
+				if (QTableWidgetItem* seatsItem = session.ticketTable->item(static_cast<int>(row), 5)) {
+					seatsItem->setText(QString::number(result.availableSeats));
+				}
+				if (QTableWidgetItem* priceItem = session.ticketTable->item(static_cast<int>(row), 6)) {
+					priceItem->setText(QString::number(result.price));
+				}
+			}
+			break;
+		}
+		case ChangeKind::TripAdded:
+			if (session.myTripsTable && session.user && event.userId == session.user->id && event.tripIndex < session.user->trips.size()) {
+				int row = static_cast<int>(event.tripIndex);
+				session.myTripsTable->insertRow(row);
+				setTripRow(session, row, session.user->trips[event.tripIndex]);
+				updateBalanceDisplay(session);
+			}
+			break;
+		case ChangeKind::TripRemoved:
+			if (session.myTripsTable && session.user && event.userId == session.user->id &&
+				static_cast<int>(event.tripIndex) < session.myTripsTable->rowCount()) {
+				// 与 user.trips 一致：最后一行移到被删除的位置
+				if (event.tripIndex < session.user->trips.size()) {
+					setTripRow(session, static_cast<int>(event.tripIndex), session.user->trips[event.tripIndex]);
+				}
+				session.myTripsTable->removeRow(session.myTripsTable->rowCount() - 1);
+				updateBalanceDisplay(session);
+			}
+			break;
+		case ChangeKind::BalanceChanged:
+			if (session.user && event.userId == session.user->id) {
+				updateBalanceDisplay(session);
+			}
+			break;
+	}
+}
+
+// 按当前预售期重建乘车日期列表；原来选中的日期已过去时改选今天，并重新查询
+void refreshDateCombo(Session& session) {
+	if (!session.dateCombo) {
+		return;
+	}
+	bool keepDay = isInSalesWindow(session.travelDay);
+	if (!keepDay) {
+		session.travelDay = currentServiceDay;
+	}
+	// 重建列表时不触发切换日期的查询
+	session.dateCombo->blockSignals(true);
+	session.dateCombo->clear();
+	for (int offset = 0; offset < SALES_WINDOW_DAYS; ++offset) {
+		int day = currentServiceDay + offset;
+		session.dateCombo->addItem(QString::fromStdString(serviceDayToString(day)), day);
+	}
+	session.dateCombo->setCurrentIndex(session.travelDay - currentServiceDay);
+	session.dateCombo->blockSignals(false);
+	if (keepDay) {
+		return;
+	}
+	session.page = 0;
+	if (session.ticketTable && !session.startStation.empty() && !session.endStation.empty()) {
+		updateTicketTable(session, QString::fromStdString(session.startStation), QString::fromStdString(session.endStation), QString::fromStdString(session.departureTimeFilter));
+	}
+}
+
+// 一个窗口中的购票、退票可能影响所有窗口：逐个会话更新
+void applyChangeToViews(const ChangeEvent& event) {
+	sessionManager.forEach([&event](Session& session) { applyChangeToSession(session, event); });
+}
+
 // 创建主菜单界面
-QWidget* createMainMenuWidget(QMainWindow* mainWindow) {
+QWidget* createMainMenuWidget(Session& session) {
+	QMainWindow* mainWindow = session.window;
 	QWidget* widget = new QWidget();
 	QVBoxLayout* layout = new QVBoxLayout(widget);
 	
@@ -1667,6 +5528,15 @@ QWidget* createMainMenuWidget(QMainWindow* mainWindow) {
 	timeLayout->addWidget(minuteEdit);
 	timeLayout->addStretch();
 	
+	// 乘车日期：预售期内的日期，项数据为运行日编号
+	QLabel* dateLabel = new QLabel("乘车日期:");
+	dateLabel->setStyleSheet("font-weight: bold; font-size: 14px;");
+	QComboBox* dateCombo = new QComboBox();
+	session.dateCombo = dateCombo;
+	session.travelDay = currentServiceDay;
+	refreshDateCombo(session);
+	dateCombo->setStyleSheet("QComboBox { padding: 6px; border: 2px solid #bdc3c7; border-radius: 3px; font-size: 14px; min-width: 110px; }");
+	
 	QPushButton* searchBtn = new QPushButton("查询车票");
 	searchBtn->setStyleSheet("QPushButton { background-color: #27ae60; color: white; padding: 10px 20px; border: none; border-radius: 5px; font-size: 14px; font-weight: bold; } QPushButton:hover { background-color: #229954; }");
 	
@@ -1679,25 +5549,75 @@ QWidget* createMainMenuWidget(QMainWindow* mainWindow) {
 	searchInputLayout->addWidget(timeLabel);
 	searchInputLayout->addWidget(timeWidget);
 	searchInputLayout->addStretch();
+	searchInputLayout->addWidget(dateLabel);
+	searchInputLayout->addWidget(dateCombo);
+	searchInputLayout->addStretch();
 	searchInputLayout->addWidget(searchBtn);
 	searchLayout->addWidget(searchGroup);
 	
+	// 排序与分页区域
+	QHBoxLayout* sortPageLayout = new QHBoxLayout();
+	QLabel* sortLabel = new QLabel("排序:");
+	sortLabel->setStyleSheet("font-weight: bold; font-size: 14px;");
+	QComboBox* sortCombo = new QComboBox();
+	sortCombo->addItem("票价最低");
+	sortCombo->addItem("出发最早");
+	sortCombo->addItem("到达最早");
+	sortCombo->addItem("历时最短");
+	sortCombo->addItem("余票最多");
+	sortCombo->setStyleSheet("QComboBox { padding: 6px; border: 2px solid #bdc3c7; border-radius: 3px; font-size: 14px; min-width: 100px; }");
+	
+	QPushButton* prevPageBtn = new QPushButton("上一页");
+	QPushButton* nextPageBtn = new QPushButton("下一页");
+	QString pageButtonStyle = "QPushButton { background-color: #95a5a6; color: white; padding: 6px 14px; border: none; border-radius: 3px; font-size: 13px; } QPushButton:hover { background-color: #7f8c8d; }";
+	prevPageBtn->setStyleSheet(pageButtonStyle);
+	nextPageBtn->setStyleSheet(pageButtonStyle);
+	session.ticketPageLabel = new QLabel("第 0 / 0 页");
+	session.ticketPageLabel->setStyleSheet("font-size: 13px; color: #7f8c8d;");
+	
+	sortPageLayout->addWidget(sortLabel);
+	sortPageLayout->addWidget(sortCombo);
+	sortPageLayout->addStretch();
+	sortPageLayout->addWidget(prevPageBtn);
+	sortPageLayout->addWidget(session.ticketPageLabel);
+	sortPageLayout->addWidget(nextPageBtn);
+	searchLayout->addLayout(sortPageLayout);
+	
 	// 车票结果表格
-	ticketTable = new QTableWidget();
-	ticketTable->setColumnCount(7);
+	session.ticketTable = new QTableWidget();
+	session.ticketTable->setColumnCount(7);
 	QStringList headers = {"车次", "出发站", "到达站", "出发时间", "到达时间", "余票", "票价(¥)"};
-	ticketTable->setHorizontalHeaderLabels(headers);
-	ticketTable->horizontalHeader()->setStretchLastSection(true);
-	ticketTable->setSelectionBehavior(QAbstractItemView::SelectRows);
-	ticketTable->setSelectionMode(QAbstractItemView::SingleSelection);
-	ticketTable->setAlternatingRowColors(true);
-	ticketTable->setStyleSheet("QTableWidget { border: 1px solid #bdc3c7; gridline-color: #ecf0f1; background-color: #ffffff; } QTableWidget::item { padding: 8px; text-align: center; } QHeaderView::section { background-color: #34495e; color: white; padding: 8px; font-weight: bold; text-align: center; }");
-	searchLayout->addWidget(ticketTable);
+	session.ticketTable->setHorizontalHeaderLabels(headers);
+	session.ticketTable->horizontalHeader()->setStretchLastSection(true);
+	session.ticketTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+	session.ticketTable->setSelectionMode(QAbstractItemView::SingleSelection);
+	session.ticketTable->setAlternatingRowColors(true);
+	session.ticketTable->setStyleSheet("QTableWidget { border: 1px solid #bdc3c7; gridline-color: #ecf0f1; background-color: #ffffff; } QTableWidget::item { padding: 8px; text-align: center; } QHeaderView::section { background-color: #34495e; color: white; padding: 8px; font-weight: bold; text-align: center; }");
+	searchLayout->addWidget(session.ticketTable);
 	
 	// 购票按钮
+	QHBoxLayout* buyLayout = new QHBoxLayout();
+	QLabel* ticketCountLabel = new QLabel("购票张数:");
+	ticketCountLabel->setStyleSheet("font-weight: bold; font-size: 14px;");
+	QLineEdit* ticketCountEdit = new QLineEdit();
+	ticketCountEdit->setPlaceholderText("1");
+	ticketCountEdit->setMaxLength(2);
+	ticketCountEdit->setFixedWidth(50);
+	ticketCountEdit->setValidator(new QIntValidator(1, 99, ticketCountEdit));
+	ticketCountEdit->setStyleSheet("QLineEdit { padding: 8px; border: 2px solid #bdc3c7; border-radius: 3px; font-size: 14px; }");
+	QComboBox* seatClassCombo = new QComboBox();
+	for (int c = 0; c < SEAT_CLASS_COUNT; ++c) {
+		seatClassCombo->addItem(SEAT_CLASSES[c].name, c);
+	}
+	seatClassCombo->setCurrentIndex(SecondClass);
+	seatClassCombo->setStyleSheet("QComboBox { padding: 8px; border: 2px solid #bdc3c7; border-radius: 3px; font-size: 14px; }");
 	QPushButton* buyBtn = new QPushButton("购买选中车票");
 	buyBtn->setStyleSheet("QPushButton { font-size: 14px; padding: 10px 20px; margin: 5px; background-color: #3498db; color: white; border: none; border-radius: 5px; font-weight: bold; } QPushButton:hover { background-color: #2980b9; }");
-	searchLayout->addWidget(buyBtn);
+	buyLayout->addWidget(ticketCountLabel);
+	buyLayout->addWidget(ticketCountEdit);
+	buyLayout->addWidget(seatClassCombo);
+	buyLayout->addWidget(buyBtn, 1);
+	searchLayout->addLayout(buyLayout);
 	
 	tabWidget->addTab(searchTab, "车票查询");
 	
@@ -1712,17 +5632,17 @@ QWidget* createMainMenuWidget(QMainWindow* mainWindow) {
 	
 	// 乘车人姓名显示
 	QHBoxLayout* passengerNameLayout = new QHBoxLayout();
-	tripsPassengerNameLabel = new QLabel("乘车人：未登录");
-	tripsPassengerNameLabel->setStyleSheet("font-size: 18px; font-weight: bold; color: #2c3e50; padding: 10px;");
-	passengerNameLayout->addWidget(tripsPassengerNameLabel);
+	session.tripsPassengerNameLabel = new QLabel("乘车人：未登录");
+	session.tripsPassengerNameLabel->setStyleSheet("font-size: 18px; font-weight: bold; color: #2c3e50; padding: 10px;");
+	passengerNameLayout->addWidget(session.tripsPassengerNameLabel);
 	passengerNameLayout->addStretch();
 	tripsPassengerLayout->addLayout(passengerNameLayout);
 	
 	// 手机号显示
 	QHBoxLayout* passengerPhoneLayout = new QHBoxLayout();
-	tripsPassengerPhoneLabel = new QLabel("手机号：未登录");
-	tripsPassengerPhoneLabel->setStyleSheet("font-size: 16px; color: #7f8c8d; padding: 5px 10px;");
-	passengerPhoneLayout->addWidget(tripsPassengerPhoneLabel);
+	session.tripsPassengerPhoneLabel = new QLabel("手机号：未登录");
+	session.tripsPassengerPhoneLabel->setStyleSheet("font-size: 16px; color: #7f8c8d; padding: 5px 10px;");
+	passengerPhoneLayout->addWidget(session.tripsPassengerPhoneLabel);
 	passengerPhoneLayout->addStretch();
 	tripsPassengerLayout->addLayout(passengerPhoneLayout);
 	
@@ -1734,16 +5654,16 @@ QWidget* createMainMenuWidget(QMainWindow* mainWindow) {
 	QVBoxLayout* tripsGroupLayout = new QVBoxLayout(tripsGroup);
 	
 	// 个人行程表格
-	myTripsTable = new QTableWidget();
-	myTripsTable->setColumnCount(6);
-	QStringList tripHeaders = {"车次", "出发站", "到达站", "出发时间", "到达时间", "票价(¥)"};
-	myTripsTable->setHorizontalHeaderLabels(tripHeaders);
-	myTripsTable->horizontalHeader()->setStretchLastSection(true);
-	myTripsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
-	myTripsTable->setSelectionMode(QAbstractItemView::SingleSelection);
-	myTripsTable->setAlternatingRowColors(true);
-	myTripsTable->setStyleSheet("QTableWidget { border: 1px solid #bdc3c7; gridline-color: #ecf0f1; background-color: #ffffff; } QTableWidget::item { padding: 8px; text-align: center; } QHeaderView::section { background-color: #34495e; color: white; padding: 8px; font-weight: bold; text-align: center; }");
-	tripsGroupLayout->addWidget(myTripsTable);
+	session.myTripsTable = new QTableWidget();
+	session.myTripsTable->setColumnCount(8);
+	QStringList tripHeaders = {"车次", "乘车日期", "出发站", "到达站", "出发时间", "到达时间", "票价(¥)", "座位"};
+	session.myTripsTable->setHorizontalHeaderLabels(tripHeaders);
+	session.myTripsTable->horizontalHeader()->setStretchLastSection(true);
+	session.myTripsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+	session.myTripsTable->setSelectionMode(QAbstractItemView::SingleSelection);
+	session.myTripsTable->setAlternatingRowColors(true);
+	session.myTripsTable->setStyleSheet("QTableWidget { border: 1px solid #bdc3c7; gridline-color: #ecf0f1; background-color: #ffffff; } QTableWidget::item { padding: 8px; text-align: center; } QHeaderView::section { background-color: #34495e; color: white; padding: 8px; font-weight: bold; text-align: center; }");
+	tripsGroupLayout->addWidget(session.myTripsTable);
 	
 	// 退票按钮
 	QPushButton* cancelBtn = new QPushButton("退订选中车票");
@@ -1765,540 +5685,1508 @@ QWidget* createMainMenuWidget(QMainWindow* mainWindow) {
 	
 	// 乘车人信息显示
 	QHBoxLayout* passengerInfoLayout = new QHBoxLayout();
-	passengerInfoLabel = new QLabel("乘车人：未登录");
-	passengerInfoLabel->setStyleSheet("font-size: 18px; font-weight: bold; color: #2c3e50; padding: 15px; text-align: center;");
-	passengerInfoLayout->addWidget(passengerInfoLabel);
+	session.passengerInfoLabel = new QLabel("乘车人：未登录");
+	session.passengerInfoLabel->setStyleSheet("font-size: 18px; font-weight: bold; color: #2c3e50; padding: 15px; text-align: center;");
+	passengerInfoLayout->addWidget(session.passengerInfoLabel);
 	passengerInfoLayout->addStretch();
 	balanceGroupLayout->addLayout(passengerInfoLayout);
 	
-	// 余额显示行
-	QHBoxLayout* balanceDisplayLayout = new QHBoxLayout();
-	balanceLabel = new QLabel("当前余额: ¥0.00");
-	balanceLabel->setStyleSheet("font-size: 24px; font-weight: bold; color: #27ae60; padding: 20px; text-align: center;");
-	balanceDisplayLayout->addWidget(balanceLabel);
-	balanceDisplayLayout->addStretch();
-	balanceGroupLayout->addLayout(balanceDisplayLayout);
+	// 余额显示行
+	QHBoxLayout* balanceDisplayLayout = new QHBoxLayout();
+	session.balanceLabel = new QLabel("当前余额: ¥0.00");
+	session.balanceLabel->setStyleSheet("font-size: 24px; font-weight: bold; color: #27ae60; padding: 20px; text-align: center;");
+	balanceDisplayLayout->addWidget(session.balanceLabel);
+	balanceDisplayLayout->addStretch();
+	balanceGroupLayout->addLayout(balanceDisplayLayout);
+	
+	// 充值操作区域
+	QGroupBox* rechargeGroup = new QGroupBox("账户充值");
+	rechargeGroup->setStyleSheet("QGroupBox { font-weight: bold; font-size: 14px; margin: 10px 0px; padding: 10px; border: 2px solid #bdc3c7; border-radius: 5px; } QGroupBox::title { subcontrol-origin: margin; left: 10px; padding: 0 5px 0 5px; }");
+	QVBoxLayout* rechargeGroupLayout = new QVBoxLayout(rechargeGroup);
+	
+	QHBoxLayout* rechargeLayout = new QHBoxLayout();
+	QLabel* rechargeLabel = new QLabel("充值金额:");
+	rechargeLabel->setStyleSheet("font-size: 16px; font-weight: bold;");
+	session.rechargeAmountEdit = new QLineEdit();
+	session.rechargeAmountEdit->setPlaceholderText("输入充值金额");
+	session.rechargeAmountEdit->setMaximumWidth(200);
+	session.rechargeAmountEdit->setStyleSheet("QLineEdit { padding: 12px; border: 2px solid #bdc3c7; border-radius: 5px; font-size: 16px; }");
+	QPushButton* rechargeBtn = new QPushButton("立即充值");
+	rechargeBtn->setStyleSheet("QPushButton { background-color: #3498db; color: white; padding: 12px 25px; border: none; border-radius: 5px; font-size: 16px; font-weight: bold; } QPushButton:hover { background-color: #2980b9; }");
+	
+	rechargeLayout->addWidget(rechargeLabel);
+	rechargeLayout->addWidget(session.rechargeAmountEdit);
+	rechargeLayout->addWidget(rechargeBtn);
+	rechargeLayout->addStretch();
+	rechargeGroupLayout->addLayout(rechargeLayout);
+	
+	balanceGroupLayout->addWidget(rechargeGroup);
+	accountLayout->addWidget(balanceGroup);
+	accountLayout->addStretch();
+	
+	tabWidget->addTab(accountTab, "账户管理");
+	
+	layout->addWidget(tabWidget);
+	
+	// 退出登录按钮
+	QPushButton* logoutBtn = new QPushButton("退出登录");
+	logoutBtn->setStyleSheet("QPushButton { font-size: 14px; padding: 8px; margin: 5px; }");
+	layout->addWidget(logoutBtn);
+	
+	// 查询按钮事件
+	QObject::connect(searchBtn, &QPushButton::clicked, [&session, fromEdit, toEdit, hourEdit, minuteEdit]() {
+		QString startStation = fromEdit->text().trimmed();
+		QString endStation = toEdit->text().trimmed();
+		QString hourText = hourEdit->text().trimmed();
+		QString minuteText = minuteEdit->text().trimmed();
+		
+		if (startStation.isEmpty() || endStation.isEmpty()) {
+			QMessageBox::warning(nullptr, "提示", "请输入出发站和到达站!");
+			return;
+		}
+		
+		QString departureTime = "";
+		
+		// 验证时间输入（如果用户输入了时间）
+		if (!hourText.isEmpty() || !minuteText.isEmpty()) {
+			// 如果只输入了其中一个，提示用户
+			if (hourText.isEmpty() || minuteText.isEmpty()) {
+				QMessageBox::warning(nullptr, "提示", "请输入完整的时间（小时和分钟）或留空不限制时间");
+				return;
+			}
+			
+			bool hourOk, minuteOk;
+			int hour = hourText.toInt(&hourOk);
+			int minute = minuteText.toInt(&minuteOk);
+			
+			if (!hourOk || !minuteOk || hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+				QMessageBox::warning(nullptr, "提示", "请输入有效的时间\n小时：0-23\n分钟：0-59");
+				return;
+			}
+			
+			// 格式化时间为HH:MM
+			departureTime = QString("%1:%2")
+				.arg(hour, 2, 10, QChar('0'))
+				.arg(minute, 2, 10, QChar('0'));
+		}
+		
+		session.startStation = startStation.toStdString();
+		session.endStation = endStation.toStdString();
+		session.departureTimeFilter = departureTime.toStdString();
+		session.page = 0;
+		updateTicketTable(session, startStation, endStation, departureTime);
+	});
+	
+	// 切换乘车日期：回到第一页重新查询
+	QObject::connect(dateCombo, &QComboBox::currentIndexChanged, [&session, dateCombo](int index) {
+		session.travelDay = dateCombo->itemData(index).toInt();
+		session.page = 0;
+		if (!session.startStation.empty() && !session.endStation.empty()) {
+			updateTicketTable(session, QString::fromStdString(session.startStation), QString::fromStdString(session.endStation), QString::fromStdString(session.departureTimeFilter));
+		}
+	});
+	
+	// 切换排序方式：回到第一页重新取结果
+	QObject::connect(sortCombo, &QComboBox::currentIndexChanged, [&session](int index) {
+		session.sortKey = static_cast<TicketSortKey>(index);
+		session.page = 0;
+		if (!session.startStation.empty() && !session.endStation.empty()) {
+			updateTicketTable(session, QString::fromStdString(session.startStation), QString::fromStdString(session.endStation), QString::fromStdString(session.departureTimeFilter));
+		}
+	});
+	
+	// 翻页
+	QObject::connect(prevPageBtn, &QPushButton::clicked, [&session]() {
+		if (session.page == 0 || session.startStation.empty() || session.endStation.empty()) {
+			return;
+		}
+		session.page--;
+		updateTicketTable(session, QString::fromStdString(session.startStation), QString::fromStdString(session.endStation), QString::fromStdString(session.departureTimeFilter));
+	});
+	
+	QObject::connect(nextPageBtn, &QPushButton::clicked, [&session]() {
+		if (session.startStation.empty() || session.endStation.empty()) {
+			return;
+		}
+		size_t total = searchTickets(session.startStation, session.endStation, session.departureTimeFilter, session.travelDay).size();
+		if ((session.page + 1) * TICKET_PAGE_SIZE >= total) {
+			return;
+		}
+		session.page++;
+		updateTicketTable(session, QString::fromStdString(session.startStation), QString::fromStdString(session.endStation), QString::fromStdString(session.departureTimeFilter));
+	});
+	
+	// 购票按钮事件
+	QObject::connect(buyBtn, &QPushButton::clicked, [&session, mainWindow, ticketCountEdit, seatClassCombo]() {
+		int currentRow = session.ticketTable->currentRow();
+		if (currentRow < 0) {
+			QMessageBox::warning(mainWindow, "提示", "请选择要购买的车票!");
+			return;
+		}
+		
+		if (session.startStation.empty() || session.endStation.empty()) {
+			QMessageBox::warning(mainWindow, "提示", "请先查询车票!");
+			return;
+		}
+		
+		if (!session.user) {
+			QMessageBox::warning(mainWindow, "错误", "用户未登录!");
+			return;
+		}
+		
+		// 检查表格项是否存在
+		QTableWidgetItem* item = session.ticketTable->item(currentRow, 0);
+		if (!item) {
+			QMessageBox::warning(mainWindow, "错误", "获取车次信息失败!");
+			return;
+		}
+		
+		QString trainNumber = item->text();
+		
+		// 购票张数，留空默认为1张
+		int ticketCount = 1;
+		QString countText = ticketCountEdit->text().trimmed();
+		if (!countText.isEmpty()) {
+			bool countOk;
+			ticketCount = countText.toInt(&countOk);
+			if (!countOk || ticketCount <= 0) {
+				QMessageBox::warning(mainWindow, "提示", "请输入有效的购票张数!");
+				return;
+			}
+		}
+		
+		BookingLeg leg;
+		leg.trainNumber = trainNumber.toStdString();
+		leg.startStation = session.startStation;
+		leg.endStation = session.endStation;
+		leg.passengers = ticketCount;
+		leg.serviceDay = session.travelDay;
+		leg.seatClass = seatClassCombo->currentData().toInt();
+		QString travelDate = QString::fromStdString(serviceDayToString(session.travelDay));
+		
+		// 先预留座位，支付确认期间其他用户无法购买这些座位
+		BookingResult booking;
+		unsigned holdId = placeSeatHold(*session.user, {leg}, booking);
+		if (holdId == 0) {
+			QMessageBox::warning(mainWindow, "错误", QString::fromStdString(booking.message));
+			return;
+		}
+		
+		int ret = QMessageBox::question(mainWindow, "确认支付", 
+			QString("已为您保留座位 %1 分钟\n车次: %2\n日期: %3\n从 %4 到 %5\n席别: %6\n张数: %7\n应付: ¥%8\n\n是否确认支付？")
+			.arg(DEFAULT_HOLD_TTL_SECONDS / 60)
+			.arg(trainNumber)
+			.arg(travelDate)
+			.arg(QString::fromStdString(session.startStation))
+			.arg(QString::fromStdString(session.endStation))
+			.arg(seatClassCombo->currentText())
+			.arg(ticketCount)
+			.arg(booking.totalPrice),
+			QMessageBox::Yes | QMessageBox::No);
+		
+		if (ret != QMessageBox::Yes) {
+			releaseSeatHold(holdId);
+			return;
+		}
+		
+		booking = confirmSeatHold(*session.user, holdId);
+		if (!booking.success) {
+			// 确认失败时释放预留（与 bookTickets 相同），余额不足时用户充值后重新购票
+			releaseSeatHold(holdId);
+			if (booking.error == BookingError::InsufficientBalance) {
+				QMessageBox::warning(mainWindow, "余额不足", 
+					QString("购票失败！\n票价: ¥%1\n当前余额: ¥%2\n需要充值: ¥%3")
+					.arg(booking.totalPrice)
+					.arg(QString::number(session.user->balance, 'f', 2))
+					.arg(QString::number(booking.totalPrice - session.user->balance, 'f', 2)));
+			} else {
+				QMessageBox::warning(mainWindow, "错误", QString::fromStdString(booking.message));
+			}
+			return;
+		}
+		
+		updateBalanceDisplay(session);
+		
+		QString seatText;
+		for (const string& seat : booking.seats) {
+			seatText += "\n" + QString::fromStdString(seat);
+		}
+		QMessageBox::information(mainWindow, "购票成功", 
+			QString("购票成功！\n车次: %1\n日期: %2\n从 %3 到 %4\n张数: %5\n票价: ¥%6\n剩余余额: ¥%7\n座位:%8")
+			.arg(trainNumber)
+			.arg(travelDate)
+			.arg(QString::fromStdString(session.startStation))
+			.arg(QString::fromStdString(session.endStation))
+			.arg(ticketCount)
+			.arg(booking.totalPrice)
+			.arg(QString::number(session.user->balance, 'f', 2))
+			.arg(seatText));
+		// 余票、票价和行程表已由变更事件逐格更新
+	});
+	
+	// 退票按钮事件
+	QObject::connect(cancelBtn, &QPushButton::clicked, [&session, mainWindow]() {
+		int currentRow = session.myTripsTable->currentRow();
+		if (currentRow < 0 || currentRow >= static_cast<int>(session.user->trips.size())) {
+			QMessageBox::warning(mainWindow, "提示", "请选择要退订的车票!");
+			return;
+		}
+		
+		// 行程表的行与 user.trips 一一对应，按选中行的车票编号退票
+		RefundResult refund = refundTicket(*session.user, session.user->trips[currentRow].ticketId);
+		if (!refund.success) {
+			QMessageBox::warning(mainWindow, "错误", QString::fromStdString(refund.message));
+			return;
+		}
+		updateBalanceDisplay(session);
+		
+		QMessageBox::information(mainWindow, "退票成功", 
+			QString("退票成功！\n原票价: ¥%1\n退款金额: ¥%2 (80%)\n当前余额: ¥%3")
+			.arg(refund.originalPrice)
+			.arg(refund.refundAmount)
+			.arg(QString::number(session.user->balance, 'f', 2)));
+	});
+	
+	// 退出登录按钮事件
+	QObject::connect(logoutBtn, &QPushButton::clicked, [&session]() {
+		session.user = nullptr;
+		session.stackedWidget->setCurrentWidget(session.loginWidget);
+	});
+	
+	// 充值按钮事件
+	QObject::connect(rechargeBtn, &QPushButton::clicked, [&session, mainWindow]() {
+		if (!session.user) {
+			QMessageBox::warning(mainWindow, "错误", "用户未登录!");
+			return;
+		}
+		
+		QString amountText = session.rechargeAmountEdit->text().trimmed();
+		if (amountText.isEmpty()) {
+			QMessageBox::warning(mainWindow, "提示", "请输入充值金额!");
+			return;
+		}
+		
+		bool ok;
+		double amount = amountText.toDouble(&ok);
+		string message;
+		if (!ok || !rechargeBalance(*session.user, amount, message)) {
+			QMessageBox::warning(mainWindow, "错误", ok ? QString::fromStdString(message) : QString("请输入有效的充值金额!"));
+			return;
+		}
+		// 余额显示（包括以同一用户登录的其他窗口）已由变更事件更新
+		session.rechargeAmountEdit->clear();
+		
+		QMessageBox::information(mainWindow, "充值成功", 
+			QString("充值成功！\n充值金额: ¥%1\n当前余额: ¥%2")
+			.arg(QString::number(amount, 'f', 2))
+			.arg(QString::number(session.user->balance, 'f', 2)));
+	});
+	
+	return widget;
+}
+
+// 填充管理员列车表
+void updateAdminTrainTable(Session& session) {
+	if (!session.adminTrainTable) return;
+	
+	session.adminTrainTable->setRowCount(trains.size());
+	for (size_t i = 0; i < trains.size(); ++i) {
+		const auto& train = trains[i];
+		
+		// 车次
+		session.adminTrainTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(train.trainNumber)));
+		
+		// 路线
+		QString route = QString::fromStdString(train.stations.front()) + " -> " + QString::fromStdString(train.stations.back());
+		session.adminTrainTable->setItem(i, 1, new QTableWidgetItem(route));
+		
+		// 状态
+		bool isSuspended = suspendedBitmap[i];
+		QString status = isSuspended ? "停开" : "正常";
+		QTableWidgetItem* statusItem = new QTableWidgetItem(status);
+		if (isSuspended) {
+			statusItem->setBackground(QBrush(QColor(231, 76, 60, 100))); // 红色背景
+		} else {
+			statusItem->setBackground(QBrush(QColor(46, 204, 113, 100))); // 绿色背景
+		}
+		session.adminTrainTable->setItem(i, 2, statusItem);
+	}
+}
+
+// 创建管理员主菜单界面
+QWidget* createAdminMenuWidget(Session& session) {
+	QMainWindow* mainWindow = session.window;
+	QWidget* widget = new QWidget();
+	QVBoxLayout* layout = new QVBoxLayout(widget);
+	layout->setSpacing(20);
+	layout->setContentsMargins(30, 30, 30, 30);
+	
+	// 标题
+	QLabel* titleLabel = new QLabel("管理员控制台");
+	titleLabel->setAlignment(Qt::AlignCenter);
+	titleLabel->setStyleSheet("font-size: 24px; font-weight: bold; color: #e74c3c; margin-bottom: 20px;");
+	layout->addWidget(titleLabel);
 	
-	// 充值操作区域
-	QGroupBox* rechargeGroup = new QGroupBox("账户充值");
-	rechargeGroup->setStyleSheet("QGroupBox { font-weight: bold; font-size: 14px; margin: 10px 0px; padding: 10px; border: 2px solid #bdc3c7; border-radius: 5px; } QGroupBox::title { subcontrol-origin: margin; left: 10px; padding: 0 5px 0 5px; }");
-	QVBoxLayout* rechargeGroupLayout = new QVBoxLayout(rechargeGroup);
+	// 创建列车管理表格
+	session.adminTrainTable = new QTableWidget();
+	session.adminTrainTable->setColumnCount(3);
+	QStringList headers = {"车次", "路线", "状态"};
+	session.adminTrainTable->setHorizontalHeaderLabels(headers);
 	
-	QHBoxLayout* rechargeLayout = new QHBoxLayout();
-	QLabel* rechargeLabel = new QLabel("充值金额:");
-	rechargeLabel->setStyleSheet("font-size: 16px; font-weight: bold;");
-	rechargeAmountEdit = new QLineEdit();
-	rechargeAmountEdit->setPlaceholderText("输入充值金额");
-	rechargeAmountEdit->setMaximumWidth(200);
-	rechargeAmountEdit->setStyleSheet("QLineEdit { padding: 12px; border: 2px solid #bdc3c7; border-radius: 5px; font-size: 16px; }");
-	QPushButton* rechargeBtn = new QPushButton("立即充值");
-	rechargeBtn->setStyleSheet("QPushButton { background-color: #3498db; color: white; padding: 12px 25px; border: none; border-radius: 5px; font-size: 16px; font-weight: bold; } QPushButton:hover { background-color: #2980b9; }");
+	// 设置表格样式
+	session.adminTrainTable->setStyleSheet(
+		"QTableWidget { gridline-color: #bdc3c7; font-size: 12px; }"
+		"QTableWidget::item { padding: 8px; }"
+		"QHeaderView::section { background-color: #34495e; color: white; padding: 8px; font-weight: bold; }"
+	);
 	
-	rechargeLayout->addWidget(rechargeLabel);
-	rechargeLayout->addWidget(rechargeAmountEdit);
-	rechargeLayout->addWidget(rechargeBtn);
-	rechargeLayout->addStretch();
-	rechargeGroupLayout->addLayout(rechargeLayout);
+	session.adminTrainTable->horizontalHeader()->setStretchLastSection(true);
+	session.adminTrainTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+	session.adminTrainTable->setAlternatingRowColors(true);
 	
-	balanceGroupLayout->addWidget(rechargeGroup);
-	accountLayout->addWidget(balanceGroup);
-	accountLayout->addStretch();
+	// 填充列车数据
+	updateAdminTrainTable(session);
+	layout->addWidget(session.adminTrainTable);
 	
-	tabWidget->addTab(accountTab, "账户管理");
+	// 按钮布局
+	QHBoxLayout* buttonLayout = new QHBoxLayout();
 	
-	layout->addWidget(tabWidget);
+	QPushButton* suspendBtn = new QPushButton("停开列车");
+	suspendBtn->setStyleSheet("QPushButton { background-color: #e74c3c; color: white; border: none; padding: 10px 20px; font-size: 14px; border-radius: 5px; }"
+							 "QPushButton:hover { background-color: #c0392b; }");
+	buttonLayout->addWidget(suspendBtn);
+	
+	QPushButton* resumeBtn = new QPushButton("复开列车");
+	resumeBtn->setStyleSheet("QPushButton { background-color: #27ae60; color: white; border: none; padding: 10px 20px; font-size: 14px; border-radius: 5px; }"
+							"QPushButton:hover { background-color: #229954; }");
+	buttonLayout->addWidget(resumeBtn);
 	
-	// 退出登录按钮
 	QPushButton* logoutBtn = new QPushButton("退出登录");
-	logoutBtn->setStyleSheet("QPushButton { font-size: 14px; padding: 8px; margin: 5px; }");
-	layout->addWidget(logoutBtn);
+	logoutBtn->setStyleSheet("QPushButton { background-color: #95a5a6; color: white; border: none; padding: 10px 20px; font-size: 14px; border-radius: 5px; }"
+							"QPushButton:hover { background-color: #7f8c8d; }");
+	buttonLayout->addWidget(logoutBtn);
 	
-	// 查询按钮事件
-	QObject::connect(searchBtn, &QPushButton::clicked, [fromEdit, toEdit, hourEdit, minuteEdit]() {
-		QString startStation = fromEdit->text().trimmed();
-		QString endStation = toEdit->text().trimmed();
-		QString hourText = hourEdit->text().trimmed();
-		QString minuteText = minuteEdit->text().trimmed();
+	layout->addLayout(buttonLayout);
+	
+	// 停开列车按钮事件
+	QObject::connect(suspendBtn, &QPushButton::clicked, [&session, mainWindow]() {
+		int currentRow = session.adminTrainTable->currentRow();
+		if (currentRow < 0) {
+			QMessageBox::warning(mainWindow, "提示", "请先选择一个列车!");
+			return;
+		}
 		
-		if (startStation.isEmpty() || endStation.isEmpty()) {
-			QMessageBox::warning(nullptr, "提示", "请输入出发站和到达站!");
+		QString trainNumber = session.adminTrainTable->item(currentRow, 0)->text();
+		string trainNumberStr = trainNumber.toStdString();
+		
+		// 检查是否已经停开
+		if (isTrainSuspended(trainNumberStr)) {
+			QMessageBox::information(mainWindow, "提示", "该列车已经停开!");
 			return;
 		}
 		
-		QString departureTime = "";
+		// 确认停开
+		int ret = QMessageBox::question(mainWindow, "确认", 
+			QString("确定要停开列车 %1 吗？\n停开后该列车将无法被用户查询和购票。").arg(trainNumber),
+			QMessageBox::Yes | QMessageBox::No);
 		
-		// 验证时间输入（如果用户输入了时间）
-		if (!hourText.isEmpty() || !minuteText.isEmpty()) {
-			// 如果只输入了其中一个，提示用户
-			if (hourText.isEmpty() || minuteText.isEmpty()) {
-				QMessageBox::warning(nullptr, "提示", "请输入完整的时间（小时和分钟）或留空不限制时间");
-				return;
-			}
-			
-			bool hourOk, minuteOk;
-			int hour = hourText.toInt(&hourOk);
-			int minute = minuteText.toInt(&minuteOk);
-			
-			if (!hourOk || !minuteOk || hour < 0 || hour > 23 || minute < 0 || minute > 59) {
-				QMessageBox::warning(nullptr, "提示", "请输入有效的时间\n小时：0-23\n分钟：0-59");
+		if (ret == QMessageBox::Yes) {
+			if (!setTrainSuspended(trainNumberStr, true)) {
+				QMessageBox::warning(mainWindow, "错误", "保存停开状态失败!");
 				return;
 			}
-			
-			// 格式化时间为HH:MM
-			departureTime = QString("%1:%2")
-				.arg(hour, 2, 10, QChar('0'))
-				.arg(minute, 2, 10, QChar('0'));
+			// 其他管理员窗口的列车表一起更新
+			sessionManager.forEach(updateAdminTrainTable);
+			QMessageBox::information(mainWindow, "成功", QString("列车 %1 已停开!").arg(trainNumber));
 		}
-		
-		currentStartStation = startStation.toStdString();
-		currentEndStation = endStation.toStdString();
-		currentDepartureTimeFilter = departureTime.toStdString();
-		updateTicketTable(startStation, endStation, departureTime);
 	});
 	
-	// 购票按钮事件
-	QObject::connect(buyBtn, &QPushButton::clicked, [mainWindow]() {
-		int currentRow = ticketTable->currentRow();
+	// 复开列车按钮事件
+	QObject::connect(resumeBtn, &QPushButton::clicked, [&session, mainWindow]() {
+		int currentRow = session.adminTrainTable->currentRow();
 		if (currentRow < 0) {
-			QMessageBox::warning(mainWindow, "提示", "请选择要购买的车票!");
-			return;
-		}
-		
-		if (currentStartStation.empty() || currentEndStation.empty()) {
-			QMessageBox::warning(mainWindow, "提示", "请先查询车票!");
+			QMessageBox::warning(mainWindow, "提示", "请先选择一个列车!");
 			return;
 		}
 		
-		if (!currentUser) {
-			QMessageBox::warning(mainWindow, "错误", "用户未登录!");
-			return;
-		}
+		QString trainNumber = session.adminTrainTable->item(currentRow, 0)->text();
+		string trainNumberStr = trainNumber.toStdString();
 		
-		// 检查表格项是否存在
-		QTableWidgetItem* item = ticketTable->item(currentRow, 0);
-		if (!item) {
-			QMessageBox::warning(mainWindow, "错误", "获取车次信息失败!");
+		// 检查是否已经停开
+		if (!isTrainSuspended(trainNumberStr)) {
+			QMessageBox::information(mainWindow, "提示", "该列车正在正常运行!");
 			return;
 		}
 		
-		QString trainNumber = item->text();
-		
-		// 查找列车并购票
-		auto trainIt = find_if(trains.begin(), trains.end(),
-			[trainNumber](const Train& t) { return QString::fromStdString(t.trainNumber) == trainNumber; });
+		// 确认复开
+		int ret = QMessageBox::question(mainWindow, "确认", 
+			QString("确定要复开列车 %1 吗？\n复开后该列车将恢复正常运行。").arg(trainNumber),
+			QMessageBox::Yes | QMessageBox::No);
 		
-		if (trainIt != trains.end()) {
-			string start = currentStartStation;
-			string end = currentEndStation;
-			
-			auto startIt = find_if(trainIt->stations.begin(), trainIt->stations.end(),
-				[&start](const string& station) { return station == start; });
-			auto endIt = find_if(trainIt->stations.begin(), trainIt->stations.end(),
-				[&end](const string& station) { return station == end; });
-			
-			if (startIt != trainIt->stations.end() && endIt != trainIt->stations.end() && startIt != endIt) {
-				size_t startIdx = distance(trainIt->stations.begin(), startIt);
-				size_t endIdx = distance(trainIt->stations.begin(), endIt);
-				
-				// 确保索引顺序正确（小的在前，大的在后）
-				size_t fromIdx = min(startIdx, endIdx);
-				size_t toIdx = max(startIdx, endIdx);
-				
-				// 安全检查数组边界
-				if (fromIdx < trainIt->segmentAvailableSeats.size() && 
-					fromIdx < trainIt->priceMatrix.size() &&
-					toIdx < trainIt->segmentAvailableSeats[fromIdx].size() &&
-					toIdx < trainIt->priceMatrix[fromIdx].size() &&
-					trainIt->segmentAvailableSeats[fromIdx][toIdx] > 0) {
-					
-					int ticketPrice = trainIt->priceMatrix[fromIdx][toIdx];
-					
-					// 检查余额是否足够
-					if (currentUser->balance < ticketPrice) {
-						QMessageBox::warning(mainWindow, "余额不足", 
-							QString("购票失败！\n票价: ¥%1\n当前余额: ¥%2\n需要充值: ¥%3")
-							.arg(ticketPrice)
-							.arg(QString::number(currentUser->balance, 'f', 2))
-							.arg(QString::number(ticketPrice - currentUser->balance, 'f', 2)));
-						return;
-					}
-					
-					// 扣除余额
-					currentUser->balance -= ticketPrice;
-					saveUsersToDB();
-					updateBalanceDisplay();
-					
-					// 创建行程记录（只保存起点和终点）
-					vector<string> tripStations;
-					vector<string> tripArrivalTimes;
-					
-					// 只保存起点和终点站
-					tripStations.push_back(trainIt->stations[startIdx]);
-					tripStations.push_back(trainIt->stations[endIdx]);
-					
-					// 为行程生成适当的时刻表
-					vector<string> fullSchedule = getDirectionalSchedule(trainIt->arrivalTimes, startIdx, endIdx);
-					tripArrivalTimes.push_back(fullSchedule[startIdx]);
-					tripArrivalTimes.push_back(fullSchedule[endIdx]);
-					
-					// 创建简化的价格矩阵（只包含起点到终点的价格）
-					vector<vector<int>> tripSegmentAvailableSeats(2, vector<int>(2, 0));
-					vector<vector<int>> tripPriceMatrix(2, vector<int>(2, 0));
-					
-					// 设置从起点到终点的价格
-					size_t fromIdx = min(startIdx, endIdx);
-					size_t toIdx = max(startIdx, endIdx);
-					tripPriceMatrix[0][1] = trainIt->priceMatrix[fromIdx][toIdx];
-					tripSegmentAvailableSeats[0][1] = trainIt->segmentAvailableSeats[fromIdx][toIdx];
-					
-					Train tripRecord(trainNumber.toStdString(), tripStations, tripArrivalTimes, tripSegmentAvailableSeats, tripPriceMatrix);
-					currentUser->trips.push_back(tripRecord);
-					
-					// 保存用户数据（包括新购买的车票）
-					saveUsersToDB();
-					
-					// 更新余票
-					trainIt->segmentAvailableSeats[fromIdx][toIdx]--;
-					saveTrainsToDB();
-					
-					QMessageBox::information(mainWindow, "购票成功", 
-						QString("购票成功！\n车次: %1\n从 %2 到 %3\n票价: ¥%4\n剩余余额: ¥%5")
-						.arg(trainNumber)
-						.arg(QString::fromStdString(currentStartStation))
-						.arg(QString::fromStdString(currentEndStation))
-						.arg(ticketPrice)
-						.arg(QString::number(currentUser->balance, 'f', 2)));
-					
-					// 刷新表格
-					updateTicketTable(QString::fromStdString(currentStartStation), QString::fromStdString(currentEndStation), QString::fromStdString(currentDepartureTimeFilter));
-					updateMyTripsTable();
-				} else {
-					QMessageBox::warning(mainWindow, "错误", "该区间已无余票或数据错误!");
-				}
-			} else {
-				QMessageBox::warning(mainWindow, "错误", "站点信息错误!");
+		if (ret == QMessageBox::Yes) {
+			if (!setTrainSuspended(trainNumberStr, false)) {
+				QMessageBox::warning(mainWindow, "错误", "保存复开状态失败!");
+				return;
 			}
-		} else {
-			QMessageBox::warning(mainWindow, "错误", "未找到该车次!");
+			sessionManager.forEach(updateAdminTrainTable);
+			QMessageBox::information(mainWindow, "成功", QString("列车 %1 已复开!").arg(trainNumber));
 		}
 	});
 	
-	// 退票按钮事件
-	QObject::connect(cancelBtn, &QPushButton::clicked, [mainWindow]() {
-		int currentRow = myTripsTable->currentRow();
-		if (currentRow < 0) {
-			QMessageBox::warning(mainWindow, "提示", "请选择要退订的车票!");
-			return;
+	// 退出登录按钮事件
+	QObject::connect(logoutBtn, &QPushButton::clicked, [&session]() {
+		session.admin = nullptr;
+		session.stackedWidget->setCurrentWidget(session.startMenuWidget);
+	});
+	
+	return widget;
+}
+
+// 打开一个售票窗口：创建会话和窗口中的全部界面，窗口关闭时结束会话
+Session& openSessionWindow() {
+	Session& session = sessionManager.open();
+	session.window = new QMainWindow();
+	session.window->setAttribute(Qt::WA_DeleteOnClose);
+	session.window->setWindowTitle(QString("列车购票系统 - 窗口%1").arg(session.id));
+	session.window->setMinimumSize(1000, 700);
+	int sessionId = session.id;
+	QObject::connect(session.window, &QObject::destroyed, [sessionId]() {
+		sessionManager.close(sessionId);
+	});
+	
+	// 创建堆叠窗口部件
+	session.stackedWidget = new QStackedWidget(session.window);
+	session.window->setCentralWidget(session.stackedWidget);
+	
+	// 创建所有界面
+	session.startMenuWidget = createStartMenuWidget(session);
+	session.loginWidget = createLoginWidget(session);
+	session.registerWidget = createRegisterWidget(session);
+	session.adminLoginWidget = createAdminLoginWidget(session);
+	session.adminRegisterWidget = createAdminRegisterWidget(session);
+	session.mainMenuWidget = createMainMenuWidget(session);
+	session.adminMenuWidget = createAdminMenuWidget(session);
+	
+	// 添加到堆叠窗口
+	session.stackedWidget->addWidget(session.startMenuWidget);
+	session.stackedWidget->addWidget(session.loginWidget);
+	session.stackedWidget->addWidget(session.registerWidget);
+	session.stackedWidget->addWidget(session.adminLoginWidget);
+	session.stackedWidget->addWidget(session.adminRegisterWidget);
+	session.stackedWidget->addWidget(session.mainMenuWidget);
+	session.stackedWidget->addWidget(session.adminMenuWidget);
+	
+	// 显示开始菜单界面
+	session.stackedWidget->setCurrentWidget(session.startMenuWidget);
+	session.window->show();
+	return session;
+}
+
+int main(int argc, char *argv[]) {
+	QApplication app(argc, argv);
+	
+	// 命令行参数 --record 录制文件：把界面上的操作录制下来，供无界面服务回放（加载数据后开始录制）
+	QStringList args = app.arguments();
+	int recordArg = args.indexOf("--record");
+	// 命令行参数 --fare-per-km 每公里票价（默认0.5元）
+	int fareArg = args.indexOf("--fare-per-km");
+	if (fareArg > 0 && fareArg + 1 < args.size()) {
+		setFarePerKm(args[fareArg + 1].toDouble());
+	}
+	// 命令行参数 --shards 分片数：余票和车票按车次分到多个数据库文件
+	int shardArg = args.indexOf("--shards");
+	int shards = shardArg > 0 && shardArg + 1 < args.size() ? args[shardArg + 1].toInt() : 0;
+	// 命令行参数 --windows 窗口数：启动时打开多个售票窗口（默认1个，之后可在开始菜单新建）
+	int windowsArg = args.indexOf("--windows");
+	int windows = windowsArg > 0 && windowsArg + 1 < args.size() ? max(1, args[windowsArg + 1].toInt()) : 1;
+	// 命令行参数 --shared-inventory 名称：与同名的其他进程共享余票
+	int sharedArg = args.indexOf("--shared-inventory");
+	string sharedName = sharedArg > 0 && sharedArg + 1 < args.size() ? args[sharedArg + 1].toStdString() : "";
+	
+	// 初始化数据库
+	if (!initDatabase()) {
+		QMessageBox::critical(nullptr, "数据库错误", "无法初始化数据库，程序将退出");
+		return -1;
+	}
+	
+	// 迁移现有文件数据到数据库
+	migrateDataFromFiles();
+	if (!restoreSeatTemplates()) {
+		QMessageBox::critical(nullptr, "数据库错误", "无法迁移旧版本的余票，程序将退出");
+		return -1;
+	}
+	if (!startShardWriters(shards)) {
+		QMessageBox::critical(nullptr, "数据库错误", "无法初始化存储分片，程序将退出");
+		return -1;
+	}
+	
+	// 路网地图：计算站间里程，用于按里程计价
+	if (!loadStationMap("map.txt") && !loadStationMap("data/map.txt")) {
+		cout << "未找到路网地图 map.txt，票价使用各车次自带的票价矩阵" << endl;
+	}
+	
+	// 从数据库加载数据
+	currentServiceDay = todayServiceDay();
+	loadTrainsFromDB();
+	loadDatedSeatsFromDB();
+	loadUsersFromDB();
+	loadAdminsFromDB();
+	loadSuspendedTrainsFromDB();
+	if (!sharedName.empty() && !openSharedInventory(sharedName)) {
+		QMessageBox::critical(nullptr, "共享余票错误", "无法挂接共享余票，程序将退出");
+		stopShardWriters();
+		return -1;
+	}
+	if (recordArg > 0 && recordArg + 1 < args.size()) {
+		startWorkloadRecording(args[recordArg + 1].toStdString());
+	}
+	
+	// 添加调试信息
+	cout << "加载了 " << trains.size() << " 条列车数据" << endl;
+	for (const auto& train : trains) {
+		cout << "车次: " << train.trainNumber << ", 站点数: " << train.stations.size() << endl;
+		cout << "站点: ";
+		for (const auto& station : train.stations) {
+			cout << station << " ";
 		}
+		cout << endl;
+	}
+	
+	// 购票、退票等操作后按变更事件局部更新各窗口的表格
+	addChangeListener(applyChangeToViews);
+	
+	// 打开售票窗口，每个窗口是一个独立会话，共享同一份数据
+	for (int i = 0; i < windows; ++i) {
+		openSessionWindow();
+	}
+	
+	// 每秒推进一次座位预留时间轮，释放超时未支付的预留；跨天时滚动预售期；拉取并落盘共享余票
+	QTimer holdTimer;
+	QObject::connect(&holdTimer, &QTimer::timeout, []() {
+		advanceSeatHolds();
+		if (rollSalesWindow()) {
+			sessionManager.forEach(refreshDateCombo);
+		}
+		tickSharedInventory();
+	});
+	holdTimer.start(1000);
+	
+	int exitCode = app.exec();
+	closeSharedInventory(); // 归还本进程的预留，协调进程把余票落盘
+	stopShardWriters();
+	return exitCode;
+}
+#endif
+
+#ifdef RAILWAY_HEADLESS
+// ==================== 无界面 HTTP/JSON 服务 ====================
+// 主线程运行事件循环：监听端口、读写所有连接，并执行会修改数据的请求（购票、退票、充值），
+// 数据库连接只在主线程使用。查票和登录是只读请求，交给线程池中的工作线程并发执行。
+// 内存数据用读写锁保护：登录在工作线程中持共享锁读取用户，主线程修改数据时持独占锁；
+// 查票不取这把锁，读的是主线程发布的库存快照（见下文）。
+//
+// 接口（请求和响应均为 JSON，需要登录的接口在请求头中携带 Authorization: Bearer <token>）：
+//   POST /api/login     {"phone", "password"}                         -> {"token", "name", "balance"}
+//   GET  /api/search    ?from=&to=&date=yyyy-MM-dd&time=HH:MM&sort=price|departure|arrival|duration|seats&page=&pageSize=
+//   POST /api/book      {"train", "from", "to", "date", "count", "class"} 或 {"legs": [...]}  -> {"tickets": [车票编号...]}
+//   POST /api/refund    {"ticket"} 或 {"train", "date"}
+//   POST /api/recharge  {"amount"}
+// 业务失败（余票不足、余额不足等）返回 200 且 success 为 false；请求格式错误返回 4xx。
+
+shared_mutex engineMutex;    // 保护列车、用户、余票和预留等内存数据
+mutex searchCacheMutex;      // 查票缓存会被多个工作线程同时修改，单独加锁
+mutex apiSessionMutex;
+unordered_map<string, int> apiSessions; // 会话令牌 -> 用户ID
+
+// ---- 查票快照 ----
+// 主线程每次修改数据后发布一份不可变的库存快照（版本号递增），通过 shared_ptr 的原子替换公开；
+// 查票线程用 atomic_load 取得当前快照后在上面查票，不持任何锁，购票等写操作可同时进行。
+// 旧快照在最后一个读者释放指针后自动回收。
+// 快照按车次分块共享：发布时只复制版本号变化的车次及其所在的块，其余块沿用上一份快照的指针，
+// 一次购票的发布开销与车次总数基本无关。列车的站点、时刻、编组和票价在服务运行期间不变，直接读 trains。
+const size_t SNAPSHOT_CHUNK_TRAINS = 256;
+
+// 单个车次在快照中的状态（不含座位位图，查票用不到）
+struct TrainSnapshot {
+	unsigned version = 0;
+	bool suspended = false;
+	vector<ServiceDaySeats> slots;
+};
+
+using TrainSnapshotChunk = vector<shared_ptr<const TrainSnapshot>>;
+
+// 与 LiveInventory 接口相同，供 computeTicketResults 和缓存校验使用
+struct InventorySnapshot {
+	unsigned long long sequence = 0; // 快照版本号，每次发布加一
+	unsigned fleetEpoch = 0;
+	int today = 0;
+	size_t trains = 0;
+	shared_ptr<const TrainColumns> trainColumns; // 发布时的列存车次表
+	vector<shared_ptr<const TrainSnapshotChunk>> chunks;
+	
+	const TrainSnapshot& train(size_t trainIdx) const {
+		return *(*chunks[trainIdx / SNAPSHOT_CHUNK_TRAINS])[trainIdx % SNAPSHOT_CHUNK_TRAINS];
+	}
+	unsigned epoch() const { return fleetEpoch; }
+	int serviceDay() const { return today; }
+	size_t trainCount() const { return trains; }
+	unsigned version(size_t trainIdx) const { return train(trainIdx).version; }
+	bool suspended(size_t trainIdx) const { return train(trainIdx).suspended; }
+	const vector<ServiceDaySeats>& slots(size_t trainIdx) const { return train(trainIdx).slots; }
+	const TrainColumns& columns() const { return *trainColumns; }
+};
+
+shared_ptr<const InventorySnapshot> inventorySnapshot; // 只通过 atomic_load / atomic_store 访问
+
+// 复制一个车次的当前状态
+shared_ptr<const TrainSnapshot> makeTrainSnapshot(size_t trainIdx) {
+	auto snapshot = make_shared<TrainSnapshot>();
+	snapshot->version = trainVersions[trainIdx];
+	snapshot->suspended = suspendedBitmap[trainIdx];
+	snapshot->slots.resize(SALES_WINDOW_DAYS);
+	for (int i = 0; i < SALES_WINDOW_DAYS; ++i) {
+		const ServiceDaySeats& slot = datedInventory[trainIdx][i];
+		if (slot.day >= 0) {
+			snapshot->slots[i].day = slot.day;
+			snapshot->slots[i].seats = slot.seats;
+			snapshot->slots[i].loadPercent = slot.loadPercent;
+		}
+	}
+	return snapshot;
+}
+
+// 发布新快照（主线程在修改数据之后调用，调用者需持有 engineMutex 独占锁）。
+// 列车数据重新加载或跨天时整份重建，否则只复制版本号变化的车次
+void publishInventorySnapshot() {
+	shared_ptr<const InventorySnapshot> previous = atomic_load(&inventorySnapshot);
+	bool rebuild = !previous || previous->fleetEpoch != fleetEpoch || previous->today != currentServiceDay ||
+				   previous->trains != trains.size() || previous->trainColumns != trainColumns;
+	
+	auto next = make_shared<InventorySnapshot>();
+	next->sequence = previous ? previous->sequence + 1 : 1;
+	next->fleetEpoch = fleetEpoch;
+	next->today = currentServiceDay;
+	next->trains = trains.size();
+	next->trainColumns = trainColumns;
+	
+	size_t chunkCount = (trains.size() + SNAPSHOT_CHUNK_TRAINS - 1) / SNAPSHOT_CHUNK_TRAINS;
+	next->chunks.reserve(chunkCount);
+	bool changed = false;
+	for (size_t c = 0; c < chunkCount; ++c) {
+		size_t first = c * SNAPSHOT_CHUNK_TRAINS;
+		size_t last = min(trains.size(), first + SNAPSHOT_CHUNK_TRAINS);
 		
-		QString trainNumber = myTripsTable->item(currentRow, 0)->text();
-		
-		// 查找并删除行程
-		auto tripIt = find_if(currentUser->trips.begin(), currentUser->trips.end(),
-			[trainNumber](const Train& t) { return QString::fromStdString(t.trainNumber) == trainNumber; });
-		
-		if (tripIt != currentUser->trips.end()) {
-			// 获取行程的起点和终点站
-			string startStation = tripIt->stations.front();
-			string endStation = tripIt->stations.back();
-			
-			// 计算退款金额 - 只返还80%的票价
-			int originalPrice = 0;
-			if (!tripIt->priceMatrix.empty() && !tripIt->priceMatrix[0].empty()) {
-				originalPrice = tripIt->priceMatrix[0][tripIt->priceMatrix[0].size() - 1];
+		shared_ptr<TrainSnapshotChunk> chunk;
+		for (size_t i = first; i < last; ++i) {
+			if (!rebuild && previous->version(i) == trainVersions[i]) {
+				continue;
 			}
-			int refundAmount = static_cast<int>(originalPrice * 0.8); // 80%退款
-			
-			// 恢复余票
-			auto trainIt = find_if(trains.begin(), trains.end(),
-				[trainNumber](const Train& t) { return QString::fromStdString(t.trainNumber) == trainNumber; });
-			
-			if (trainIt != trains.end()) {
-				auto startIt = find_if(trainIt->stations.begin(), trainIt->stations.end(),
-					[&startStation](const string& station) { return station == startStation; });
-				auto endIt = find_if(trainIt->stations.begin(), trainIt->stations.end(),
-					[&endStation](const string& station) { return station == endStation; });
-				
-				if (startIt != trainIt->stations.end() && endIt != trainIt->stations.end()) {
-					size_t startIdx = distance(trainIt->stations.begin(), startIt);
-					size_t endIdx = distance(trainIt->stations.begin(), endIt);
-					size_t fromIdx = min(startIdx, endIdx);
-					size_t toIdx = max(startIdx, endIdx);
-					trainIt->segmentAvailableSeats[fromIdx][toIdx]++;
-				}
+			if (!chunk) {
+				chunk = rebuild ? make_shared<TrainSnapshotChunk>(last - first) : make_shared<TrainSnapshotChunk>(*previous->chunks[c]);
 			}
-			
-			// 退款到余额
-			currentUser->balance += refundAmount;
-			saveUsersToDB();
-			updateBalanceDisplay();
-			
-			currentUser->trips.erase(tripIt);
-			saveTrainsToDB();
-			
-			QMessageBox::information(mainWindow, "退票成功", 
-				QString("退票成功！\n原票价: ¥%1\n退款金额: ¥%2 (80%)\n当前余额: ¥%3")
-				.arg(originalPrice)
-				.arg(refundAmount)
-				.arg(QString::number(currentUser->balance, 'f', 2)));
-			updateMyTripsTable();
+			(*chunk)[i - first] = makeTrainSnapshot(i);
 		}
-	});
+		changed = changed || chunk;
+		next->chunks.push_back(chunk ? shared_ptr<const TrainSnapshotChunk>(chunk) : previous->chunks[c]);
+	}
 	
-	// 退出登录按钮事件
-	QObject::connect(logoutBtn, &QPushButton::clicked, []() {
-		currentUser = nullptr;
-		stackedWidget->setCurrentWidget(loginWidget);
-	});
+	// 没有任何变化时保留原快照（定时器每秒都会调用）
+	if (!rebuild && !changed) {
+		return;
+	}
+	atomic_store(&inventorySnapshot, shared_ptr<const InventorySnapshot>(std::move(next)));
+}
+
+// 取当前快照（任何线程都可调用，不加锁）
+shared_ptr<const InventorySnapshot> currentInventorySnapshot() {
+	return atomic_load(&inventorySnapshot);
+}
+
+const int MAX_HTTP_HEADER_BYTES = 16 * 1024;
+const int MAX_HTTP_BODY_BYTES = 64 * 1024;
+const int MAX_HTTP_BUFFER_BYTES = 4 * (MAX_HTTP_HEADER_BYTES + MAX_HTTP_BODY_BYTES); // 一个连接上未处理的数据上限（含流水线中排队的请求）
+const int MAX_API_PAGE_SIZE = 100;
+
+// HTTP 请求
+struct HttpRequest {
+	string method;
+	string path;
+	map<string, string> query;
+	map<string, string> headers; // 键为小写
+	QByteArray body;
+	bool keepAlive = true;
+};
+
+// HTTP 响应
+struct HttpResponse {
+	int status = 200;
+	QJsonObject body;
+};
+
+// 一个客户端连接：同一连接上的请求按顺序处理，响应写出前不解析下一个请求
+struct HttpConnection {
+	QTcpSocket* socket = nullptr;
+	QByteArray buffer;
+	bool busy = false;
+	bool closing = false; // 已发出最后一个响应，之后收到的数据丢弃
+};
+
+unordered_map<unsigned long long, HttpConnection> httpConnections; // 只在主线程访问
+unsigned long long nextConnectionId = 1;
+
+// 辅助函数：URL 解码（'+' 视为空格）
+string urlDecode(const QByteArray& value) {
+	QByteArray plus = value;
+	plus.replace('+', ' ');
+	return QUrl::fromPercentEncoding(plus).toStdString();
+}
+
+// 解析缓冲区开头的一个请求：返回消耗的字节数，数据不完整返回0，格式错误返回-1
+int parseHttpRequest(const QByteArray& buffer, HttpRequest& request) {
+	int headerEnd = buffer.indexOf("\r\n\r\n");
+	if (headerEnd < 0) {
+		return buffer.size() > MAX_HTTP_HEADER_BYTES ? -1 : 0;
+	}
+	if (headerEnd > MAX_HTTP_HEADER_BYTES) {
+		return -1;
+	}
 	
-	// 充值按钮事件
-	QObject::connect(rechargeBtn, &QPushButton::clicked, [mainWindow]() {
-		if (!currentUser) {
-			QMessageBox::warning(mainWindow, "错误", "用户未登录!");
-			return;
+	QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+	QList<QByteArray> requestLine = lines[0].trimmed().split(' ');
+	if (requestLine.size() != 3) {
+		return -1;
+	}
+	request.method = requestLine[0].toStdString();
+	QByteArray version = requestLine[2];
+	
+	QByteArray target = requestLine[1];
+	int queryStart = target.indexOf('?');
+	request.path = urlDecode(queryStart < 0 ? target : target.left(queryStart));
+	if (queryStart >= 0) {
+		for (const QByteArray& pair : target.mid(queryStart + 1).split('&')) {
+			if (pair.isEmpty()) continue;
+			int eq = pair.indexOf('=');
+			string key = urlDecode(eq < 0 ? pair : pair.left(eq));
+			request.query[key] = eq < 0 ? "" : urlDecode(pair.mid(eq + 1));
+		}
+	}
+	
+	for (int i = 1; i < lines.size(); ++i) {
+		int colon = lines[i].indexOf(':');
+		if (colon <= 0) continue;
+		string name = toLowerCase(lines[i].left(colon).trimmed().toStdString());
+		request.headers[name] = lines[i].mid(colon + 1).trimmed().toStdString();
+	}
+	
+	// HTTP/1.1 默认保持连接，HTTP/1.0 默认关闭
+	string connection = toLowerCase(request.headers["connection"]);
+	request.keepAlive = version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+	
+	int contentLength = 0;
+	auto lengthIt = request.headers.find("content-length");
+	if (lengthIt != request.headers.end()) {
+		try {
+			contentLength = stoi(lengthIt->second);
+		} catch (const exception& e) {
+			return -1;
 		}
-		
-		QString amountText = rechargeAmountEdit->text().trimmed();
-		if (amountText.isEmpty()) {
-			QMessageBox::warning(mainWindow, "提示", "请输入充值金额!");
-			return;
+		if (contentLength < 0 || contentLength > MAX_HTTP_BODY_BYTES) {
+			return -1;
 		}
-		
-		bool ok;
-		double amount = amountText.toDouble(&ok);
-		if (!ok || amount <= 0) {
-			QMessageBox::warning(mainWindow, "错误", "请输入有效的充值金额!");
-			return;
+	}
+	
+	int total = headerEnd + 4 + contentLength;
+	if (buffer.size() < total) {
+		return 0;
+	}
+	request.body = buffer.mid(headerEnd + 4, contentLength);
+	return total;
+}
+
+// 生成完整的 HTTP 响应报文
+QByteArray buildHttpResponse(const HttpResponse& response, bool keepAlive) {
+	const char* reason = "OK";
+	switch (response.status) {
+		case 400: reason = "Bad Request"; break;
+		case 401: reason = "Unauthorized"; break;
+		case 404: reason = "Not Found"; break;
+		case 405: reason = "Method Not Allowed"; break;
+		case 413: reason = "Payload Too Large"; break;
+		case 500: reason = "Internal Server Error"; break;
+	}
+	
+	QByteArray body = QJsonDocument(response.body).toJson(QJsonDocument::Compact);
+	QByteArray out = "HTTP/1.1 " + QByteArray::number(response.status) + " " + reason + "\r\n";
+	out += "Content-Type: application/json; charset=utf-8\r\n";
+	out += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+	out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+	out += body;
+	return out;
+}
+
+HttpResponse jsonResult(bool success, const string& message, int status = 200) {
+	HttpResponse response;
+	response.status = status;
+	response.body["success"] = success;
+	response.body["message"] = QString::fromStdString(message);
+	return response;
+}
+
+// 解析请求体 JSON，失败时 error 中给出 400 响应
+bool parseJsonBody(const HttpRequest& request, QJsonObject& body, HttpResponse& error) {
+	QJsonParseError parseError;
+	QJsonDocument doc = QJsonDocument::fromJson(request.body, &parseError);
+	if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+		error = jsonResult(false, "请求体不是有效的 JSON 对象", 400);
+		return false;
+	}
+	body = doc.object();
+	return true;
+}
+
+// 按请求头中的令牌找到已登录用户（调用者需持有 engineMutex）
+User* authenticate(const HttpRequest& request) {
+	auto authIt = request.headers.find("authorization");
+	if (authIt == request.headers.end() || authIt->second.compare(0, 7, "Bearer ") != 0) {
+		return nullptr;
+	}
+	
+	int userId = -1;
+	{
+		lock_guard<mutex> lock(apiSessionMutex);
+		auto sessionIt = apiSessions.find(authIt->second.substr(7));
+		if (sessionIt == apiSessions.end()) {
+			return nullptr;
 		}
-		
-		if (amount > 10000) {
-			QMessageBox::warning(mainWindow, "错误", "单次充值金额不能超过¥10000!");
-			return;
+		userId = sessionIt->second;
+	}
+	
+	auto userIt = find_if(users.begin(), users.end(), [userId](const User& u) { return u.id == userId; });
+	return userIt == users.end() ? nullptr : &*userIt;
+}
+
+// 查票（可在工作线程中调用，不需要 engineMutex）：在给定的快照上查票，
+// 缓存条目按快照中的车次版本校验。缓存查找和写入在缓存锁内进行，计算结果时不持缓存锁，多个工作线程可以同时计算。
+// 临时数据和返回的行都从 resource（调用者的查票内存池）分配
+TicketPage searchTicketPageConcurrent(const InventorySnapshot& snapshot, string_view start, string_view end,
+									  string_view departureTimeFilter, int day,
+									  TicketSortKey sortKey, size_t page, size_t pageSize, pmr::memory_resource* resource) {
+	recordSearchEvent(start, end, departureTimeFilter, day, static_cast<int>(sortKey), page, pageSize);
+	pmr::string key = makeSearchCacheKey(start, end, departureTimeFilter, day, resource);
+	{
+		lock_guard<mutex> lock(searchCacheMutex);
+		if (SearchCacheEntry* cached = findSearchCacheEntry(key, snapshot)) {
+			return pageTicketResults(cached->results.data(), cached->results.size(), sortKey, page, pageSize, resource);
 		}
-		
-		currentUser->balance += amount;
-		saveUsersToDB();
-		updateBalanceDisplay();
-		rechargeAmountEdit->clear();
-		
-		QMessageBox::information(mainWindow, "充值成功", 
-			QString("充值成功！\n充值金额: ¥%1\n当前余额: ¥%2")
-			.arg(QString::number(amount, 'f', 2))
-			.arg(QString::number(currentUser->balance, 'f', 2)));
-	});
+	}
 	
-	return widget;
+	pmr::vector<TicketResult> results(resource);
+	pmr::vector<pair<size_t, unsigned>> candidateVersions(resource);
+	computeTicketResults(snapshot, start, end, departureTimeFilter, day, results, candidateVersions);
+	TicketPage result = pageTicketResults(results.data(), results.size(), sortKey, page, pageSize, resource);
+	SearchCacheEntry entry = makeSearchCacheEntry(key, snapshot.fleetEpoch, results, candidateVersions);
+	
+	lock_guard<mutex> lock(searchCacheMutex);
+	storeSearchCacheEntry(std::move(entry));
+	return result;
 }
 
-// 创建管理员主菜单界面
-QWidget* createAdminMenuWidget(QMainWindow* mainWindow) {
-	QWidget* widget = new QWidget();
-	QVBoxLayout* layout = new QVBoxLayout(widget);
-	layout->setSpacing(20);
-	layout->setContentsMargins(30, 30, 30, 30);
+// POST /api/login
+HttpResponse handleLogin(const HttpRequest& request) {
+	HttpResponse error;
+	QJsonObject body;
+	if (!parseJsonBody(request, body, error)) {
+		return error;
+	}
+	string phone = body["phone"].toString().toStdString();
+	string password = body["password"].toString().toStdString();
 	
-	// 标题
-	QLabel* titleLabel = new QLabel("管理员控制台");
-	titleLabel->setAlignment(Qt::AlignCenter);
-	titleLabel->setStyleSheet("font-size: 24px; font-weight: bold; color: #e74c3c; margin-bottom: 20px;");
-	layout->addWidget(titleLabel);
+	auto it = find_if(users.begin(), users.end(), [&phone](const User& u) { return u.phoneNumber == phone; });
+	if (it == users.end() || it->password != password) {
+		return jsonResult(false, "手机号或密码错误", 401);
+	}
 	
-	// 创建列车管理表格
-	adminTrainTable = new QTableWidget();
-	adminTrainTable->setColumnCount(3);
-	QStringList headers = {"车次", "路线", "状态"};
-	adminTrainTable->setHorizontalHeaderLabels(headers);
+	string token = QUuid::createUuid().toString(QUuid::WithoutBraces).toStdString();
+	{
+		lock_guard<mutex> lock(apiSessionMutex);
+		apiSessions[token] = it->id;
+	}
 	
-	// 设置表格样式
-	adminTrainTable->setStyleSheet(
-		"QTableWidget { gridline-color: #bdc3c7; font-size: 12px; }"
-		"QTableWidget::item { padding: 8px; }"
-		"QHeaderView::section { background-color: #34495e; color: white; padding: 8px; font-weight: bold; }"
-	);
+	HttpResponse response = jsonResult(true, "登录成功");
+	response.body["token"] = QString::fromStdString(token);
+	response.body["name"] = QString::fromStdString(it->name);
+	response.body["balance"] = it->balance;
+	return response;
+}
+
+// GET /api/search
+HttpResponse handleSearch(const HttpRequest& request) {
+	auto param = [&request](const string& name) {
+		auto it = request.query.find(name);
+		return it == request.query.end() ? string() : it->second;
+	};
 	
-	adminTrainTable->horizontalHeader()->setStretchLastSection(true);
-	adminTrainTable->setSelectionBehavior(QAbstractItemView::SelectRows);
-	adminTrainTable->setAlternatingRowColors(true);
+	string start = trim(param("from"));
+	string end = trim(param("to"));
+	if (start.empty() || end.empty()) {
+		return jsonResult(false, "缺少 from 或 to 参数", 400);
+	}
 	
-	// 填充列车数据
-	auto updateAdminTrainTable = [&]() {
-		adminTrainTable->setRowCount(trains.size());
-		for (size_t i = 0; i < trains.size(); ++i) {
-			const auto& train = trains[i];
-			
-			// 车次
-			adminTrainTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(train.trainNumber)));
-			
-			// 路线
-			QString route = QString::fromStdString(train.stations.front()) + " -> " + QString::fromStdString(train.stations.back());
-			adminTrainTable->setItem(i, 1, new QTableWidgetItem(route));
-			
-			// 状态
-			bool isSuspended = find(suspendedTrains.begin(), suspendedTrains.end(), train.trainNumber) != suspendedTrains.end();
-			QString status = isSuspended ? "停开" : "正常";
-			QTableWidgetItem* statusItem = new QTableWidgetItem(status);
-			if (isSuspended) {
-				statusItem->setBackground(QBrush(QColor(231, 76, 60, 100))); // 红色背景
-			} else {
-				statusItem->setBackground(QBrush(QColor(46, 204, 113, 100))); // 绿色背景
-			}
-			adminTrainTable->setItem(i, 2, statusItem);
-		}
+	shared_ptr<const InventorySnapshot> snapshot = currentInventorySnapshot();
+	int today = snapshot->today;
+	int day = param("date").empty() ? today : parseServiceDay(param("date"));
+	if (day < today || day >= today + SALES_WINDOW_DAYS) {
+		return jsonResult(false, "乘车日期不在预售期内", 400);
+	}
+	
+	string departureTime = param("time");
+	if (!departureTime.empty() && timeToMinutes(departureTime) < 0) {
+		return jsonResult(false, "出发时间格式应为 HH:MM", 400);
+	}
+	
+	static const map<string, TicketSortKey> sortKeys = {
+		{"price", TicketSortKey::Price},
+		{"departure", TicketSortKey::DepartureTime},
+		{"arrival", TicketSortKey::ArrivalTime},
+		{"duration", TicketSortKey::TravelTime},
+		{"seats", TicketSortKey::Seats}
 	};
+	TicketSortKey sortKey = TicketSortKey::Price;
+	if (!param("sort").empty()) {
+		auto sortIt = sortKeys.find(param("sort"));
+		if (sortIt == sortKeys.end()) {
+			return jsonResult(false, "未知的排序方式", 400);
+		}
+		sortKey = sortIt->second;
+	}
 	
-	updateAdminTrainTable();
-	layout->addWidget(adminTrainTable);
+	int page = 0;
+	int pageSize = static_cast<int>(TICKET_PAGE_SIZE);
+	try {
+		if (!param("page").empty()) page = stoi(param("page"));
+		if (!param("pageSize").empty()) pageSize = stoi(param("pageSize"));
+	} catch (const exception& e) {
+		return jsonResult(false, "page 或 pageSize 不是整数", 400);
+	}
+	if (page < 0 || pageSize <= 0 || pageSize > MAX_API_PAGE_SIZE) {
+		return jsonResult(false, "page 或 pageSize 超出范围", 400);
+	}
 	
-	// 按钮布局
-	QHBoxLayout* buttonLayout = new QHBoxLayout();
+	SearchArena arena;
+	TicketPage result = searchTicketPageConcurrent(*snapshot, start, end, departureTime, day, sortKey, page, pageSize, arena.get());
+	
+	QJsonArray rows;
+	for (const auto& ticket : result.rows) {
+		const Train& train = trains[ticket.trainIdx];
+		QJsonObject row;
+		row["train"] = QString::fromStdString(train.trainNumber);
+		row["from"] = QString::fromStdString(train.stations[ticket.startIdx]);
+		row["to"] = QString::fromStdString(train.stations[ticket.endIdx]);
+		row["departure"] = QString::fromStdString(minutesToTime(ticket.departureMinutes));
+		row["arrival"] = QString::fromStdString(minutesToTime(ticket.arrivalMinutes));
+		row["travelMinutes"] = ticket.travelMinutes;
+		row["seats"] = ticket.availableSeats;
+		row["price"] = ticket.price;
+		rows.append(row);
+	}
 	
-	QPushButton* suspendBtn = new QPushButton("停开列车");
-	suspendBtn->setStyleSheet("QPushButton { background-color: #e74c3c; color: white; border: none; padding: 10px 20px; font-size: 14px; border-radius: 5px; }"
-							 "QPushButton:hover { background-color: #c0392b; }");
-	buttonLayout->addWidget(suspendBtn);
+	HttpResponse response = jsonResult(true, "");
+	response.body["date"] = QString::fromStdString(serviceDayToString(day));
+	response.body["total"] = static_cast<int>(result.totalCount);
+	response.body["page"] = page;
+	response.body["rows"] = rows;
+	return response;
+}
+
+// 从 JSON 对象读取一个行程段
+bool parseBookingLeg(const QJsonObject& object, BookingLeg& leg) {
+	leg.trainNumber = object["train"].toString().toStdString();
+	leg.startStation = trim(object["from"].toString().toStdString());
+	leg.endStation = trim(object["to"].toString().toStdString());
+	leg.passengers = object.contains("count") ? object["count"].toInt() : 1;
+	string date = object["date"].toString().toStdString();
+	leg.serviceDay = date.empty() ? currentServiceDay : parseServiceDay(date);
+	if (object.contains("class")) {
+		string code = object["class"].toString().toStdString();
+		leg.seatClass = -1;
+		for (int c = 0; c < SEAT_CLASS_COUNT; ++c) {
+			if (code == SEAT_CLASSES[c].code) {
+				leg.seatClass = c;
+			}
+		}
+		if (leg.seatClass < 0) {
+			return false;
+		}
+	}
+	return !leg.trainNumber.empty() && !leg.startStation.empty() && !leg.endStation.empty() && leg.serviceDay >= 0;
+}
+
+// POST /api/book：单段或多段，全部成功或全部失败
+HttpResponse handleBook(const HttpRequest& request) {
+	User* user = authenticate(request);
+	if (!user) {
+		return jsonResult(false, "未登录或会话已失效", 401);
+	}
+	HttpResponse error;
+	QJsonObject body;
+	if (!parseJsonBody(request, body, error)) {
+		return error;
+	}
 	
-	QPushButton* resumeBtn = new QPushButton("复开列车");
-	resumeBtn->setStyleSheet("QPushButton { background-color: #27ae60; color: white; border: none; padding: 10px 20px; font-size: 14px; border-radius: 5px; }"
-							"QPushButton:hover { background-color: #229954; }");
-	buttonLayout->addWidget(resumeBtn);
+	vector<BookingLeg> legs;
+	if (body.contains("legs")) {
+		for (const QJsonValue& value : body["legs"].toArray()) {
+			BookingLeg leg;
+			if (!value.isObject() || !parseBookingLeg(value.toObject(), leg)) {
+				return jsonResult(false, "行程段缺少 train / from / to，或日期、席别格式错误", 400);
+			}
+			legs.push_back(leg);
+		}
+	} else {
+		BookingLeg leg;
+		if (!parseBookingLeg(body, leg)) {
+			return jsonResult(false, "缺少 train / from / to，或日期、席别格式错误", 400);
+		}
+		legs.push_back(leg);
+	}
 	
-	QPushButton* logoutBtn = new QPushButton("退出登录");
-	logoutBtn->setStyleSheet("QPushButton { background-color: #95a5a6; color: white; border: none; padding: 10px 20px; font-size: 14px; border-radius: 5px; }"
-							"QPushButton:hover { background-color: #7f8c8d; }");
-	buttonLayout->addWidget(logoutBtn);
+	BookingResult booking = bookTickets(*user, legs);
+	HttpResponse response = jsonResult(booking.success, booking.message);
+	response.body["totalPrice"] = booking.totalPrice;
+	response.body["balance"] = user->balance;
+	QJsonArray seats;
+	for (const string& seat : booking.seats) {
+		seats.append(QString::fromStdString(seat));
+	}
+	response.body["seats"] = seats;
+	QJsonArray tickets;
+	for (long long ticketId : booking.ticketIds) {
+		tickets.append(static_cast<double>(ticketId));
+	}
+	response.body["tickets"] = tickets;
+	return response;
+}
+
+// POST /api/refund
+HttpResponse handleRefund(const HttpRequest& request) {
+	User* user = authenticate(request);
+	if (!user) {
+		return jsonResult(false, "未登录或会话已失效", 401);
+	}
+	HttpResponse error;
+	QJsonObject body;
+	if (!parseJsonBody(request, body, error)) {
+		return error;
+	}
 	
-	layout->addLayout(buttonLayout);
+	// 优先按车票编号退票；旧客户端仍可按车次和日期退票
+	RefundResult refund = body.contains("ticket")
+		? refundTicket(*user, static_cast<long long>(body["ticket"].toDouble()))
+		: refundTicket(*user, body["train"].toString().toStdString(), body["date"].toString().toStdString());
+	HttpResponse response = jsonResult(refund.success, refund.message);
+	response.body["refundAmount"] = refund.refundAmount;
+	response.body["balance"] = user->balance;
+	return response;
+}
+
+// POST /api/recharge
+HttpResponse handleRecharge(const HttpRequest& request) {
+	User* user = authenticate(request);
+	if (!user) {
+		return jsonResult(false, "未登录或会话已失效", 401);
+	}
+	HttpResponse error;
+	QJsonObject body;
+	if (!parseJsonBody(request, body, error)) {
+		return error;
+	}
+	if (!body["amount"].isDouble()) {
+		return jsonResult(false, "缺少 amount", 400);
+	}
 	
-	// 停开列车按钮事件
-	QObject::connect(suspendBtn, &QPushButton::clicked, [mainWindow, updateAdminTrainTable]() {
-		int currentRow = adminTrainTable->currentRow();
-		if (currentRow < 0) {
-			QMessageBox::warning(mainWindow, "提示", "请先选择一个列车!");
+	string message;
+	bool ok = rechargeBalance(*user, body["amount"].toDouble(), message);
+	HttpResponse response = jsonResult(ok, message);
+	response.body["balance"] = user->balance;
+	return response;
+}
+
+// 只读请求可以在工作线程中执行
+bool isReadOnlyRequest(const HttpRequest& request) {
+	return (request.method == "GET" && request.path == "/api/search") ||
+		   (request.method == "POST" && request.path == "/api/login");
+}
+
+// 工作线程：查票读快照，登录持共享锁读取用户
+HttpResponse handleReadRequest(const HttpRequest& request) {
+	if (request.path == "/api/search") {
+		return handleSearch(request);
+	}
+	shared_lock<shared_mutex> lock(engineMutex);
+	return handleLogin(request);
+}
+
+// 主线程：持独占锁处理修改数据的请求，等待分片提交期间暂时放开（见 shardWaitLock）
+HttpResponse handleWriteRequest(const HttpRequest& request) {
+	static const map<string, HttpResponse (*)(const HttpRequest&)> routes = {
+		{"/api/book", handleBook},
+		{"/api/refund", handleRefund},
+		{"/api/recharge", handleRecharge}
+	};
+	auto routeIt = routes.find(request.path);
+	if (routeIt == routes.end()) {
+		bool known = request.path == "/api/search" || request.path == "/api/login";
+		return known ? jsonResult(false, "请求方法不支持", 405) : jsonResult(false, "接口不存在", 404);
+	}
+	if (request.method != "POST") {
+		return jsonResult(false, "请求方法不支持", 405);
+	}
+	
+	unique_lock<shared_mutex> lock(engineMutex);
+	shardWaitLock = &lock;
+	HttpResponse response = routeIt->second(request);
+	shardWaitLock = nullptr;
+	publishInventorySnapshot();
+	return response;
+}
+
+// 写出响应；不保持连接时关闭连接并丢弃之后收到的数据
+void sendHttpResponse(HttpConnection& connection, const HttpResponse& response, bool keepAlive) {
+	connection.socket->write(buildHttpResponse(response, keepAlive));
+	connection.busy = false;
+	if (!keepAlive) {
+		connection.closing = true;
+		connection.buffer.clear();
+		connection.socket->disconnectFromHost();
+	}
+}
+
+// 依次处理连接缓冲区中已到达的完整请求（流水线）：修改数据的请求在主线程直接处理后继续取下一个，
+// 查询请求交给工作线程，响应写出后再继续
+void processHttpConnection(unsigned long long connectionId) {
+	auto it = httpConnections.find(connectionId);
+	if (it == httpConnections.end()) {
+		return;
+	}
+	HttpConnection& connection = it->second;
+	while (!connection.busy && !connection.closing) {
+		HttpRequest request;
+		int consumed = parseHttpRequest(connection.buffer, request);
+		if (consumed == 0) {
 			return;
 		}
-		
-		QString trainNumber = adminTrainTable->item(currentRow, 0)->text();
-		string trainNumberStr = trainNumber.toStdString();
-		
-		// 检查是否已经停开
-		if (find(suspendedTrains.begin(), suspendedTrains.end(), trainNumberStr) != suspendedTrains.end()) {
-			QMessageBox::information(mainWindow, "提示", "该列车已经停开!");
+		if (consumed < 0) {
+			sendHttpResponse(connection, jsonResult(false, "请求格式错误", 400), false);
 			return;
 		}
+		connection.buffer.remove(0, consumed);
 		
-		// 确认停开
-		int ret = QMessageBox::question(mainWindow, "确认", 
-			QString("确定要停开列车 %1 吗？\n停开后该列车将无法被用户查询和购票。").arg(trainNumber),
-			QMessageBox::Yes | QMessageBox::No);
-		
-		if (ret == QMessageBox::Yes) {
-			suspendedTrains.push_back(trainNumberStr);
-			saveSuspendedTrainsToDB();
-			updateAdminTrainTable();
-			QMessageBox::information(mainWindow, "成功", QString("列车 %1 已停开!").arg(trainNumber));
+		if (!isReadOnlyRequest(request)) {
+			sendHttpResponse(connection, handleWriteRequest(request), request.keepAlive);
+			continue;
 		}
-	});
+		
+		// 工作线程处理完后回到主线程写响应（连接可能已关闭，按连接ID查找）
+		connection.busy = true;
+		QThreadPool::globalInstance()->start([connectionId, request]() {
+			HttpResponse response = handleReadRequest(request);
+			bool keepAlive = request.keepAlive;
+			QMetaObject::invokeMethod(QCoreApplication::instance(), [connectionId, response, keepAlive]() {
+				auto it = httpConnections.find(connectionId);
+				if (it == httpConnections.end() || it->second.closing) {
+					return;
+				}
+				sendHttpResponse(it->second, response, keepAlive);
+				processHttpConnection(connectionId);
+			}, Qt::QueuedConnection);
+		});
+	}
+}
+
+// ==================== 负载回放 ====================
+// 对数据库副本重新执行录制文件中的操作并统计吞吐量和延迟。
+// 修改数据的操作按录制顺序在主线程执行（数据库连接只在主线程使用）；多线程回放时查票交给线程池，
+// 查票不修改数据，因此多线程回放的最终数据与单线程回放相同。
+// 延迟从事件按节奏应当开始的时刻算起，包括在线程池中排队的时间。
+
+const char* workloadOpName(WorkloadOp op) {
+	switch (op) {
+		case WorkloadOp::Search: return "search";
+		case WorkloadOp::Book: return "book";
+		case WorkloadOp::Refund: return "refund";
+		case WorkloadOp::Recharge: return "recharge";
+		case WorkloadOp::Suspend: return "suspend";
+		case WorkloadOp::Resume: return "resume";
+	}
+	return "unknown";
+}
+
+// 录制中的车票编号换算为回放中的编号：录制期间售出的车票在回放时按同样顺序重新售出
+long long replayTicketId(long long recordedId) {
+	return recordedId >= replayFirstTicketId ? recordedId + replayTicketOffset : recordedId;
+}
+
+// 执行一条修改数据的事件（调用者需持有 engineMutex 独占锁），返回业务上是否成功
+bool executeWorkloadWrite(const WorkloadEvent& event) {
+	if (event.op == WorkloadOp::Suspend || event.op == WorkloadOp::Resume) {
+		return setTrainSuspended(event.trainNumber, event.op == WorkloadOp::Suspend);
+	}
 	
-	// 复开列车按钮事件
-	QObject::connect(resumeBtn, &QPushButton::clicked, [mainWindow, updateAdminTrainTable]() {
-		int currentRow = adminTrainTable->currentRow();
-		if (currentRow < 0) {
-			QMessageBox::warning(mainWindow, "提示", "请先选择一个列车!");
-			return;
+	auto userIt = find_if(users.begin(), users.end(), [&event](const User& u) { return u.id == event.userId; });
+	if (userIt == users.end()) {
+		return false;
+	}
+	
+	string message;
+	switch (event.op) {
+		case WorkloadOp::Book:
+			return bookTickets(*userIt, event.legs).success;
+		case WorkloadOp::Refund:
+			return refundTicket(*userIt, replayTicketId(event.ticketId)).success;
+		case WorkloadOp::Recharge:
+			return rechargeBalance(*userIt, event.amountCents / 100.0, message);
+		default:
+			return false;
+	}
+}
+
+// 执行一条查票事件（在当前快照上执行，不需要 engineMutex）
+bool executeWorkloadSearch(const WorkloadEvent& event) {
+	shared_ptr<const InventorySnapshot> snapshot = currentInventorySnapshot();
+	SearchArena arena;
+	searchTicketPageConcurrent(*snapshot, event.startStation, event.endStation, event.departureTimeFilter, event.serviceDay,
+							   static_cast<TicketSortKey>(event.sortKey), event.page, event.pageSize, arena.get());
+	return true;
+}
+
+// 回放录制文件：speed 为回放倍速，0 表示不等待、尽快执行；threads 为 1 时所有事件都在主线程执行
+int replayWorkload(const vector<WorkloadEvent>& events, double speed, int threads) {
+	vector<long long> latencies(events.size(), 0); // 每条事件的延迟（微秒），各线程只写自己负责的下标
+	vector<char> succeeded(events.size(), 0);
+	
+	QThreadPool pool;
+	pool.setMaxThreadCount(max(1, threads));
+	
+	auto start = chrono::steady_clock::now();
+	for (size_t i = 0; i < events.size(); ++i) {
+		const WorkloadEvent& event = events[i];
+		auto scheduled = chrono::steady_clock::now();
+		if (speed > 0) {
+			scheduled = start + chrono::microseconds(static_cast<long long>(event.timestampMicros / speed));
+			this_thread::sleep_until(scheduled);
 		}
 		
-		QString trainNumber = adminTrainTable->item(currentRow, 0)->text();
-		string trainNumberStr = trainNumber.toStdString();
-		
-		// 检查是否已经停开
-		auto it = find(suspendedTrains.begin(), suspendedTrains.end(), trainNumberStr);
-		if (it == suspendedTrains.end()) {
-			QMessageBox::information(mainWindow, "提示", "该列车正在正常运行!");
-			return;
+		if (event.op == WorkloadOp::Search && threads > 1) {
+			pool.start([&events, &latencies, &succeeded, i, scheduled]() {
+				succeeded[i] = executeWorkloadSearch(events[i]);
+				latencies[i] = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - scheduled).count();
+			});
+			continue;
 		}
 		
-		// 确认复开
-		int ret = QMessageBox::question(mainWindow, "确认", 
-			QString("确定要复开列车 %1 吗？\n复开后该列车将恢复正常运行。").arg(trainNumber),
-			QMessageBox::Yes | QMessageBox::No);
-		
-		if (ret == QMessageBox::Yes) {
-			suspendedTrains.erase(it);
-			saveSuspendedTrainsToDB();
-			updateAdminTrainTable();
-			QMessageBox::information(mainWindow, "成功", QString("列车 %1 已复开!").arg(trainNumber));
+		if (event.op == WorkloadOp::Search) {
+			succeeded[i] = executeWorkloadSearch(event);
+		} else {
+			unique_lock<shared_mutex> lock(engineMutex);
+			shardWaitLock = &lock;
+			succeeded[i] = executeWorkloadWrite(event);
+			shardWaitLock = nullptr;
+			publishInventorySnapshot();
 		}
-	});
+		latencies[i] = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - scheduled).count();
+	}
+	pool.waitForDone();
+	double elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	
+	// 按操作类型汇总
+	map<WorkloadOp, vector<long long>> latenciesByOp;
+	map<WorkloadOp, size_t> successByOp;
+	for (size_t i = 0; i < events.size(); ++i) {
+		latenciesByOp[events[i].op].push_back(latencies[i]);
+		successByOp[events[i].op] += succeeded[i] ? 1 : 0;
+	}
 	
-	// 退出登录按钮事件
-	QObject::connect(logoutBtn, &QPushButton::clicked, [mainWindow]() {
-		currentAdmin = nullptr;
-		stackedWidget->setCurrentWidget(startMenuWidget);
-	});
+	auto percentile = [](const vector<long long>& sorted, double p) {
+		size_t rank = static_cast<size_t>(p * sorted.size());
+		return sorted[min(rank, sorted.size() - 1)];
+	};
 	
-	return widget;
+	cout << "回放完成：" << events.size() << " 条事件，耗时 " << elapsedSeconds << " 秒，吞吐量 "
+		 << (elapsedSeconds > 0 ? events.size() / elapsedSeconds : 0.0) << " 次/秒" << endl;
+	cout << "操作\t次数\t成功\tp50(us)\tp90(us)\tp99(us)\tmax(us)" << endl;
+	for (auto& entry : latenciesByOp) {
+		vector<long long>& sorted = entry.second;
+		sort(sorted.begin(), sorted.end());
+		cout << workloadOpName(entry.first) << "\t" << sorted.size() << "\t" << successByOp[entry.first] << "\t"
+			 << percentile(sorted, 0.50) << "\t" << percentile(sorted, 0.90) << "\t"
+			 << percentile(sorted, 0.99) << "\t" << sorted.back() << endl;
+	}
+	return 0;
 }
 
 int main(int argc, char *argv[]) {
-	QApplication app(argc, argv);
+	QCoreApplication app(argc, argv);
+	
+	// 命令行参数：
+	//   --port 端口（默认8080）  --threads 工作线程数（默认为CPU核数）  --db 数据库文件
+	//   --record 录制文件：把收到的操作录制下来
+	//   --replay 录制文件 [--speed 倍速|max]：对 --db 指定的数据库副本回放后退出，默认按1倍速
+	//   --fare-per-km 每公里票价（默认0.5元）
+	//   --shards 分片数：余票和车票按车次分到多个数据库文件，各分片并行写入
+	//   --shared-inventory 名称：与同名的其他进程（界面版或服务）共享余票，不能与 --replay 同时使用
+	quint16 port = 8080;
+	int threadCount = QThread::idealThreadCount();
+	string recordPath;
+	string replayPath;
+	double replaySpeed = 1.0;
+	int shards = 0;
+	string sharedName;
+	QStringList args = app.arguments();
+	for (int i = 1; i + 1 < args.size(); ++i) {
+		if (args[i] == "--port") {
+			port = static_cast<quint16>(args[++i].toUInt());
+		} else if (args[i] == "--threads") {
+			threadCount = args[++i].toInt();
+		} else if (args[i] == "--db") {
+			dbPath = args[++i].toStdString();
+		} else if (args[i] == "--record") {
+			recordPath = args[++i].toStdString();
+		} else if (args[i] == "--replay") {
+			replayPath = args[++i].toStdString();
+		} else if (args[i] == "--speed") {
+			QString speed = args[++i];
+			replaySpeed = speed == "max" ? 0.0 : speed.toDouble();
+		} else if (args[i] == "--fare-per-km") {
+			setFarePerKm(args[++i].toDouble());
+		} else if (args[i] == "--shards") {
+			shards = args[++i].toInt();
+		} else if (args[i] == "--shared-inventory") {
+			sharedName = args[++i].toStdString();
+		}
+	}
+	
+	// 回放会修改数据库，只允许对副本回放；“今天”设为录制当天
+	vector<WorkloadEvent> replayEvents;
+	if (!replayPath.empty()) {
+		if (!sharedName.empty()) {
+			cout << "回放不能与 --shared-inventory 同时使用" << endl;
+			return -1;
+		}
+		if (dbPath == DB_NAME) {
+			cout << "回放会修改数据库，请用 --db 指定 " << DB_NAME << " 的副本" << endl;
+			return -1;
+		}
+		int recordingDay = 0;
+		if (!readWorkloadTrace(replayPath, replayEvents, recordingDay, replayFirstTicketId)) {
+			return -1;
+		}
+		currentServiceDay = recordingDay;
+	} else {
+		currentServiceDay = todayServiceDay();
+	}
 	
 	// 初始化数据库
 	if (!initDatabase()) {
-		QMessageBox::critical(nullptr, "数据库错误", "无法初始化数据库，程序将退出");
+		cout << "无法初始化数据库，程序将退出" << endl;
 		return -1;
 	}
 	
 	// 迁移现有文件数据到数据库
 	migrateDataFromFiles();
+	if (!restoreSeatTemplates()) {
+		cout << "无法迁移旧版本的余票，程序将退出" << endl;
+		return -1;
+	}
+	if (!startShardWriters(shards)) {
+		cout << "无法初始化存储分片，程序将退出" << endl;
+		return -1;
+	}
+	
+	// 路网地图：计算站间里程，用于按里程计价
+	if (!loadStationMap("map.txt") && !loadStationMap("data/map.txt")) {
+		cout << "未找到路网地图 map.txt，票价使用各车次自带的票价矩阵" << endl;
+	}
 	
 	// 从数据库加载数据
 	loadTrainsFromDB();
+	loadDatedSeatsFromDB();
 	loadUsersFromDB();
 	loadAdminsFromDB();
 	loadSuspendedTrainsFromDB();
-	
-	// 添加调试信息
-	cout << "加载了 " << trains.size() << " 条列车数据" << endl;
-	for (const auto& train : trains) {
-		cout << "车次: " << train.trainNumber << ", 站点数: " << train.stations.size() << endl;
-		cout << "站点: ";
-		for (const auto& station : train.stations) {
-			cout << station << " ";
-		}
-		cout << endl;
+	if (!sharedName.empty() && !openSharedInventory(sharedName)) {
+		stopShardWriters();
+		return -1;
 	}
+	publishInventorySnapshot();
 	
-	// 创建主窗口
-	QMainWindow mainWindow;
-	mainWindow.setWindowTitle("列车购票系统");
-	mainWindow.setMinimumSize(1000, 700);
-	
-	// 创建堆叠窗口部件
-	stackedWidget = new QStackedWidget(&mainWindow);
-	mainWindow.setCentralWidget(stackedWidget);
-	
-	// 创建所有界面
-	startMenuWidget = createStartMenuWidget(&mainWindow);
-	loginWidget = createLoginWidget(&mainWindow);
-	registerWidget = createRegisterWidget(&mainWindow);
-	adminLoginWidget = createAdminLoginWidget(&mainWindow);
-	adminRegisterWidget = createAdminRegisterWidget(&mainWindow);
-	mainMenuWidget = createMainMenuWidget(&mainWindow);
-	adminMenuWidget = createAdminMenuWidget(&mainWindow);
+	if (!replayPath.empty()) {
+		replayTicketOffset = peekTicketId() - replayFirstTicketId;
+		int exitCode = replayWorkload(replayEvents, replaySpeed, max(1, threadCount));
+		stopShardWriters();
+		return exitCode;
+	}
+	if (!recordPath.empty() && !startWorkloadRecording(recordPath)) {
+		return -1;
+	}
 	
-	// 添加到堆叠窗口
-	stackedWidget->addWidget(startMenuWidget);
-	stackedWidget->addWidget(loginWidget);
-	stackedWidget->addWidget(registerWidget);
-	stackedWidget->addWidget(adminLoginWidget);
-	stackedWidget->addWidget(adminRegisterWidget);
-	stackedWidget->addWidget(mainMenuWidget);
-	stackedWidget->addWidget(adminMenuWidget);
+	QThreadPool::globalInstance()->setMaxThreadCount(max(1, threadCount));
 	
-	// 显示开始菜单界面
-	stackedWidget->setCurrentWidget(startMenuWidget);
+	QTcpServer server;
+	QObject::connect(&server, &QTcpServer::newConnection, [&server]() {
+		while (QTcpSocket* socket = server.nextPendingConnection()) {
+			unsigned long long connectionId = nextConnectionId++;
+			httpConnections[connectionId].socket = socket;
+			
+			QObject::connect(socket, &QTcpSocket::readyRead, [connectionId, socket]() {
+				auto it = httpConnections.find(connectionId);
+				if (it == httpConnections.end()) {
+					return;
+				}
+				QByteArray data = socket->readAll();
+				if (it->second.closing) {
+					return;
+				}
+				it->second.buffer += data;
+				// 正在处理请求时客户端仍可继续发送，缓冲区超过上限时直接拒绝
+				if (it->second.buffer.size() > MAX_HTTP_BUFFER_BYTES) {
+					it->second.buffer.clear();
+					if (!it->second.busy) {
+						sendHttpResponse(it->second, jsonResult(false, "请求过大", 413), false);
+					} else {
+						it->second.closing = true;
+						socket->disconnectFromHost();
+					}
+					return;
+				}
+				processHttpConnection(connectionId);
+			});
+			QObject::connect(socket, &QTcpSocket::disconnected, [connectionId, socket]() {
+				httpConnections.erase(connectionId);
+				socket->deleteLater();
+			});
+		}
+	});
 	
-	mainWindow.show();
+	if (!server.listen(QHostAddress::LocalHost, port)) {
+		cout << "监听端口失败: " << server.errorString().toStdString() << endl;
+		return -1;
+	}
+	cout << "HTTP 服务已启动: http://127.0.0.1:" << port << "，工作线程数 " << QThreadPool::globalInstance()->maxThreadCount() << endl;
+	
+	// 每秒推进一次座位预留时间轮，释放超时未支付的预留；跨天时滚动预售期；拉取并落盘共享余票
+	QTimer holdTimer;
+	QObject::connect(&holdTimer, &QTimer::timeout, []() {
+		unique_lock<shared_mutex> lock(engineMutex);
+		advanceSeatHolds();
+		rollSalesWindow();
+		tickSharedInventory();
+		publishInventorySnapshot();
+	});
+	holdTimer.start(1000);
 	
-	return app.exec();
+	int exitCode = app.exec();
+	closeSharedInventory(); // 归还本进程的预留，协调进程把余票落盘
+	stopShardWriters();
+	return exitCode;
 }
+#endif
@@ -0,0 +1,21 @@
+QT += core sql network
+QT -= gui
+
+CONFIG += c++17
+CONFIG += console
+
+TARGET = railway_server
+TEMPLATE = app
+
+# 无界面构建：只编译业务逻辑和 HTTP/JSON 服务，不依赖 Qt Widgets
+DEFINES += RAILWAY_HEADLESS
+
+SOURCES += kent.cpp
+
+# 设置输出目录（中间文件与桌面版分开，避免共用 kent.o）
+DESTDIR = ./
+OBJECTS_DIR = build_server
+
+# 编译器设置
+QMAKE_CXX = D:/newdesktop/desktopfilebodies/Qt/Tools/mingw1310_64/bin/g++.exe
+QMAKE_CC = D:/newdesktop/desktopfilebodies/Qt/Tools/mingw1310_64/bin/gcc.exe